@@ -31,7 +31,13 @@ namespace OHOS::uitest {
     enum TypeId : uint8_t { NONE, INT, FLOAT, BOOL, STRING, BY, COMPONENT, DRIVER, RECT_JSON };
 
     /**Enumerates the supported string value match rules.*/
-    enum ValueMatchRule : uint8_t { EQ, CONTAINS, STARTS_WITH, ENDS_WITH };
+    enum ValueMatchRule : uint8_t { EQ, CONTAINS, STARTS_WITH, ENDS_WITH, REGEX, FUZZY };
+
+    /**Enumerates the flags of string value matching, which fold the values before the rule is applied.*/
+    enum ValueMatchFlag : uint8_t { IGNORE_CASE = 1, NORMALIZE_WHITESPACE = 2 };
+
+    /**Enumerates the supported geometric relations of a widget to the locator widget.*/
+    enum GeometricRelation : uint8_t { LEFT_OF, RIGHT_OF, ABOVE, BELOW, NEAR };
 
     /**Enumerates the supported UiComponent attributes.*/
     enum UiAttr : uint8_t {
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "edit_distance.h"
+
+namespace OHOS::uitest {
+    using namespace std;
+
+    static constexpr uint32_t WORD_BITS = 64;
+    static constexpr uint32_t ASCII_COUNT = 128;
+    static constexpr size_t UTF8_MAX_BYTES = 4;
+    static constexpr uint32_t UTF8_PAYLOAD_BITS = 6;
+    static constexpr uint8_t UTF8_PAYLOAD_MASK = 0x3F;
+    static constexpr uint8_t UTF8_CONTINUATION_MASK = 0xC0;
+    static constexpr uint8_t UTF8_CONTINUATION = 0x80;
+    // marks the bytes which do not form a valid UTF-8 character, so they don't collide with the code points
+    static constexpr uint32_t RAW_BYTE_FLAG = 0x80000000;
+
+    /**Decode the UTF-8 character at the offset and advance the offset, an invalid byte is a character by itself.*/
+    static uint32_t DecodeCharacter(string_view text, size_t &offset)
+    {
+        const auto lead = static_cast<uint8_t>(text[offset]);
+        size_t length = 1;
+        uint32_t character = lead;
+        if ((lead & 0xE0) == 0xC0) {
+            length = 2; // 2 bytes character
+            character = lead & 0x1F;
+        } else if ((lead & 0xF0) == 0xE0) {
+            length = 3; // 3 bytes character
+            character = lead & 0x0F;
+        } else if ((lead & 0xF8) == 0xF0) {
+            length = UTF8_MAX_BYTES;
+            character = lead & 0x07;
+        } else if (lead >= ASCII_COUNT) {
+            offset++;
+            return RAW_BYTE_FLAG | lead;
+        }
+        if (offset + length > text.length()) {
+            offset++;
+            return RAW_BYTE_FLAG | lead;
+        }
+        for (size_t index = 1; index < length; index++) {
+            const auto byte = static_cast<uint8_t>(text[offset + index]);
+            if ((byte & UTF8_CONTINUATION_MASK) != UTF8_CONTINUATION) {
+                offset++;
+                return RAW_BYTE_FLAG | lead;
+            }
+            character = (character << UTF8_PAYLOAD_BITS) | (byte & UTF8_PAYLOAD_MASK);
+        }
+        offset += length;
+        return character;
+    }
+
+    EditDistancePattern::EditDistancePattern(string_view pattern, uint32_t maxDistance) : maxDistance_(maxDistance)
+    {
+        vector<uint32_t> characters;
+        for (size_t offset = 0; offset < pattern.length();) {
+            characters.emplace_back(DecodeCharacter(pattern, offset));
+        }
+        length_ = static_cast<uint32_t>(characters.size());
+        blockCount_ = max<uint32_t>(1, (length_ + WORD_BITS - 1) / WORD_BITS);
+        asciiMasks_.assign(ASCII_COUNT * blockCount_, 0);
+        absentMasks_.assign(blockCount_, 0);
+        characters_ = characters;
+        characters_.erase(remove_if(characters_.begin(), characters_.end(), [](auto ch) { return ch < ASCII_COUNT; }),
+                          characters_.end());
+        sort(characters_.begin(), characters_.end());
+        characters_.erase(unique(characters_.begin(), characters_.end()), characters_.end());
+        characterMasks_.assign(characters_.size() * blockCount_, 0);
+        for (uint32_t position = 0; position < length_; position++) {
+            const auto character = characters[position];
+            uint64_t *masks = nullptr;
+            if (character < ASCII_COUNT) {
+                masks = &asciiMasks_[character * blockCount_];
+            } else {
+                const auto index = lower_bound(characters_.begin(), characters_.end(), character) - characters_.begin();
+                masks = &characterMasks_[index * blockCount_];
+            }
+            masks[position / WORD_BITS] |= uint64_t(1) << (position % WORD_BITS);
+        }
+    }
+
+    shared_ptr<const EditDistancePattern> EditDistancePattern::Get(string_view pattern, uint32_t maxDistance)
+    {
+        static constexpr size_t cacheCapacity = 64;
+        static mutex cacheMutex;
+        static unordered_map<string, shared_ptr<const EditDistancePattern>> cache;
+        auto key = to_string(maxDistance).append(1, ':').append(pattern);
+        lock_guard<mutex> guard(cacheMutex);
+        auto find = cache.find(key);
+        if (find != cache.end()) {
+            return find->second;
+        }
+        if (cache.size() >= cacheCapacity) {
+            cache.clear(); // patterns are mostly reused in a short period, simply start over
+        }
+        auto compiled = make_shared<const EditDistancePattern>(pattern, maxDistance);
+        cache.emplace(move(key), compiled);
+        return compiled;
+    }
+
+    const uint64_t *EditDistancePattern::GetPositionMasks(uint32_t character) const
+    {
+        if (character < ASCII_COUNT) {
+            return &asciiMasks_[character * blockCount_];
+        }
+        auto find = lower_bound(characters_.begin(), characters_.end(), character);
+        if (find == characters_.end() || *find != character) {
+            return absentMasks_.data();
+        }
+        return &characterMasks_[(find - characters_.begin()) * blockCount_];
+    }
+
+    /**
+     * Advance the vertical deltas of a block by one value character, with the horizontal delta coming in from the
+     * row above the block. Returns the horizontal delta going out at the given row of the block.
+     * */
+    static inline int32_t AdvanceBlock(uint64_t &positive, uint64_t &negative, uint64_t matches, int32_t deltaIn,
+                                       uint32_t outRow)
+    {
+        const uint64_t negativeIn = deltaIn < 0 ? 1 : 0;
+        const uint64_t positiveIn = deltaIn > 0 ? 1 : 0;
+        const auto vertical = matches | negative;
+        matches |= negativeIn;
+        const auto horizontal = (((matches & positive) + positive) ^ positive) | matches;
+        auto horizontalPositive = negative | ~(horizontal | positive);
+        auto horizontalNegative = positive & horizontal;
+        const auto deltaOut = static_cast<int32_t>((horizontalPositive >> outRow) & 1) -
+            static_cast<int32_t>((horizontalNegative >> outRow) & 1);
+        horizontalPositive = (horizontalPositive << 1) | positiveIn;
+        horizontalNegative = (horizontalNegative << 1) | negativeIn;
+        positive = horizontalNegative | ~(vertical | horizontalPositive);
+        negative = horizontalPositive & vertical;
+        return deltaOut;
+    }
+
+    uint32_t EditDistancePattern::Distance(string_view value) const
+    {
+        const auto exceeded = maxDistance_ + 1;
+        // the value has [bytes / 4, bytes] characters, the distance is at least the difference of the lengths
+        if (value.length() + maxDistance_ < length_ || value.length() / UTF8_MAX_BYTES > length_ + maxDistance_) {
+            return exceeded;
+        }
+        // the positive and negative vertical deltas of the blocks, column 0 is all positive
+        static thread_local vector<uint64_t> positives;
+        static thread_local vector<uint64_t> negatives;
+        positives.assign(blockCount_, ~uint64_t(0));
+        negatives.assign(blockCount_, 0);
+        const auto lastBlock = blockCount_ - 1;
+        const auto lastRow = length_ == 0 ? 0 : (length_ - 1) % WORD_BITS;
+        // the distance of the whole pattern to the value prefix, the bottom cell of the column
+        int64_t score = length_;
+        for (size_t offset = 0; offset < value.length();) {
+            const auto *masks = GetPositionMasks(DecodeCharacter(value, offset));
+            if (length_ == 0) {
+                score++;
+            } else {
+                // the top row grows by one per column in global alignment
+                int32_t delta = 1;
+                for (uint32_t block = 0; block < lastBlock; block++) {
+                    delta = AdvanceBlock(positives[block], negatives[block], masks[block], delta, WORD_BITS - 1);
+                }
+                score += AdvanceBlock(positives[lastBlock], negatives[lastBlock], masks[lastBlock], delta, lastRow);
+            }
+            // each remaining character lowers the score by at most one
+            if (score > static_cast<int64_t>(maxDistance_ + (value.length() - offset))) {
+                return exceeded;
+            }
+        }
+        return score > static_cast<int64_t>(maxDistance_) ? exceeded : static_cast<uint32_t>(score);
+    }
+} // namespace uitest
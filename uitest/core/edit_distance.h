@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace OHOS::uitest {
+    /**
+     * Pattern compiled for computing the edit distance (Levenshtein distance) of values to it, counted in UTF-8
+     * characters. The distance is computed column by column with the bit-parallel algorithm of Myers in the blocked
+     * form of Hyyro, 64 pattern characters per machine word, and stops early once it exceeds the max distance.
+     * */
+    class EditDistancePattern {
+    public:
+        EditDistancePattern(std::string_view pattern, uint32_t maxDistance);
+
+        /**Get the compiled pattern from the process-wide cache.*/
+        static std::shared_ptr<const EditDistancePattern> Get(std::string_view pattern, uint32_t maxDistance);
+
+        /**
+         * Compute the edit distance of the value to the pattern, without allocation once the working buffers grew.
+         *
+         * @returns the distance, or <code>maxDistance + 1</code> if it exceeds the max distance.
+         * */
+        uint32_t Distance(std::string_view value) const;
+
+        /**Check if the edit distance of the value to the pattern is within the max distance.*/
+        bool Matches(std::string_view value) const
+        {
+            return Distance(value) <= maxDistance_;
+        }
+
+        uint32_t GetMaxDistance() const
+        {
+            return maxDistance_;
+        }
+
+    private:
+        /**Get the masks of the pattern positions holding the character, one word per block.*/
+        const uint64_t *GetPositionMasks(uint32_t character) const;
+
+        uint32_t maxDistance_ = 0;
+        // count of the pattern characters, and of the 64-character blocks
+        uint32_t length_ = 0;
+        uint32_t blockCount_ = 0;
+        // position masks of the ASCII characters indexed by character * blockCount_ + block
+        std::vector<uint64_t> asciiMasks_;
+        // the other characters of the pattern in ascending order, and their position masks
+        std::vector<uint32_t> characters_;
+        std::vector<uint64_t> characterMasks_;
+        // masks of the characters absent from the pattern
+        std::vector<uint64_t> absentMasks_;
+    };
+} // namespace uitest
+
+#endif
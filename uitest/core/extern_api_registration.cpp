@@ -36,7 +36,9 @@ namespace OHOS::uitest {
     {
         static const set<string_view> widgetSelectorApis = {
             "WidgetSelector::<init>", "WidgetSelector::AddMatcher",
-            "WidgetSelector::AddFrontLocator", "WidgetSelector::AddRearLocator"};
+            "WidgetSelector::AddFrontLocator", "WidgetSelector::AddRearLocator", "WidgetSelector::AddAncestorLocator",
+            "WidgetSelector::AddChildLocator", "WidgetSelector::AddDescendantLocator",
+            "WidgetSelector::AddGeometricLocator"};
         if (widgetSelectorApis.find(function) == widgetSelectorApis.end()) {
             return false;
         }
@@ -53,11 +55,23 @@ namespace OHOS::uitest {
             auto attrName = GetItemValueFromJson<string>(in, 0);
             auto testValue = GetItemValueFromJson<string>(in, 1);
             auto matchRule = GetItemValueFromJson<uint32_t>(in, 2);
-            if (matchRule < EQ || matchRule > ENDS_WITH) {
+            // the max edit distance of the FUZZY rule and the match flags are optional
+            const auto maxDistance = in.size() > INDEX_THREE ? GetItemValueFromJson<uint32_t>(in, INDEX_THREE) : 1;
+            const auto flags = in.size() > INDEX_FOUR ? GetItemValueFromJson<uint32_t>(in, INDEX_FOUR) : 0;
+            if (matchRule < EQ || matchRule > FUZZY) {
                 err = ApiCallErr(INTERNAL_ERROR, "Illegal match rule: " + to_string(matchRule));
+            } else if (matchRule == REGEX && RegexAutomaton::Get(testValue) == nullptr) {
+                err = ApiCallErr(USAGE_ERROR, "Illegal or unsupported regular expression: " + testValue);
+            } else if (matchRule == FUZZY && maxDistance > MAX_FUZZY_DISTANCE) {
+                err = ApiCallErr(USAGE_ERROR, "Illegal max edit distance: " + to_string(maxDistance));
+            } else if ((flags & ~(IGNORE_CASE | NORMALIZE_WHITESPACE)) != 0) {
+                err = ApiCallErr(USAGE_ERROR, "Illegal match flags: " + to_string(flags));
+            }
+            if (err.code_ == NO_ERROR) {
+                const auto rule = static_cast<ValueMatchRule>(matchRule);
+                auto matcher = WidgetAttrMatcher(attrName, testValue, rule, maxDistance, static_cast<uint8_t>(flags));
+                selector.AddMatcher(matcher);
             }
-            auto matcher = WidgetAttrMatcher(attrName, testValue, static_cast<ValueMatchRule>(matchRule));
-            selector.AddMatcher(matcher);
         } else if (function == "WidgetSelector::AddFrontLocator") {
             auto frontLocator = WidgetSelector();
             frontLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
@@ -66,6 +80,27 @@ namespace OHOS::uitest {
             auto rearLocator = WidgetSelector();
             rearLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
             selector.AddRearLocator(rearLocator, err);
+        } else if (function == "WidgetSelector::AddAncestorLocator") {
+            auto ancestorLocator = WidgetSelector();
+            ancestorLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
+            selector.AddAncestorLocator(ancestorLocator, err);
+        } else if (function == "WidgetSelector::AddChildLocator") {
+            auto childLocator = WidgetSelector();
+            childLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
+            selector.AddChildLocator(childLocator, err);
+        } else if (function == "WidgetSelector::AddDescendantLocator") {
+            auto descendantLocator = WidgetSelector();
+            descendantLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
+            selector.AddDescendantLocator(descendantLocator, err);
+        } else if (function == "WidgetSelector::AddGeometricLocator") {
+            auto geometricLocator = WidgetSelector();
+            geometricLocator.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
+            auto relation = GetItemValueFromJson<uint32_t>(in, 1);
+            if (relation > NEAR) {
+                err = ApiCallErr(INTERNAL_ERROR, "Illegal geometric relation: " + to_string(relation));
+            } else {
+                selector.AddGeometricLocator(geometricLocator, static_cast<GeometricRelation>(relation), err);
+            }
         }
         // write back updated object meta-data
         caller.clear();
@@ -75,8 +110,9 @@ namespace OHOS::uitest {
 
     static bool UiDriverHandlerA(string_view function, json &caller, const json &in, json &out, ApiCallErr &err)
     {
-        static const set<string_view> uiDriverApis = {
-            "UiDriver::<init>", "UiDriver::FindWidgets", "UiDriver::TriggerKey"};
+        static const set<string_view> uiDriverApis = {"UiDriver::<init>", "UiDriver::FindWidgets",
+            "UiDriver::TriggerKey", "UiDriver::FindWidgetAt", "UiDriver::FindNearestClickableWidget",
+            "UiDriver::FindWidgetsBatch"};
         if (uiDriverApis.find(function) == uiDriverApis.end()) {
             return false;
         }
@@ -96,11 +132,28 @@ namespace OHOS::uitest {
         if (function == "UiDriver::FindWidgets") {
             auto selector = WidgetSelector();
             selector.ReadFromParcel(GetItemValueFromJson<json>(in, 0));
+            // optional limit of the found widgets, 0 for all
+            const uint32_t limit = in.size() >= INDEX_TWO ? GetItemValueFromJson<uint32_t>(in, 1) : 0;
             vector<unique_ptr<WidgetImage>> rev;
-            driver.FindWidgets(selector, rev, err);
+            driver.FindWidgets(selector, rev, err, limit);
             for (auto &ptr:rev) {
                 PushBackValueItemIntoJson<WidgetImage>(*ptr, out);
             }
+        } else if (function == "UiDriver::FindWidgetsBatch") {
+            // variable-length selector parameters, results of each selector are delivered as one value list
+            vector<WidgetSelector> selectors(in.size());
+            for (size_t idx = 0; idx < in.size(); idx++) {
+                selectors[idx].ReadFromParcel(GetItemValueFromJson<json>(in, idx));
+            }
+            vector<vector<unique_ptr<WidgetImage>>> rev;
+            driver.FindWidgetsBatch(selectors, rev, err);
+            for (auto &images : rev) {
+                auto group = json::array();
+                for (auto &ptr : images) {
+                    PushBackValueItemIntoJson<WidgetImage>(*ptr, group);
+                }
+                out.push_back(group);
+            }
         } else if (function == "UiDriver::TriggerKey") {
             const auto keyIndex = GetItemValueFromJson<uint32_t>(in, 0);
             uint32_t keyCode = 0;
@@ -113,6 +166,14 @@ namespace OHOS::uitest {
             } else {
                 driver.TriggerKey(*action, err);
             }
+        } else if (function == "UiDriver::FindWidgetAt" || function == "UiDriver::FindNearestClickableWidget") {
+            auto px = GetItemValueFromJson<int32_t>(in, 0);
+            auto py = GetItemValueFromJson<int32_t>(in, 1);
+            auto imgPtr = function == "UiDriver::FindWidgetAt" ? driver.FindWidgetAt({px, py}, err) :
+                driver.FindNearestClickableWidget({px, py}, err);
+            if (imgPtr != nullptr) {
+                PushBackValueItemIntoJson<WidgetImage>(*imgPtr, out);
+            }
         }
         // write back updated object meta-data
         caller.clear();
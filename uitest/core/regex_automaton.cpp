@@ -0,0 +1,688 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "regex_automaton.h"
+
+namespace OHOS::uitest {
+    using namespace std;
+
+    // limits of the supported expressions, which bound the compiling time and memory
+    static constexpr uint32_t MAX_REPEAT = 1000;
+    static constexpr uint32_t MAX_NESTING = 128;
+    static constexpr size_t MAX_NFA_STATES = 20000;
+    static constexpr size_t MAX_DFA_STATES = 2048;
+    // budgets of the compilation work, which runs synchronously in the caller. The count of the states visited by the
+    // epsilon closures and of the successors visited by the subset construction are quadratic in the count of the
+    // optional items, e.g. '(?:a?){1000}', the patterns exceeding them are rejected
+    static constexpr size_t MAX_CLOSURE_VISITS = 1 << 20;
+    static constexpr size_t MAX_SUBSET_VISITS = 1 << 22;
+    static constexpr uint32_t UNBOUNDED = numeric_limits<uint32_t>::max();
+    static constexpr uint32_t BYTE_COUNT = 256;
+    static constexpr uint8_t ASCII_END = 0x80;
+
+    /**Node of the parsed expression, a concatenation without children matches the empty string.*/
+    struct RegexNode {
+        enum Kind : uint8_t { BYTES, CONCAT, ALTERNATE, REPEAT };
+        Kind kind_ = CONCAT;
+        bitset<BYTE_COUNT> bytes_;
+        vector<uint32_t> children_;
+        uint32_t min_ = 0;
+        uint32_t max_ = 0;
+    };
+
+    /**Nondeterministic state, the byte states consume one byte in the set of the node, the split states do not.*/
+    struct NfaState {
+        enum Kind : uint8_t { BYTES, SPLIT, MATCH };
+        Kind kind_ = MATCH;
+        uint32_t node_ = 0;
+        int32_t out_ = -1;
+        int32_t out1_ = -1;
+    };
+
+    static bitset<BYTE_COUNT> GetByteRange(uint8_t from, uint8_t to)
+    {
+        bitset<BYTE_COUNT> bytes;
+        for (uint32_t byte = from; byte <= to; byte++) {
+            bytes.set(byte);
+        }
+        return bytes;
+    }
+
+    /**Get the bytes of the class escape (d, w or s), returns false if it's not a class escape.*/
+    static bool GetClassEscape(char escape, bitset<BYTE_COUNT> &bytes)
+    {
+        switch (escape) {
+            case 'd':
+                bytes = GetByteRange('0', '9');
+                return true;
+            case 'w':
+                bytes = GetByteRange('0', '9') | GetByteRange('a', 'z') | GetByteRange('A', 'Z');
+                bytes.set('_');
+                return true;
+            case 's':
+                bytes.reset();
+                for (auto space : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+                    bytes.set(static_cast<uint8_t>(space));
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**Get the byte of the single character escape, returns false if it's not supported.*/
+    static bool GetCharEscape(char escape, uint8_t &byte)
+    {
+        static constexpr char controls[] = "t\tn\nr\rf\fv\v";
+        for (size_t index = 0; controls[index] != '\0'; index += 2) {
+            if (controls[index] == escape) {
+                byte = static_cast<uint8_t>(controls[index + 1]);
+                return true;
+            }
+        }
+        // the escaped ASCII punctuations are literals, the other escapes (word boundary, back reference) are not
+        // supported
+        byte = static_cast<uint8_t>(escape);
+        return byte < ASCII_END && ispunct(byte);
+    }
+
+    /**Recursive descent parser of the expression, which appends the parsed nodes into the node list.*/
+    class RegexParser {
+    public:
+        RegexParser(string_view pattern, vector<RegexNode> &nodes) : pattern_(pattern), nodes_(nodes) {}
+
+        bool Parse(uint32_t &root)
+        {
+            return ParseAlternate(0, root) && pos_ == pattern_.length();
+        }
+
+    private:
+        uint32_t AddNode(RegexNode &&node)
+        {
+            nodes_.emplace_back(move(node));
+            return static_cast<uint32_t>(nodes_.size() - 1);
+        }
+
+        uint32_t AddBytes(const bitset<BYTE_COUNT> &bytes)
+        {
+            RegexNode node;
+            node.kind_ = RegexNode::BYTES;
+            node.bytes_ = bytes;
+            return AddNode(move(node));
+        }
+
+        /**Add the node matching one UTF-8 character, which is not any of the excluded ASCII bytes.*/
+        uint32_t AddNegatedClass(const bitset<BYTE_COUNT> &excluded)
+        {
+            if (multiByteNode_ == nullopt) {
+                // the lead bytes of the 2, 3 and 4 bytes sequences followed by the continuation bytes
+                static constexpr uint8_t leads[][2] = {{0xC2, 0xDF}, {0xE0, 0xEF}, {0xF0, 0xF4}};
+                const auto continuation = AddBytes(GetByteRange(0x80, 0xBF));
+                RegexNode sequences;
+                sequences.kind_ = RegexNode::ALTERNATE;
+                for (size_t length = 0; length < sizeof(leads) / sizeof(leads[0]); length++) {
+                    RegexNode sequence;
+                    sequence.children_.emplace_back(AddBytes(GetByteRange(leads[length][0], leads[length][1])));
+                    sequence.children_.insert(sequence.children_.end(), length + 1, continuation);
+                    sequences.children_.emplace_back(AddNode(move(sequence)));
+                }
+                multiByteNode_ = AddNode(move(sequences));
+            }
+            RegexNode node;
+            node.kind_ = RegexNode::ALTERNATE;
+            node.children_.emplace_back(AddBytes(GetByteRange(0, ASCII_END - 1) & ~excluded));
+            node.children_.emplace_back(*multiByteNode_);
+            return AddNode(move(node));
+        }
+
+        bool Consume(char expected)
+        {
+            if (pos_ < pattern_.length() && pattern_[pos_] == expected) {
+                pos_++;
+                return true;
+            }
+            return false;
+        }
+
+        bool ParseAlternate(uint32_t depth, uint32_t &result)
+        {
+            if (depth > MAX_NESTING) {
+                return false;
+            }
+            RegexNode node;
+            node.kind_ = RegexNode::ALTERNATE;
+            do {
+                uint32_t branch = 0;
+                if (!ParseConcat(depth, branch)) {
+                    return false;
+                }
+                node.children_.emplace_back(branch);
+            } while (Consume('|'));
+            result = node.children_.size() == 1 ? node.children_.front() : AddNode(move(node));
+            return true;
+        }
+
+        bool ParseConcat(uint32_t depth, uint32_t &result)
+        {
+            RegexNode node;
+            while (pos_ < pattern_.length() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+                // the whole value is matched, so the anchors at the ends of the alternatives match the empty string
+                if (node.children_.empty() && Consume('^')) {
+                    continue;
+                }
+                if (Consume('$')) {
+                    if (pos_ < pattern_.length() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+                        return false;
+                    }
+                    break;
+                }
+                uint32_t atom = 0;
+                if (!ParseAtom(depth, atom) || !ParseQuantifier(atom)) {
+                    return false;
+                }
+                node.children_.emplace_back(atom);
+            }
+            result = node.children_.size() == 1 ? node.children_.front() : AddNode(move(node));
+            return true;
+        }
+
+        bool ParseAtom(uint32_t depth, uint32_t &atom)
+        {
+            const auto current = static_cast<uint8_t>(pattern_[pos_++]);
+            bitset<BYTE_COUNT> bytes;
+            switch (current) {
+                case '(':
+                    if (Consume('?') && !Consume(':')) {
+                        return false; // the lookarounds are not supported
+                    }
+                    return ParseAlternate(depth + 1, atom) && Consume(')');
+                case '[':
+                    return ParseClass(atom);
+                case '.':
+                    bytes.set('\n');
+                    bytes.set('\r');
+                    atom = AddNegatedClass(bytes);
+                    return true;
+                case '\\': {
+                    if (pos_ >= pattern_.length()) {
+                        return false;
+                    }
+                    const auto escape = pattern_[pos_++];
+                    const auto lower = static_cast<char>(tolower(static_cast<uint8_t>(escape)));
+                    if (GetClassEscape(lower, bytes)) {
+                        atom = lower == escape ? AddBytes(bytes) : AddNegatedClass(bytes);
+                        return true;
+                    }
+                    uint8_t byte = 0;
+                    if (!GetCharEscape(escape, byte)) {
+                        return false;
+                    }
+                    bytes.set(byte);
+                    atom = AddBytes(bytes);
+                    return true;
+                }
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                    return false; // nothing to repeat
+                case '^':
+                    return false; // not at the start of the alternative
+                default:
+                    break;
+            }
+            bytes.set(current);
+            atom = AddBytes(bytes);
+            if (current < ASCII_END) {
+                return true;
+            }
+            // keep the bytes of a UTF-8 character together, so the quantifier repeats the whole character
+            RegexNode sequence;
+            sequence.children_.emplace_back(atom);
+            while (pos_ < pattern_.length() && (static_cast<uint8_t>(pattern_[pos_]) & 0xC0) == 0x80) {
+                bitset<BYTE_COUNT> continuation;
+                continuation.set(static_cast<uint8_t>(pattern_[pos_++]));
+                sequence.children_.emplace_back(AddBytes(continuation));
+            }
+            atom = sequence.children_.size() == 1 ? atom : AddNode(move(sequence));
+            return true;
+        }
+
+        /**Parse a character of the bracket class, which is an ASCII character or a single character escape.*/
+        bool ParseClassChar(uint8_t &byte)
+        {
+            if (pos_ >= pattern_.length()) {
+                return false;
+            }
+            byte = static_cast<uint8_t>(pattern_[pos_++]);
+            if (byte == '\\') {
+                return pos_ < pattern_.length() && GetCharEscape(pattern_[pos_++], byte);
+            }
+            return byte < ASCII_END;
+        }
+
+        bool ParseClass(uint32_t &atom)
+        {
+            bitset<BYTE_COUNT> bytes;
+            const bool negated = Consume('^');
+            for (bool first = true;; first = false) {
+                if (pos_ >= pattern_.length()) {
+                    return false;
+                }
+                if (!first && Consume(']')) {
+                    break;
+                }
+                bitset<BYTE_COUNT> escaped;
+                if (pattern_[pos_] == '\\' && pos_ + 1 < pattern_.length() &&
+                    GetClassEscape(pattern_[pos_ + 1], escaped)) {
+                    pos_ += 2;
+                    bytes |= escaped;
+                    continue;
+                }
+                uint8_t low = 0;
+                if (!ParseClassChar(low)) {
+                    return false;
+                }
+                if (pos_ + 1 < pattern_.length() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+                    pos_++;
+                    uint8_t high = 0;
+                    if (!ParseClassChar(high) || high < low) {
+                        return false;
+                    }
+                    bytes |= GetByteRange(low, high);
+                } else {
+                    bytes.set(low);
+                }
+            }
+            atom = negated ? AddNegatedClass(bytes) : AddBytes(bytes);
+            return true;
+        }
+
+        bool ParseNumber(uint32_t &number)
+        {
+            const auto start = pos_;
+            number = 0;
+            for (; pos_ < pattern_.length() && isdigit(static_cast<uint8_t>(pattern_[pos_])); pos_++) {
+                number = min(number * 10 + static_cast<uint32_t>(pattern_[pos_] - '0'), MAX_REPEAT + 1);
+            }
+            return pos_ > start;
+        }
+
+        bool ParseQuantifier(uint32_t &atom)
+        {
+            RegexNode node;
+            node.kind_ = RegexNode::REPEAT;
+            if (Consume('*')) {
+                node.max_ = UNBOUNDED;
+            } else if (Consume('+')) {
+                node.min_ = 1;
+                node.max_ = UNBOUNDED;
+            } else if (Consume('?')) {
+                node.max_ = 1;
+            } else if (Consume('{')) {
+                if (!ParseNumber(node.min_)) {
+                    return false;
+                }
+                node.max_ = node.min_;
+                if (Consume(',') && !ParseNumber(node.max_)) {
+                    node.max_ = UNBOUNDED;
+                }
+                if (!Consume('}') || node.min_ > MAX_REPEAT || node.max_ < node.min_ ||
+                    (node.max_ != UNBOUNDED && node.max_ > MAX_REPEAT)) {
+                    return false;
+                }
+            } else {
+                return true;
+            }
+            // the lazy quantifiers match the same values as the greedy ones when the whole value is matched
+            Consume('?');
+            node.children_.emplace_back(atom);
+            atom = AddNode(move(node));
+            return true;
+        }
+
+        const string_view pattern_;
+        vector<RegexNode> &nodes_;
+        size_t pos_ = 0;
+        optional<uint32_t> multiByteNode_;
+    };
+
+    /**Thompson construction of the nondeterministic states, each node is emitted ahead of its continuation.*/
+    class NfaBuilder {
+    public:
+        NfaBuilder(const vector<RegexNode> &nodes, vector<NfaState> &states) : nodes_(nodes), states_(states) {}
+
+        /**Emit the states of the node which continue to the out state, returns false if there are too many states.*/
+        bool Emit(uint32_t index, int32_t out, int32_t &entry)
+        {
+            if (states_.size() > MAX_NFA_STATES) {
+                return false;
+            }
+            const auto &node = nodes_[index];
+            switch (node.kind_) {
+                case RegexNode::BYTES:
+                    entry = AddState(NfaState::BYTES, index, out, -1);
+                    return true;
+                case RegexNode::CONCAT:
+                    entry = out;
+                    for (auto child = node.children_.rbegin(); child != node.children_.rend(); child++) {
+                        if (!Emit(*child, entry, entry)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                case RegexNode::ALTERNATE:
+                    entry = out;
+                    for (auto child = node.children_.rbegin(); child != node.children_.rend(); child++) {
+                        int32_t branch = 0;
+                        if (!Emit(*child, out, branch)) {
+                            return false;
+                        }
+                        entry = child == node.children_.rbegin() ? branch : AddState(NfaState::SPLIT, 0, branch, entry);
+                    }
+                    return true;
+                default:
+                    return EmitRepeat(node, out, entry);
+            }
+        }
+
+    private:
+        int32_t AddState(NfaState::Kind kind, uint32_t node, int32_t out, int32_t out1)
+        {
+            states_.push_back({kind, node, out, out1});
+            return static_cast<int32_t>(states_.size() - 1);
+        }
+
+        bool EmitRepeat(const RegexNode &node, int32_t out, int32_t &entry)
+        {
+            const auto child = node.children_.front();
+            auto current = out;
+            if (node.max_ == UNBOUNDED) {
+                const auto loop = AddState(NfaState::SPLIT, 0, -1, out);
+                int32_t body = 0;
+                if (!Emit(child, loop, body)) {
+                    return false;
+                }
+                states_[loop].out_ = body;
+                current = loop;
+            } else {
+                // each optional occurrence either continues to the next one or skips all the rest
+                for (auto count = node.min_; count < node.max_; count++) {
+                    int32_t body = 0;
+                    if (!Emit(child, current, body)) {
+                        return false;
+                    }
+                    current = AddState(NfaState::SPLIT, 0, body, out);
+                }
+            }
+            for (uint32_t count = 0; count < node.min_; count++) {
+                if (!Emit(child, current, current)) {
+                    return false;
+                }
+            }
+            entry = current;
+            return true;
+        }
+
+        const vector<RegexNode> &nodes_;
+        vector<NfaState> &states_;
+    };
+
+    /**
+     * Collect the byte states reachable from the entry state by the split states, in the ids of the byte states, and
+     * if the match state is reachable. Each visited state takes one from the budget.
+     * @returns false if the budget is exhausted.
+     * */
+    static bool CollectClosure(const vector<NfaState> &states, const vector<uint32_t> &byteIds, int32_t entry,
+                               vector<uint32_t> &closure, bool &accepting, vector<uint32_t> &marks, uint32_t stamp,
+                               size_t &budget)
+    {
+        accepting = false;
+        vector<int32_t> stack = {entry};
+        while (!stack.empty()) {
+            const auto index = stack.back();
+            stack.pop_back();
+            if (index < 0 || marks[index] == stamp) {
+                continue;
+            }
+            if (budget == 0) {
+                return false;
+            }
+            budget--;
+            marks[index] = stamp;
+            const auto &state = states[index];
+            if (state.kind_ == NfaState::BYTES) {
+                closure.emplace_back(byteIds[index]);
+            } else if (state.kind_ == NfaState::SPLIT) {
+                stack.emplace_back(state.out1_);
+                stack.emplace_back(state.out_);
+            } else {
+                accepting = true;
+            }
+        }
+        sort(closure.begin(), closure.end());
+        return true;
+    }
+
+    unique_ptr<const RegexAutomaton> RegexAutomaton::Compile(string_view pattern)
+    {
+        vector<RegexNode> nodes;
+        uint32_t root = 0;
+        if (!RegexParser(pattern, nodes).Parse(root)) {
+            return nullptr;
+        }
+        vector<NfaState> states = {{NfaState::MATCH, 0, -1, -1}};
+        int32_t start = 0;
+        if (!NfaBuilder(nodes, states).Emit(root, 0, start)) {
+            return nullptr;
+        }
+        auto automaton = unique_ptr<RegexAutomaton>(new RegexAutomaton());
+        // number the byte states, and split the bytes into the classes by all the byte sets
+        vector<uint32_t> byteIds(states.size(), 0);
+        vector<uint32_t> setNodes;
+        for (uint32_t index = 0; index < states.size(); index++) {
+            if (states[index].kind_ == NfaState::BYTES) {
+                byteIds[index] = static_cast<uint32_t>(automaton->nfaBytes_.size());
+                automaton->nfaBytes_.emplace_back(nodes[states[index].node_].bytes_);
+                setNodes.emplace_back(states[index].node_);
+            }
+        }
+        sort(setNodes.begin(), setNodes.end());
+        setNodes.erase(unique(setNodes.begin(), setNodes.end()), setNodes.end());
+        auto &classes = automaton->byteClasses_;
+        uint32_t classCount = 1;
+        vector<int32_t> remap;
+        for (auto node : setNodes) {
+            remap.assign(classCount * 2, -1);
+            classCount = 0;
+            for (uint32_t byte = 0; byte < BYTE_COUNT; byte++) {
+                auto &mapped = remap[classes[byte] * 2 + (nodes[node].bytes_.test(byte) ? 1 : 0)];
+                if (mapped < 0) {
+                    mapped = static_cast<int32_t>(classCount++);
+                }
+                classes[byte] = static_cast<uint16_t>(mapped);
+            }
+        }
+        automaton->classCount_ = static_cast<uint16_t>(classCount);
+        vector<uint32_t> marks(states.size(), 0);
+        uint32_t stamp = 1;
+        size_t budget = MAX_CLOSURE_VISITS;
+        bool accepting = false;
+        for (uint32_t index = 0; index < states.size(); index++) {
+            if (states[index].kind_ == NfaState::BYTES) {
+                vector<uint32_t> closure;
+                if (!CollectClosure(states, byteIds, states[index].out_, closure, accepting, marks, stamp++, budget)) {
+                    return nullptr;
+                }
+                automaton->nfaNextAccepting_.push_back(accepting);
+                automaton->nfaNext_.emplace_back(move(closure));
+            }
+        }
+        if (!CollectClosure(states, byteIds, start, automaton->nfaStart_, accepting, marks, stamp++, budget)) {
+            return nullptr;
+        }
+        automaton->nfaStartAccepting_ = accepting;
+        if (!automaton->Determinize()) {
+            return nullptr;
+        }
+        return automaton;
+    }
+
+    bool RegexAutomaton::Determinize()
+    {
+        // representative byte of each class
+        vector<uint8_t> representatives(classCount_, 0);
+        for (uint32_t byte = BYTE_COUNT; byte > 0; byte--) {
+            representatives[byteClasses_[byte - 1]] = static_cast<uint8_t>(byte - 1);
+        }
+        // the sets of the byte states are the deterministic states, with the accepting flag appended if any
+        static constexpr uint32_t acceptingFlag = numeric_limits<uint32_t>::max();
+        map<vector<uint32_t>, int32_t> stateIds;
+        vector<vector<uint32_t>> stateSets;
+        auto findState = [&stateIds, &stateSets](vector<uint32_t> &&set) {
+            auto [iter, inserted] = stateIds.emplace(set, static_cast<int32_t>(stateSets.size()));
+            if (inserted) {
+                stateSets.emplace_back(move(set));
+            }
+            return iter->second;
+        };
+        auto startSet = nfaStart_;
+        if (nfaStartAccepting_) {
+            startSet.emplace_back(acceptingFlag);
+        }
+        findState(move(startSet));
+        vector<uint32_t> marks(nfaBytes_.size(), 0);
+        uint32_t stamp = 0;
+        size_t budget = MAX_SUBSET_VISITS;
+        for (size_t index = 0; index < stateSets.size(); index++) {
+            if (stateSets.size() > MAX_DFA_STATES) {
+                transitions_.clear();
+                return true; // too many states, simulate the nondeterministic states instead
+            }
+            for (uint32_t cls = 0; cls < classCount_; cls++) {
+                stamp++;
+                vector<uint32_t> next;
+                bool accepting = false;
+                for (auto id : stateSets[index]) {
+                    if (id == acceptingFlag || !nfaBytes_[id].test(representatives[cls])) {
+                        continue;
+                    }
+                    accepting = accepting || nfaNextAccepting_[id];
+                    if (nfaNext_[id].size() > budget) {
+                        return false;
+                    }
+                    budget -= nfaNext_[id].size();
+                    for (auto nextId : nfaNext_[id]) {
+                        if (marks[nextId] != stamp) {
+                            marks[nextId] = stamp;
+                            next.emplace_back(nextId);
+                        }
+                    }
+                }
+                if (next.empty() && !accepting) {
+                    transitions_.emplace_back(-1);
+                    continue;
+                }
+                sort(next.begin(), next.end());
+                if (accepting) {
+                    next.emplace_back(acceptingFlag);
+                }
+                transitions_.emplace_back(findState(move(next)));
+            }
+        }
+        for (auto &set : stateSets) {
+            accepting_.push_back(!set.empty() && set.back() == acceptingFlag);
+        }
+        // the nondeterministic states are not needed any more
+        nfaBytes_ = {};
+        nfaNext_ = {};
+        nfaNextAccepting_ = {};
+        nfaStart_ = {};
+        return true;
+    }
+
+    shared_ptr<const RegexAutomaton> RegexAutomaton::Get(string_view pattern)
+    {
+        static constexpr size_t cacheCapacity = 64;
+        static mutex cacheMutex;
+        static unordered_map<string, shared_ptr<const RegexAutomaton>> cache;
+        lock_guard<mutex> guard(cacheMutex);
+        auto find = cache.find(string(pattern));
+        if (find != cache.end()) {
+            return find->second;
+        }
+        if (cache.size() >= cacheCapacity) {
+            cache.clear(); // patterns are mostly reused in a short period, simply start over
+        }
+        shared_ptr<const RegexAutomaton> automaton = Compile(pattern);
+        cache.emplace(string(pattern), automaton);
+        return automaton;
+    }
+
+    bool RegexAutomaton::Matches(string_view value) const
+    {
+        if (accepting_.empty()) {
+            return SimulateMatches(value);
+        }
+        const auto *transitions = transitions_.data();
+        int32_t state = 0;
+        for (auto byte : value) {
+            state = transitions[state * classCount_ + byteClasses_[static_cast<uint8_t>(byte)]];
+            if (state < 0) {
+                return false;
+            }
+        }
+        return accepting_[state];
+    }
+
+    bool RegexAutomaton::SimulateMatches(string_view value) const
+    {
+        vector<uint32_t> current = nfaStart_;
+        vector<uint32_t> next;
+        vector<uint32_t> marks(nfaBytes_.size(), 0);
+        uint32_t stamp = 0;
+        bool accepting = nfaStartAccepting_;
+        for (auto byte : value) {
+            stamp++;
+            next.clear();
+            accepting = false;
+            for (auto id : current) {
+                if (!nfaBytes_[id].test(static_cast<uint8_t>(byte))) {
+                    continue;
+                }
+                accepting = accepting || nfaNextAccepting_[id];
+                for (auto nextId : nfaNext_[id]) {
+                    if (marks[nextId] != stamp) {
+                        marks[nextId] = stamp;
+                        next.emplace_back(nextId);
+                    }
+                }
+            }
+            if (next.empty() && !accepting) {
+                return false;
+            }
+            swap(current, next);
+        }
+        return accepting;
+    }
+} // namespace uitest
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REGEX_AUTOMATON_H
+#define REGEX_AUTOMATON_H
+
+#include <array>
+#include <bitset>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace OHOS::uitest {
+    /**
+     * Deterministic automaton compiled from a regular expression, which tests if a whole value matches the expression
+     * in one pass over its bytes without backtracking. The supported syntax is a subset of ECMAScript: literals, '.',
+     * bracket classes of ASCII characters and ranges, the escapes \d \w \s \D \W \S \t \n \r \f \v, groups,
+     * alternation, the greedy and lazy quantifiers * + ? {m} {m,} {m,n}, and the anchors '^' and '$' at the ends of
+     * the alternatives. '.' and the negated classes match one UTF-8 character.
+     * */
+    class RegexAutomaton {
+    public:
+        /**
+         * Compile the pattern, the states are determinized up front unless there are too many of them, then the
+         * nondeterministic states are simulated on matching. The compilation work is bounded, the patterns whose
+         * epsilon closures or subset construction exceed the budgets are rejected.
+         *
+         * @returns the compiled automaton, or <code>nullptr</code> if the pattern is illegal, not supported or too
+         * costly to compile.
+         * */
+        static std::unique_ptr<const RegexAutomaton> Compile(std::string_view pattern);
+
+        /**Get the compiled automaton of the pattern from the process-wide cache, returns nullptr if it's illegal.*/
+        static std::shared_ptr<const RegexAutomaton> Get(std::string_view pattern);
+
+        /**Check if the whole value matches the expression.*/
+        bool Matches(std::string_view value) const;
+
+        /**Get the count of the deterministic states, 0 if the nondeterministic states are simulated.*/
+        size_t GetStateCount() const
+        {
+            return accepting_.size();
+        }
+
+    private:
+        RegexAutomaton() = default;
+
+        /**
+         * Build the deterministic states by the subset construction, unless there are too many of them.
+         * @returns false if the construction exceeds the work budget.
+         * */
+        bool Determinize();
+
+        bool SimulateMatches(std::string_view value) const;
+
+        // the bytes are mapped to the classes which no byte set of the expression tells apart
+        std::array<uint16_t, 256> byteClasses_ = {};
+        uint16_t classCount_ = 0;
+        // deterministic transitions indexed by state * classCount_ + class, -1 for the dead state; state 0 is the start
+        std::vector<int32_t> transitions_;
+        std::vector<bool> accepting_;
+        // the nondeterministic byte states and their successors after the epsilon moves, for simulation only
+        std::vector<std::bitset<256>> nfaBytes_;
+        std::vector<std::vector<uint32_t>> nfaNext_;
+        std::vector<bool> nfaNextAccepting_;
+        std::vector<uint32_t> nfaStart_;
+        bool nfaStartAccepting_ = false;
+    };
+} // namespace uitest
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include "substring_search.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUBSTRING_SEARCH_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SUBSTRING_SEARCH_NEON 1
+#endif
+
+namespace OHOS::uitest {
+    using namespace std;
+
+    using SubstringKernel = size_t (*)(string_view text, string_view pattern);
+
+    /**Check the bytes between the first and the last ones of the pattern at the candidate position.*/
+    static inline bool VerifyCandidate(const char *candidate, string_view pattern)
+    {
+        return pattern.length() <= 2 || memcmp(candidate + 1, pattern.data() + 1, pattern.length() - 2) == 0;
+    }
+
+    /**Scalar kernel from the given position, which locates the first byte by memchr then checks the others.*/
+    static size_t FindScalarFrom(string_view text, string_view pattern, size_t from)
+    {
+        const auto *data = text.data();
+        const auto lastCandidate = text.length() - pattern.length();
+        const auto lastByte = pattern.back();
+        for (auto pos = from; pos <= lastCandidate; pos++) {
+            const auto *found = static_cast<const char *>(memchr(data + pos, pattern.front(), lastCandidate - pos + 1));
+            if (found == nullptr) {
+                break;
+            }
+            pos = static_cast<size_t>(found - data);
+            if (data[pos + pattern.length() - 1] == lastByte && VerifyCandidate(found, pattern)) {
+                return pos;
+            }
+        }
+        return string_view::npos;
+    }
+
+    static size_t FindScalar(string_view text, string_view pattern)
+    {
+        return FindScalarFrom(text, pattern, 0);
+    }
+
+#ifdef SUBSTRING_SEARCH_X86
+    __attribute__((target("avx2"))) static size_t FindAvx2(string_view text, string_view pattern)
+    {
+        static constexpr size_t width = 32;
+        const auto *data = text.data();
+        const auto lastOffset = pattern.length() - 1;
+        const auto first = _mm256_set1_epi8(pattern.front());
+        const auto last = _mm256_set1_epi8(pattern.back());
+        size_t pos = 0;
+        for (; pos + lastOffset + width <= text.length(); pos += width) {
+            const auto firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+            const auto lastBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos + lastOffset));
+            const auto matched = _mm256_and_si256(_mm256_cmpeq_epi8(firstBlock, first),
+                                                  _mm256_cmpeq_epi8(lastBlock, last));
+            for (auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matched)); mask != 0; mask &= mask - 1) {
+                const auto candidate = pos + static_cast<size_t>(__builtin_ctz(mask));
+                if (VerifyCandidate(data + candidate, pattern)) {
+                    return candidate;
+                }
+            }
+        }
+        return FindScalarFrom(text, pattern, pos);
+    }
+
+#ifdef __SSE2__
+    static size_t FindSse2(string_view text, string_view pattern)
+    {
+        static constexpr size_t width = 16;
+        const auto *data = text.data();
+        const auto lastOffset = pattern.length() - 1;
+        const auto first = _mm_set1_epi8(pattern.front());
+        const auto last = _mm_set1_epi8(pattern.back());
+        size_t pos = 0;
+        for (; pos + lastOffset + width <= text.length(); pos += width) {
+            const auto firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+            const auto lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + lastOffset));
+            const auto matched = _mm_and_si128(_mm_cmpeq_epi8(firstBlock, first), _mm_cmpeq_epi8(lastBlock, last));
+            for (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matched)); mask != 0; mask &= mask - 1) {
+                const auto candidate = pos + static_cast<size_t>(__builtin_ctz(mask));
+                if (VerifyCandidate(data + candidate, pattern)) {
+                    return candidate;
+                }
+            }
+        }
+        return FindScalarFrom(text, pattern, pos);
+    }
+#endif
+#endif
+
+#ifdef SUBSTRING_SEARCH_NEON
+    static size_t FindNeon(string_view text, string_view pattern)
+    {
+        static constexpr size_t width = 16;
+        // the mask holds 4 bits per byte after narrowing, keep one of them
+        static constexpr uint64_t nibbleBits = 0x8888888888888888ULL;
+        static constexpr uint32_t bitsPerByte = 4;
+        const auto *data = reinterpret_cast<const uint8_t *>(text.data());
+        const auto lastOffset = pattern.length() - 1;
+        const auto first = vdupq_n_u8(static_cast<uint8_t>(pattern.front()));
+        const auto last = vdupq_n_u8(static_cast<uint8_t>(pattern.back()));
+        size_t pos = 0;
+        for (; pos + lastOffset + width <= text.length(); pos += width) {
+            const auto matched = vandq_u8(vceqq_u8(vld1q_u8(data + pos), first),
+                                          vceqq_u8(vld1q_u8(data + pos + lastOffset), last));
+            auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matched), 4)), 0);
+            for (mask &= nibbleBits; mask != 0; mask &= mask - 1) {
+                const auto candidate = pos + static_cast<size_t>(__builtin_ctzll(mask)) / bitsPerByte;
+                if (VerifyCandidate(text.data() + candidate, pattern)) {
+                    return candidate;
+                }
+            }
+        }
+        return FindScalarFrom(text, pattern, pos);
+    }
+#endif
+
+    struct KernelSelection {
+        SubstringKernel kernel_;
+        const char *name_;
+    };
+
+    static KernelSelection SelectKernel()
+    {
+#ifdef SUBSTRING_SEARCH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {FindAvx2, "avx2"};
+        }
+#ifdef __SSE2__
+        return {FindSse2, "sse2"};
+#endif
+#endif
+#ifdef SUBSTRING_SEARCH_NEON
+        return {FindNeon, "neon"};
+#endif
+        return {FindScalar, "scalar"};
+    }
+
+    static const KernelSelection &GetKernel()
+    {
+        static const KernelSelection selection = SelectKernel();
+        return selection;
+    }
+
+    size_t FindSubstring(string_view text, string_view pattern)
+    {
+        if (pattern.empty()) {
+            return 0;
+        }
+        if (pattern.length() > text.length()) {
+            return string_view::npos;
+        }
+        if (pattern.length() == 1) {
+            const auto *found = static_cast<const char *>(memchr(text.data(), pattern.front(), text.length()));
+            return found == nullptr ? string_view::npos : static_cast<size_t>(found - text.data());
+        }
+        return GetKernel().kernel_(text, pattern);
+    }
+
+    const char *GetSubstringKernelName()
+    {
+        return GetKernel().name_;
+    }
+} // namespace uitest
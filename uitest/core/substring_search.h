@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUBSTRING_SEARCH_H
+#define SUBSTRING_SEARCH_H
+
+#include <string_view>
+
+namespace OHOS::uitest {
+    /**
+     * Find the first occurrence of the pattern in the text. The candidate positions are filtered by comparing the
+     * first and the last bytes of the pattern with a block of text positions at once, then verified. The vectorized
+     * kernel supported by the cpu (AVX2 or SSE2 on x86, NEON on arm64) is selected on first call, with a scalar one
+     * as fallback.
+     *
+     * @returns the position of the occurrence, or <code>std::string_view::npos</code> if not found.
+     * */
+    size_t FindSubstring(std::string_view text, std::string_view pattern);
+
+    /**Get the name of the selected kernel: "avx2", "sse2", "neon" or "scalar".*/
+    const char *GetSubstringKernelName();
+} // namespace uitest
+
+#endif
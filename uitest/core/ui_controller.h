@@ -30,6 +30,20 @@ namespace OHOS::uitest {
         HIGH = 3, MEDIUM = 2, LOW = 1
     };
 
+    /**
+     * The UI tree last updated through a UiController and the counters of its incremental updates. It's kept with
+     * the controller rather than with the UiDriver, so that the drivers created per api call update it incrementally.
+     * */
+    struct UiTreeState {
+        // guards the state, the changes are collected and applied under it
+        std::mutex mutex_;
+        // the snapshot of the last updated UI, nullptr if the UI was never fetched
+        std::shared_ptr<const WidgetTree> tree_ = nullptr;
+        // count of the incremental updates since the last whole UI fetch, and the string storage size by then
+        uint32_t incrementalUpdates_ = 0;
+        size_t fetchedStringStorage_ = 0;
+    };
+
     class UiController;
     // Prototype of function that provides UiControllers for given device, used to install controllers on demand.
     using UiControllerProvider = std::function<void(std::string_view, std::list<std::unique_ptr<UiController>> &)>;
@@ -42,6 +56,38 @@ namespace OHOS::uitest {
 
         virtual void GetCurrentUiDom(nlohmann::json& out) const = 0;
 
+        /**Push the nodes of current UI into the given builder, the default implementation pushes the dom data.*/
+        virtual void GetCurrentUiTree(WidgetTreeBuilder &builder) const
+        {
+            auto dom = nlohmann::json();
+            GetCurrentUiDom(dom);
+            builder.AcceptDom(dom);
+        }
+
+        /**
+         * Collect the ids of the nodes whose subtrees changed since the last collection, used to update the UI
+         * incrementally. Changes happened before the next collection are kept for it.
+         *
+         * @param ids: the receiver of the changed node ids, empty if the UI does not change.
+         * @returns false if the changes are unknown, then the whole UI should be fetched.
+         * */
+        virtual bool CollectChangedNodes(std::vector<int32_t> &ids) const
+        {
+            return false;
+        }
+
+        /**
+         * Push the nodes of the subtree rooted at the given node into the builder, returns false if unavailable.
+         *
+         * @param id: the id of the node.
+         * @param hierarchy: the hierarchy of the node on the last fetched UI, which locates it from the root.
+         * @param builder: the receiver of the nodes.
+         * */
+        virtual bool GetUiSubtree(int32_t id, std::string_view hierarchy, WidgetTreeBuilder &builder) const
+        {
+            return false;
+        }
+
         virtual void WaitForUiSteady(uint32_t idleThresholdMs, uint32_t timeoutSec) const {};
 
         virtual void InjectTouchEventSequence(const std::vector<TouchEvent>& events) const {};
@@ -75,6 +121,12 @@ namespace OHOS::uitest {
             this->priority_ = val;
         }
 
+        /**Get the state of the UI tree updated through this controller, which is released with the controller.*/
+        UiTreeState &GetUiTreeState() const
+        {
+            return uiTreeState_;
+        }
+
         static void RegisterControllerProvider(UiControllerProvider func);
 
         static void RegisterController(std::unique_ptr<UiController> controller, Priority priority);
@@ -93,6 +145,7 @@ namespace OHOS::uitest {
         const std::string name_;
         const std::string targetDevice_;
         Priority priority_ = Priority::MEDIUM;
+        mutable UiTreeState uiTreeState_;
         static std::mutex controllerAccessMutex_;
         static std::list<std::unique_ptr<UiController>> controllers_;
         static UiControllerProvider controllerProvider_;
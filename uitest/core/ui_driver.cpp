@@ -20,21 +20,10 @@ namespace OHOS::uitest {
     using namespace std;
     using namespace nlohmann;
 
-    class TreeSnapshotTaker : public WidgetVisitor {
-    public:
-        explicit TreeSnapshotTaker(stringstream &receiver) : receiver_(receiver) {};
-
-        ~TreeSnapshotTaker() {}
-
-        void Visit(const Widget &widget) override
-        {
-            receiver_ << widget.GetAttr(ATTR_NAMES[UiAttr::TYPE], "") << "/";
-            receiver_ << widget.GetAttr(ATTR_NAMES[UiAttr::TEXT], "") << ";";
-        }
-
-    private:
-        stringstream &receiver_;
-    };
+    // limits of the incremental UI updates between the whole UI fetches, by count and by the string storage growth
+    static constexpr uint32_t MAX_INCREMENTAL_UPDATES = 64;
+    static constexpr size_t STRING_STORAGE_GROWTH_LIMIT = 2;
+    static constexpr size_t MIN_STRING_STORAGE_LIMIT = 64 * 1024;
 
     void UiDriver::UpdateUi(bool updateUiTree, ApiCallErr &error)
     {
@@ -48,10 +37,73 @@ namespace OHOS::uitest {
         if (!updateUiTree) {
             return;
         }
-        widgetTree_ = make_unique<WidgetTree>("");
-        auto domData = json();
-        uiController_->GetCurrentUiDom(domData);
-        widgetTree_->ConstructFromDom(domData, true);
+        // the UI tree is kept with the controller, so it's updated incrementally across the driver instances
+        auto &state = uiController_->GetUiTreeState();
+        lock_guard<mutex> guard(state.mutex_);
+        widgetTree_ = state.tree_;
+        // collect the changes ahead of fetching, changes happened during fetching are left to the next update
+        vector<int32_t> changedIds;
+        const bool changesKnown = uiController_->CollectChangedNodes(changedIds);
+        if (changesKnown && widgetTree_ != nullptr) {
+            if (changedIds.empty()) {
+                return;
+            }
+            // the incremental snapshots share the string storage, which keeps all the refetched strings, so start
+            // over periodically to release the strings no longer used
+            const auto storage = widgetTree_->GetStringStorageSize();
+            const bool storageGrown = storage > max(state.fetchedStringStorage_ * STRING_STORAGE_GROWTH_LIMIT,
+                                                    MIN_STRING_STORAGE_LIMIT);
+            if (state.incrementalUpdates_ < MAX_INCREMENTAL_UPDATES && !storageGrown &&
+                UpdateUiTreeIncrementally(changedIds)) {
+                state.tree_ = widgetTree_;
+                state.incrementalUpdates_++;
+                return;
+            }
+            LOG_I("Cannot update UI incrementally, fetch the whole UI");
+        }
+        auto newTree = make_shared<WidgetTree>("");
+        // controllers push nodes into the tree directly, without building the intermediate dom
+        auto controller = uiController_;
+        newTree->ConstructFromSource([controller](WidgetTreeBuilder &builder) {
+            controller->GetCurrentUiTree(builder);
+        }, true);
+        widgetTree_ = move(newTree);
+        state.tree_ = widgetTree_;
+        state.incrementalUpdates_ = 0;
+        state.fetchedStringStorage_ = widgetTree_->GetStringStorageSize();
+    }
+
+    shared_ptr<const WidgetTree> UiDriver::TakeUiSnapshot(ApiCallErr &err)
+    {
+        UpdateUi(true, err);
+        if (err.code_ != NO_ERROR) {
+            return nullptr;
+        }
+        return widgetTree_;
+    }
+
+    bool UiDriver::UpdateUiTreeIncrementally(const vector<int32_t> &changedIds)
+    {
+        vector<const Widget *> dirtyRoots;
+        for (auto id : changedIds) {
+            auto widget = widgetTree_->GetWidgetById(id);
+            // unknown node or the root node changed, which might change the whole UI
+            if (widget == nullptr || widget == widgetTree_->GetRootWidget()) {
+                return false;
+            }
+            dirtyRoots.emplace_back(widget);
+        }
+        auto newTree = make_shared<WidgetTree>("");
+        auto controller = uiController_;
+        auto source = [controller](const Widget &widget, WidgetTreeBuilder &builder) {
+            return controller->GetUiSubtree(widget.GetIntAttr(UiAttr::ID), widget.GetHierarchy(), builder);
+        };
+        if (!newTree->ConstructFromBase(*widgetTree_, dirtyRoots, source, true)) {
+            return false;
+        }
+        LOG_D("Updated %{public}zu subtrees of UI incrementally", dirtyRoots.size());
+        widgetTree_ = move(newTree);
+        return true;
     }
 
     /**Inflate widget-image attributes from the given widget-object and the selector.*/
@@ -73,11 +125,14 @@ namespace OHOS::uitest {
         }
         // retrieve widget by hashcode or by hierarchy
         auto hashcodeMatcher = WidgetAttrMatcher(ATTR_HASHCODE, img.GetHashCode(), EQ);
-        auto hierarchyMatcher = WidgetAttrMatcher(ATTR_HIERARCHY, img.GetHierarchy(), EQ);
-        auto anyMatcher = Any(hashcodeMatcher, hierarchyMatcher);
         vector<reference_wrapper<const Widget>> recv;
-        auto visitor = MatchedWidgetCollector(anyMatcher, recv);
+        auto visitor = MatchedWidgetCollector(hashcodeMatcher, recv, 1);
         widgetTree_->DfsTraverse(visitor);
+        // hierarchy is resolved by tree lookup rather than generating and comparing it on each widget
+        auto hierarchyMatched = widgetTree_->GetWidgetByHierarchy(img.GetHierarchy());
+        if (hierarchyMatched != nullptr && (recv.empty() || hierarchyMatched != &(recv.at(0).get()))) {
+            recv.emplace_back(*hierarchyMatched);
+        }
         stringstream msg;
         msg << "Widget: " << img.GetSelectionDesc();
         msg << "dose not exist on current UI! Check if the UI has changed after you got the widget object";
@@ -139,7 +194,7 @@ namespace OHOS::uitest {
         static constexpr string_view attrType = ATTR_NAMES[UiAttr::TYPE];
         // scrollable widget usually has unique type on a UI frame, some find it by type
         auto typeMatcher = WidgetAttrMatcher(attrType, img.GetAttribute(attrType, ""), EQ);
-        auto visitor = MatchedWidgetCollector(typeMatcher, recv);
+        auto visitor = MatchedWidgetCollector(typeMatcher, recv, 1);
         widgetTree_->DfsTraverse(visitor);
         if (recv.empty()) {
             return nullptr;
@@ -237,20 +292,12 @@ namespace OHOS::uitest {
         uiController_->WaitForUiSteady(options_.uiSteadyThresholdMs_, options_.waitUiSteadyMaxMs_);
     }
 
-    static string TakeScopeUiSnapshot(const WidgetTree &tree, const Widget &root)
-    {
-        stringstream os;
-        TreeSnapshotTaker snapshotTaker(os);
-        tree.DfsTraverseDescendants(snapshotTaker, root);
-        return os.str();
-    }
-
     unique_ptr<WidgetImage> UiDriver::ScrollSearch(const WidgetImage &img, const WidgetSelector &selector,
                                                    ApiCallErr &err, int32_t deadZoneSize)
     {
         vector<TouchEvent> scrollEvents;
         bool scrollingUp = true;
-        string prevSnapshot;
+        optional<uint64_t> prevSnapshot;
         vector<reference_wrapper<const Widget>> receiver;
         while (true) {
             auto scrollWidget = RetrieveWidget(img, err);
@@ -263,13 +310,13 @@ namespace OHOS::uitest {
             if (scrollWidget == nullptr || err.code_ != NO_ERROR) {
                 return nullptr;
             }
-            selector.Select(*widgetTree_, receiver);
+            selector.Select(*widgetTree_, receiver, 1);
             if (!receiver.empty()) {
                 auto image = make_unique<WidgetImage>();
                 Widget2Image(receiver.at(0), *image, selector);
                 return image;
             }
-            string snapshot = TakeScopeUiSnapshot(*widgetTree_, *scrollWidget);
+            const auto snapshot = widgetTree_->GetSubtreeHash(*scrollWidget);
             if (snapshot == prevSnapshot) {
                 // scrolling down to bottom, search completed with failure
                 if (!scrollingUp) {
@@ -300,7 +347,7 @@ namespace OHOS::uitest {
 
     void UiDriver::ScrollToEdge(const WidgetImage &img, bool scrollingUp, int32_t deadZoneSize, ApiCallErr &err)
     {
-        string prevSnapshot;
+        optional<uint64_t> prevSnapshot;
         while (true) {
             auto scrollWidget = RetrieveWidget(img, err);
             if (scrollWidget == nullptr) {
@@ -312,7 +359,7 @@ namespace OHOS::uitest {
             if (scrollWidget == nullptr || err.code_ != NO_ERROR) {
                 return;
             }
-            string snapshot = TakeScopeUiSnapshot(*widgetTree_, *scrollWidget);
+            const auto snapshot = widgetTree_->GetSubtreeHash(*scrollWidget);
             if (snapshot == prevSnapshot) {
                 return;
             }
@@ -349,15 +396,12 @@ namespace OHOS::uitest {
         InjectGenericSwipe(PointerOp::DRAG_P, centerFrom, centerTo, *uiController_, options_);
     }
 
-    void UiDriver::FindWidgets(const WidgetSelector &select, vector<unique_ptr<WidgetImage>> &rev, ApiCallErr &err)
+    /**Select widgets on the tree and convert them to images.*/
+    static void SelectWidgetImages(const WidgetTree &tree, const WidgetSelector &select,
+                                   vector<unique_ptr<WidgetImage>> &rev, size_t limit = 0)
     {
-        UpdateUi(true, err);
-        if (err.code_ != NO_ERROR) {
-            return;
-        }
         vector<reference_wrapper<const Widget>> widgets;
-        select.Select(*widgetTree_, widgets);
-        // covert widgets to images as return value
+        select.Select(tree, widgets, limit);
         uint32_t index = 0;
         for (auto &ref:widgets) {
             auto image = make_unique<WidgetImage>();
@@ -371,13 +415,38 @@ namespace OHOS::uitest {
         }
     }
 
+    void UiDriver::FindWidgets(const WidgetSelector &select, vector<unique_ptr<WidgetImage>> &rev, ApiCallErr &err,
+                               size_t limit)
+    {
+        UpdateUi(true, err);
+        if (err.code_ != NO_ERROR) {
+            return;
+        }
+        SelectWidgetImages(*widgetTree_, select, rev, limit);
+    }
+
+    void UiDriver::FindWidgetsBatch(const vector<WidgetSelector> &selectors,
+                                    vector<vector<unique_ptr<WidgetImage>>> &rev, ApiCallErr &err)
+    {
+        UpdateUi(true, err);
+        if (err.code_ != NO_ERROR) {
+            return;
+        }
+        // the predicate match sets are cached on the snapshot, so the shared predicates are evaluated once
+        const auto snapshot = widgetTree_;
+        for (auto &select : selectors) {
+            rev.emplace_back();
+            SelectWidgetImages(*snapshot, select, rev.back());
+        }
+    }
+
     unique_ptr<WidgetImage> UiDriver::WaitForWidget(const WidgetSelector &select, uint32_t maxMs, ApiCallErr &err)
     {
         const uint32_t sliceMs = 20;
         const auto startMs = GetCurrentMillisecond();
         vector<unique_ptr<WidgetImage>> receiver;
         do {
-            FindWidgets(select, receiver, err);
+            FindWidgets(select, receiver, err, 1);
             if (err.code_ != NO_ERROR) { // abort on error
                 return nullptr;
             }
@@ -389,6 +458,40 @@ namespace OHOS::uitest {
         return nullptr;
     }
 
+    /**Convert the widget located by point to image, the selection description records the point.*/
+    static unique_ptr<WidgetImage> LocatedWidget2Image(const Widget *widget, string_view locator, const Point &point)
+    {
+        if (widget == nullptr) {
+            return nullptr;
+        }
+        auto image = make_unique<WidgetImage>();
+        WidgetSelector selector; // dummy selector
+        Widget2Image(*widget, *image, selector);
+        stringstream desc;
+        desc << locator << "(" << point.px_ << "," << point.py_ << ")";
+        image->SetSelectionDesc(desc.str());
+        return image;
+    }
+
+    unique_ptr<WidgetImage> UiDriver::FindWidgetAt(const Point &point, ApiCallErr &err)
+    {
+        UpdateUi(true, err);
+        if (err.code_ != NO_ERROR) {
+            return nullptr;
+        }
+        return LocatedWidget2Image(widgetTree_->GetWidgetAt(point), "At", point);
+    }
+
+    unique_ptr<WidgetImage> UiDriver::FindNearestClickableWidget(const Point &point, ApiCallErr &err)
+    {
+        UpdateUi(true, err);
+        if (err.code_ != NO_ERROR) {
+            return nullptr;
+        }
+        auto clickable = [](const Widget &widget) { return widget.GetBoolAttr(UiAttr::CLICKABLE); };
+        return LocatedWidget2Image(widgetTree_->GetNearestWidget(point, clickable), "NearestClickable", point);
+    }
+
     void UiDriver::UpdateWidgetImage(WidgetImage &image, ApiCallErr &error)
     {
         auto widget = RetrieveWidget(image, error);
@@ -40,10 +40,20 @@ namespace OHOS::uitest {
         /**Inject the given text to the given id-specified widget.*/
         void InputText(const WidgetImage &image, std::string_view text, ApiCallErr &error);
 
-        /**Find widgets with the given selector. Results are arranged in the receiver in <b>DFS</b> order.
+        /**Find widgets with the given selector, at most <code>limit</code> ones (0 for all). Results are arranged in
+         * the receiver in <b>DFS</b> order.
          * @returns the widget images.
          **/
-        void FindWidgets(const WidgetSelector &select, std::vector<std::unique_ptr<WidgetImage>> &rev, ApiCallErr &err);
+        void FindWidgets(const WidgetSelector &select, std::vector<std::unique_ptr<WidgetImage>> &rev, ApiCallErr &err,
+                         size_t limit = 0);
+
+        /**
+         * Find widgets with each of the given selectors on one UI snapshot, the UI is updated once for all of them and
+         * the predicates shared by the selectors are evaluated once. Results of each selector are arranged in the
+         * receiver in <b>DFS</b> order, in the order of the selectors.
+         **/
+        void FindWidgetsBatch(const std::vector<WidgetSelector> &selectors,
+                              std::vector<std::vector<std::unique_ptr<WidgetImage>>> &rev, ApiCallErr &err);
 
         /**Scroll on the given subject widget to find the target widget matching the selector.*/
         std::unique_ptr<WidgetImage> ScrollSearch(const WidgetImage &img, const WidgetSelector &selector,
@@ -58,6 +68,19 @@ namespace OHOS::uitest {
         /**Wait for the matching widget appear in the given timeout.*/
         std::unique_ptr<WidgetImage> WaitForWidget(const WidgetSelector &select, uint32_t maxMs, ApiCallErr &err);
 
+        /**Find the topmost widget at the given point on current UI, returns nullptr if there's no widget.*/
+        std::unique_ptr<WidgetImage> FindWidgetAt(const Point &point, ApiCallErr &err);
+
+        /**Find the clickable widget nearest to the given point on current UI, returns nullptr if there's none.*/
+        std::unique_ptr<WidgetImage> FindNearestClickableWidget(const Point &point, ApiCallErr &err);
+
+        /**
+         * Take the snapshot of current UI, which keeps unchanged while it's held. The snapshot is reused if the UI is
+         * unchanged since the last update, check <code>WidgetTree::GetGeneration</code> to tell the snapshots apart.
+         * @returns the snapshot, or nullptr if failed.
+         * */
+        std::shared_ptr<const WidgetTree> TakeUiSnapshot(ApiCallErr &err);
+
         /**Update the attributes of the WidgetImage from current UI.*/
         void UpdateWidgetImage(WidgetImage &image, ApiCallErr &error);
 
@@ -81,6 +104,9 @@ namespace OHOS::uitest {
         /**Update UI controller and UI objects.*/
         void UpdateUi(bool updateUiTree, ApiCallErr &error);
 
+        /**Update the changed subtrees of the UI tree, returns false if they cannot be updated incrementally.*/
+        bool UpdateUiTreeIncrementally(const std::vector<int32_t> &changedIds);
+
         /**Retrieve widget represented by the given WidgetImage from updated UI.*/
         const Widget *RetrieveWidget(const WidgetImage &img, ApiCallErr &err, bool updateUi = true);
 
@@ -92,7 +118,8 @@ namespace OHOS::uitest {
         /**The UI manipulation options.*/
         UiDriveOptions options_;
         // objects that are needed to be updated before each interaction and used in the interaction
-        std::unique_ptr<WidgetTree> widgetTree_ = nullptr;
+        // the snapshot of current UI, which is kept if the UI is unchanged and might be held by the callers
+        std::shared_ptr<const WidgetTree> widgetTree_ = nullptr;
         const UiController *uiController_ = nullptr;
     };
 }
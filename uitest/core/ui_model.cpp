@@ -14,7 +14,20 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "common_defines.h"
+#include "edit_distance.h"
+#include "regex_automaton.h"
+#include "substring_search.h"
 #include "ui_model.h"
 
 namespace OHOS::uitest {
@@ -22,6 +35,7 @@ namespace OHOS::uitest {
     using namespace nlohmann;
 
     static constexpr auto ROOT_HIERARCHY = "ROOT";
+    static constexpr char HIERARCHY_SEPARATOR = ',';
 
     void Rect::ComputeOverlappingDimensions(const Rect &other, int32_t &width, int32_t &height) const
     {
@@ -62,363 +76,2081 @@ namespace OHOS::uitest {
         return left_ == other.left_ && right_ == other.right_ && top_ == other.top_ && bottom_ == other.bottom_;
     }
 
-    static string Rect2JsonStr(const Rect &rect)
+    /**Get the byte length of the whitespace character at the offset, 0 if it's not a whitespace.*/
+    static inline size_t GetWhitespaceLength(string_view value, size_t offset)
     {
-        json data;
-        data[RECT_ATTR_LT_X] = rect.left_;
-        data[RECT_ATTR_LT_Y] = rect.top_;
-        data[RECT_ATTR_RB_X] = rect.right_;
-        data[RECT_ATTR_RB_Y] = rect.bottom_;
-        return data.dump();
+        static constexpr string_view noBreakSpace = "\u00a0";
+        static constexpr string_view ideographicSpace = "\u3000";
+        const auto ch = value[offset];
+        if (ch == ' ' || (ch >= '\t' && ch <= '\r')) {
+            return 1;
+        }
+        for (auto space : {noBreakSpace, ideographicSpace}) {
+            if (value.substr(offset, space.length()) == space) {
+                return space.length();
+            }
+        }
+        return 0;
     }
 
-    bool Widget::HasAttr(string_view name) const
+    /**Lower the capital letter encoded as 2-byte UTF-8 character in place, the lowered ones have the same length.*/
+    static inline void LowerTwoByteLetter(char *encoded)
     {
-        return attributes_.find(string(name)) != attributes_.end();
+        static constexpr uint32_t payloadBits = 6;
+        static constexpr uint8_t payloadMask = 0x3F;
+        static constexpr uint8_t leadBits = 0xC0;
+        static constexpr uint8_t continuationBit = 0x80;
+        const auto lead = static_cast<uint8_t>(encoded[0]);
+        const auto next = static_cast<uint8_t>(encoded[1]);
+        if ((next & leadBits) != continuationBit) {
+            return;
+        }
+        auto code = (static_cast<uint32_t>(lead & ~leadBits) << payloadBits) | (next & payloadMask);
+        if ((code >= 0xC0 && code <= 0xDE && code != 0xD7) || (code >= 0x391 && code <= 0x3A9 && code != 0x3A2) ||
+            (code >= 0x410 && code <= 0x42F)) {
+            code += 0x20; // Latin-1, Greek and Cyrillic capitals
+        } else if (code >= 0x400 && code <= 0x40F) {
+            code += 0x50; // Cyrillic capitals with diacritics
+        } else {
+            return;
+        }
+        encoded[0] = static_cast<char>(leadBits | (code >> payloadBits));
+        encoded[1] = static_cast<char>(continuationBit | (code & payloadMask));
     }
 
-    string Widget::GetAttr(string_view name, string_view defaultVal) const
+    void FoldValue(string_view value, uint8_t flags, string &receiver)
     {
-        auto find = attributes_.find(string(name));
-        return find == attributes_.end() ? string(defaultVal) : find->second;
+        static constexpr uint8_t twoByteLeadMask = 0xE0;
+        static constexpr uint8_t twoByteLead = 0xC0;
+        receiver.clear();
+        if ((flags & NORMALIZE_WHITESPACE) == 0) {
+            receiver.append(value);
+        } else {
+            bool pendingSpace = false;
+            for (size_t offset = 0; offset < value.length();) {
+                const auto spaceLength = GetWhitespaceLength(value, offset);
+                if (spaceLength > 0) {
+                    pendingSpace = !receiver.empty();
+                    offset += spaceLength;
+                    continue;
+                }
+                if (pendingSpace) {
+                    receiver.push_back(' ');
+                    pendingSpace = false;
+                }
+                receiver.push_back(value[offset++]);
+            }
+        }
+        if ((flags & IGNORE_CASE) == 0) {
+            return;
+        }
+        for (size_t offset = 0; offset < receiver.length(); offset++) {
+            const auto ch = receiver[offset];
+            if (ch >= 'A' && ch <= 'Z') {
+                receiver[offset] = static_cast<char>(ch - 'A' + 'a');
+            } else if ((static_cast<uint8_t>(ch) & twoByteLeadMask) == twoByteLead && offset + 1 < receiver.length()) {
+                LowerTwoByteLetter(&receiver[offset]);
+                offset++;
+            }
+        }
     }
 
-    void Widget::SetAttr(string_view name, string_view value)
+    /**Combine the value into the hash seed, with the splitmix64 finalizer to spread the bits.*/
+    static inline uint64_t MixHash(uint64_t seed, uint64_t value)
     {
-        attributes_[string(name)] = value;
+        uint64_t hash = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
     }
 
-    void Widget::SetHostTreeId(string_view tid)
+    /**FNV-1a hash of the string.*/
+    static inline uint64_t HashString(string_view str)
     {
-        hostTreeId_ = tid;
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (auto ch : str) {
+            hash = (hash ^ static_cast<uint8_t>(ch)) * 0x100000001b3ULL;
+        }
+        return hash;
     }
 
-    string Widget::GetHostTreeId() const
+    /**Hash of the widget contents covered by the subtree hashes, which are the type and text.*/
+    static inline uint64_t HashWidgetContent(const Widget &widget)
     {
-        return hostTreeId_;
+        return MixHash(HashString(widget.GetStrAttr(UiAttr::TYPE)), HashString(widget.GetStrAttr(UiAttr::TEXT)));
     }
 
-    void Widget::SetBounds(int32_t cl, int32_t cr, int32_t ct, int32_t cb)
+    static constexpr size_t INDEX_FANOUT = 16;
+
+    static inline bool RectContains(const Rect &rect, const Point &point)
     {
-        bounds_ = Rect(cl, cr, ct, cb);
-        // save bounds attribute as structured data
-        SetAttr(ATTR_NAMES[UiAttr::BOUNDS], Rect2JsonStr(bounds_));
+        return point.px_ >= rect.left_ && point.px_ < rect.right_ && point.py_ >= rect.top_ && point.py_ < rect.bottom_;
     }
 
-    string Widget::ToStr() const
+    static inline bool RectOverlaps(const Rect &rect, const Rect &other)
     {
-        stringstream os;
-        os << "Widget{";
-        for (auto &pair : attributes_) {
-            os << pair.first << "='" << pair.second << "',";
-        }
-        os << "}";
-        return os.str();
+        return rect.left_ < other.right_ && other.left_ < rect.right_ &&
+            rect.top_ < other.bottom_ && other.top_ < rect.bottom_;
     }
 
-    void Widget::DumpAttributes(map<string, string> &receiver) const
+    static inline void RectUnite(Rect &rect, const Rect &other)
+    {
+        rect.left_ = min(rect.left_, other.left_);
+        rect.right_ = max(rect.right_, other.right_);
+        rect.top_ = min(rect.top_, other.top_);
+        rect.bottom_ = max(rect.bottom_, other.bottom_);
+    }
+
+    static inline int64_t SquaredDistance(const Rect &rect, const Point &point)
     {
-        for (auto &[attr, value] : attributes_) {
-            receiver[attr] = value;
+        const int64_t dx = max({static_cast<int64_t>(rect.left_) - point.px_, int64_t(0),
+                                static_cast<int64_t>(point.px_) - rect.right_});
+        const int64_t dy = max({static_cast<int64_t>(rect.top_) - point.py_, int64_t(0),
+                                static_cast<int64_t>(point.py_) - rect.bottom_});
+        return dx * dx + dy * dy;
+    }
+
+    /**Sort-tile-recursive ordering: slice the boxes into vertical strips by center x, then sort each strip by center y,
+     * so that every INDEX_FANOUT consecutive boxes form a compact tile.*/
+    template<typename BoxOf>
+    static void SortTiles(vector<uint32_t> &refs, const BoxOf &boxOf)
+    {
+        const auto count = refs.size();
+        if (count <= INDEX_FANOUT) {
+            return;
+        }
+        const auto tileCount = (count + INDEX_FANOUT - 1) / INDEX_FANOUT;
+        const auto stripCount = static_cast<size_t>(ceil(sqrt(static_cast<double>(tileCount))));
+        const auto stripSize = ((tileCount + stripCount - 1) / stripCount) * INDEX_FANOUT;
+        sort(refs.begin(), refs.end(), [&boxOf](uint32_t a, uint32_t b) {
+            return boxOf(a).GetCenterX() < boxOf(b).GetCenterX();
+        });
+        for (size_t begin = 0; begin < count; begin += stripSize) {
+            const auto end = min(begin + stripSize, count);
+            sort(refs.begin() + begin, refs.begin() + end, [&boxOf](uint32_t a, uint32_t b) {
+                return boxOf(a).GetCenterY() < boxOf(b).GetCenterY();
+            });
         }
     }
 
-    class WidgetHierarchyBuilder {
-    public:
-        static string Build(string_view parentWidgetHierarchy, uint32_t childIndex)
-        {
-            return string(parentWidgetHierarchy) + string(hierarchySeparator_) + to_string(childIndex);
+    DfsBitset::DfsBitset(uint32_t size, bool full)
+        : size_(size), words_((size + WORD_BITS - 1) / WORD_BITS, full ? ~uint64_t(0) : 0)
+    {
+        if (full && size % WORD_BITS != 0) {
+            words_.back() >>= WORD_BITS - size % WORD_BITS;
         }
+    }
 
-        static string GetParentWidgetHierarchy(string_view hierarchy)
-        {
-            if (hierarchy == ROOT_HIERARCHY) {
-                // no parent for root widget
-                return "";
-            }
+    void DfsBitset::And(const DfsBitset &other)
+    {
+        DCHECK(size_ == other.size_);
+        const auto count = words_.size();
+        auto *words = words_.data();
+        const auto *others = other.words_.data();
+        for (size_t index = 0; index < count; index++) {
+            words[index] &= others[index];
+        }
+    }
 
-            auto findRoot = hierarchy.find(ROOT_HIERARCHY);
-            if (findRoot != 0) {
-                // invalid hierarchy string
-                return "";
-            }
-            auto findLastSeparator = hierarchy.find_last_of(hierarchySeparator_);
-            if (findLastSeparator <= 0 || findLastSeparator == string::npos) {
-                return "";
-            }
-            return string(hierarchy).substr(0, findLastSeparator);
+    void DfsBitset::Or(const DfsBitset &other)
+    {
+        DCHECK(size_ == other.size_);
+        const auto count = words_.size();
+        auto *words = words_.data();
+        const auto *others = other.words_.data();
+        for (size_t index = 0; index < count; index++) {
+            words[index] |= others[index];
         }
+    }
 
-        static string GetChildHierarchy(string_view hierarchy, uint32_t childIndex)
-        {
-            if (hierarchy.find(ROOT_HIERARCHY) != 0) {
-                // invalid hierarchy string
-                return "";
-            }
-            return string(hierarchy) + string(hierarchySeparator_) + to_string(childIndex);
+    void DfsBitset::AndNot(const DfsBitset &other)
+    {
+        DCHECK(size_ == other.size_);
+        const auto count = words_.size();
+        auto *words = words_.data();
+        const auto *others = other.words_.data();
+        for (size_t index = 0; index < count; index++) {
+            words[index] &= ~others[index];
         }
+    }
 
-        static bool CheckIsDescendantHierarchyOfRoot(string_view hierarchy, string_view hierarchyRoot)
-        {
-            // child node hierarchy must startswith parent node hierarchy
-            return hierarchy.find(hierarchyRoot) == 0;
+    void DfsBitset::KeepRange(uint32_t from, uint32_t to)
+    {
+        to = min(to, size_);
+        if (from >= to) {
+            fill(words_.begin(), words_.end(), 0);
+            return;
         }
+        const auto firstWord = from / WORD_BITS;
+        const auto lastWord = (to - 1) / WORD_BITS;
+        fill(words_.begin(), words_.begin() + firstWord, 0);
+        fill(words_.begin() + lastWord + 1, words_.end(), 0);
+        words_[firstWord] &= ~uint64_t(0) << (from % WORD_BITS);
+        words_[lastWord] &= ~uint64_t(0) >> (WORD_BITS - 1 - (to - 1) % WORD_BITS);
+    }
 
-    private:
-        static constexpr auto hierarchySeparator_ = ",";
-    };
+    void DfsBitset::SetRange(uint32_t from, uint32_t to)
+    {
+        to = min(to, size_);
+        if (from >= to) {
+            return;
+        }
+        const auto firstWord = from / WORD_BITS;
+        const auto lastWord = (to - 1) / WORD_BITS;
+        const auto firstMask = ~uint64_t(0) << (from % WORD_BITS);
+        const auto lastMask = ~uint64_t(0) >> (WORD_BITS - 1 - (to - 1) % WORD_BITS);
+        if (firstWord == lastWord) {
+            words_[firstWord] |= firstMask & lastMask;
+            return;
+        }
+        words_[firstWord] |= firstMask;
+        fill(words_.begin() + firstWord + 1, words_.begin() + lastWord, ~uint64_t(0));
+        words_[lastWord] |= lastMask;
+    }
 
-    static void SetWidgetBounds(Widget &widget, string_view boundsStr)
+    uint32_t DfsBitset::Count() const
     {
-        // set bounds
-        int32_t val = -1;
-        int32_t integers[4];
-        int32_t index = 0;
-        bool negative = false;
-        static constexpr int32_t FACTOR = 10;
-        for (char ch : boundsStr) {
-            if (ch == '-') {
-                DCHECK(val == -1); // should be a start of a number
-                negative = true;
-            } else if (ch >= '0' && ch <= '9') {
-                val = max(val, 0); // ensure accumulation
-                val = val * FACTOR + (int32_t)(ch - '0');
-            } else if (val >= 0) {
-                DCHECK(index < INDEX_FOUR);
-                integers[index] = val * (negative ? -1 : 1);
-                // after harvest, rest variables and increase ptrIdx
-                index++;
-                val = -1;
-                negative = false;
-            }
+        uint32_t count = 0;
+        for (auto word : words_) {
+            count += static_cast<uint32_t>(__builtin_popcountll(word));
         }
+        return count;
+    }
 
-        DCHECK(index == INDEX_FOUR);
-        widget.SetBounds(integers[INDEX_ZERO], integers[INDEX_TWO], integers[INDEX_ONE], integers[INDEX_THREE]);
+    bool DfsBitset::IsEmpty() const
+    {
+        return all_of(words_.begin(), words_.end(), [](uint64_t word) { return word == 0; });
     }
 
-    static void SetWidgetAttributes(Widget &widget, const map<string, string> &attributes)
+    bool DfsBitset::FindFirst(uint32_t &index) const
     {
-        for (auto &item : attributes) {
-            if (item.first == ATTR_NAMES[UiAttr::BOUNDS]) {
-                SetWidgetBounds(widget, item.second);
-            } else {
-                widget.SetAttr(item.first, item.second);
+        for (uint32_t word = 0; word < words_.size(); word++) {
+            if (words_[word] != 0) {
+                index = word * WORD_BITS + static_cast<uint32_t>(__builtin_ctzll(words_[word]));
+                return true;
             }
         }
+        return false;
     }
 
-    void WidgetTree::DfsTraverse(WidgetVisitor &visitor) const
+    bool DfsBitset::FindLast(uint32_t &index) const
     {
-        auto root = GetRootWidget();
-        if (root != nullptr) {
-            DfsTraverseDescendants(visitor, *root);
+        for (auto word = static_cast<uint32_t>(words_.size()); word > 0; word--) {
+            if (words_[word - 1] != 0) {
+                index = word * WORD_BITS - 1 - static_cast<uint32_t>(__builtin_clzll(words_[word - 1]));
+                return true;
+            }
         }
+        return false;
     }
 
-    void WidgetTree::DfsTraverseFronts(WidgetVisitor &visitor, const Widget &pivot) const
+    SpatialIndex::SpatialIndex(const vector<Rect> &rects) : rects_(rects)
     {
-        DCHECK(widgetsConstructed_);
-        DCHECK(CheckIsMyNode(pivot));
-        auto root = GetRootWidget();
-        if (root == nullptr) {
+        const auto count = rects_.size();
+        if (count == 0) {
             return;
         }
-        auto pivotHierarchy = pivot.GetHierarchy();
-        for (auto &hierarchy : widgetHierarchyIdDfsOrder_) {
-            if (hierarchy == pivotHierarchy) {
-                // hit the pivot, finish traversing
-                break;
+        items_.resize(count);
+        for (uint32_t id = 0; id < count; id++) {
+            items_[id] = id;
+        }
+        SortTiles(items_, [this](uint32_t id) -> const Rect & { return rects_[id]; });
+        for (size_t begin = 0; begin < count; begin += INDEX_FANOUT) {
+            Node leaf;
+            leaf.begin_ = begin;
+            leaf.end_ = min(begin + INDEX_FANOUT, count);
+            leaf.box_ = rects_[items_[begin]];
+            for (auto index = leaf.begin_ + 1; index < leaf.end_; index++) {
+                RectUnite(leaf.box_, rects_[items_[index]]);
+            }
+            nodes_.emplace_back(leaf);
+        }
+        // pack the nodes level by level until the single root is reached
+        size_t levelBegin = 0;
+        while (nodes_.size() - levelBegin > 1) {
+            const auto levelEnd = nodes_.size();
+            vector<uint32_t> refs(levelEnd - levelBegin);
+            for (size_t index = 0; index < refs.size(); index++) {
+                refs[index] = levelBegin + index;
+            }
+            SortTiles(refs, [this](uint32_t ref) -> const Rect & { return nodes_[ref].box_; });
+            vector<Node> level;
+            level.reserve(refs.size());
+            for (auto ref : refs) {
+                level.emplace_back(nodes_[ref]);
+            }
+            copy(level.begin(), level.end(), nodes_.begin() + levelBegin);
+            for (auto begin = levelBegin; begin < levelEnd; begin += INDEX_FANOUT) {
+                Node parent;
+                parent.leaf_ = false;
+                parent.begin_ = begin;
+                parent.end_ = min(begin + INDEX_FANOUT, levelEnd);
+                parent.box_ = nodes_[begin].box_;
+                for (auto index = parent.begin_ + 1; index < parent.end_; index++) {
+                    RectUnite(parent.box_, nodes_[index].box_);
+                }
+                nodes_.emplace_back(parent);
             }
-            auto widget = widgetMap_.find(hierarchy);
-            DCHECK(widget != widgetMap_.end());
-            visitor.Visit(widget->second);
+            levelBegin = levelEnd;
         }
     }
 
-    void WidgetTree::DfsTraverseRears(WidgetVisitor &visitor, const Widget &pivot) const
+    void SpatialIndex::QueryPoint(const Point &point, vector<uint32_t> &ids) const
     {
-        DCHECK(widgetsConstructed_);
-        DCHECK(CheckIsMyNode(pivot));
-        auto root = GetRootWidget();
-        if (root == nullptr) {
+        if (nodes_.empty()) {
             return;
         }
-        auto pivotHierarchy = pivot.GetHierarchy();
-        bool traverseStarted = false;
-        for (auto &hierarchy : widgetHierarchyIdDfsOrder_) {
-            if (hierarchy == pivotHierarchy) {
-                // skip self and start traverse from next one
-                traverseStarted = true;
+        vector<uint32_t> stack = {static_cast<uint32_t>(nodes_.size() - 1)};
+        while (!stack.empty()) {
+            const auto &node = nodes_[stack.back()];
+            stack.pop_back();
+            if (!RectContains(node.box_, point)) {
                 continue;
             }
-            if (!traverseStarted) {
-                // skip front widgets
+            for (auto index = node.begin_; index < node.end_; index++) {
+                if (!node.leaf_) {
+                    stack.emplace_back(index);
+                } else if (RectContains(rects_[items_[index]], point)) {
+                    ids.emplace_back(items_[index]);
+                }
+            }
+        }
+        sort(ids.begin(), ids.end());
+    }
+
+    void SpatialIndex::QueryRect(const Rect &area, vector<uint32_t> &ids) const
+    {
+        if (nodes_.empty()) {
+            return;
+        }
+        vector<uint32_t> stack = {static_cast<uint32_t>(nodes_.size() - 1)};
+        while (!stack.empty()) {
+            const auto &node = nodes_[stack.back()];
+            stack.pop_back();
+            if (!RectOverlaps(node.box_, area)) {
                 continue;
             }
-            auto widget = widgetMap_.find(hierarchy);
-            DCHECK(widget != widgetMap_.end());
-            visitor.Visit(widget->second);
+            for (auto index = node.begin_; index < node.end_; index++) {
+                if (!node.leaf_) {
+                    stack.emplace_back(index);
+                } else if (RectOverlaps(rects_[items_[index]], area)) {
+                    ids.emplace_back(items_[index]);
+                }
+            }
         }
+        sort(ids.begin(), ids.end());
     }
 
-    void WidgetTree::DfsTraverseDescendants(WidgetVisitor &visitor, const Widget &root) const
+    bool SpatialIndex::QueryNearest(const Point &point, const function<bool(uint32_t)> &filter, uint32_t &id) const
     {
-        DCHECK(widgetsConstructed_);
-        DCHECK(CheckIsMyNode(root));
-        bool traverseStarted = false;
-        auto rootHierarchy = root.GetHierarchy();
-        for (auto &hierarchy : widgetHierarchyIdDfsOrder_) {
-            if (!WidgetHierarchyBuilder::CheckIsDescendantHierarchyOfRoot(hierarchy, rootHierarchy)) {
-                if (!traverseStarted) {
-                    continue; // root node not found yet, skip visiting current widget and go ahead
+        if (nodes_.empty()) {
+            return false;
+        }
+        struct Entry {
+            int64_t distance_;
+            bool item_;
+            uint32_t ref_;
+        };
+        // best-first search, nodes are expanded ahead of the items at the same distance to find all the ties
+        auto lowerPriority = [](const Entry &a, const Entry &b) {
+            if (a.distance_ != b.distance_) {
+                return a.distance_ > b.distance_;
+            }
+            if (a.item_ != b.item_) {
+                return a.item_;
+            }
+            return a.ref_ < b.ref_;
+        };
+        priority_queue<Entry, vector<Entry>, decltype(lowerPriority)> queue(lowerPriority);
+        const auto rootIndex = static_cast<uint32_t>(nodes_.size() - 1);
+        queue.push({SquaredDistance(nodes_[rootIndex].box_, point), false, rootIndex});
+        while (!queue.empty()) {
+            const auto entry = queue.top();
+            queue.pop();
+            if (entry.item_) {
+                if (filter(entry.ref_)) {
+                    id = entry.ref_;
+                    return true;
+                }
+                continue;
+            }
+            const auto &node = nodes_[entry.ref_];
+            for (auto index = node.begin_; index < node.end_; index++) {
+                if (node.leaf_) {
+                    queue.push({SquaredDistance(rects_[items_[index]], point), true, items_[index]});
                 } else {
-                    break; // descendant nodes are all visited, break
+                    queue.push({SquaredDistance(nodes_[index].box_, point), false, index});
                 }
             }
-            traverseStarted = true;
-            auto widget = widgetMap_.find(hierarchy);
-            DCHECK(widget != widgetMap_.end());
-            visitor.Visit(widget->second);
         }
+        return false;
+    }
+
+    /**Append the decimal text of the value without allocating the temporary string.*/
+    static void AppendInt(int32_t value, string &out)
+    {
+        static constexpr size_t capacity = 16;
+        char buf[capacity];
+        auto result = to_chars(begin(buf), end(buf), value);
+        out.append(buf, result.ptr - buf);
+    }
+
+    /**Render the rect as the json text dumped by nlohmann json (whose object keys are ordered) into the buffer.*/
+    static void RenderRectJson(const Rect &rect, string &out)
+    {
+        using Field = pair<string_view, int32_t Rect::*>;
+        static const auto fields = []() {
+            array<Field, INDEX_FOUR> sorted = {Field(RECT_ATTR_LT_X, &Rect::left_),
+                Field(RECT_ATTR_LT_Y, &Rect::top_), Field(RECT_ATTR_RB_X, &Rect::right_),
+                Field(RECT_ATTR_RB_Y, &Rect::bottom_)};
+            sort(sorted.begin(), sorted.end(), [](const Field &a, const Field &b) { return a.first < b.first; });
+            return sorted;
+        }();
+        out.clear();
+        out.push_back('{');
+        for (auto &[name, member] : fields) {
+            if (out.length() > 1) {
+                out.push_back(',');
+            }
+            out.push_back('"');
+            out.append(name);
+            out.append("\":");
+            AppendInt(rect.*member, out);
+        }
+        out.push_back('}');
+    }
+
+    static string Rect2JsonStr(const Rect &rect)
+    {
+        string text;
+        RenderRectJson(rect, text);
+        return text;
     }
 
-    using NodeVisitor = function<void(string_view, map<string, string> &&)>;
+    static constexpr size_t POOL_BLOCK_SIZE = 4096;
+    static constexpr auto BUILTIN_ATTR_COUNT = static_cast<uint8_t>(sizeof(ATTR_NAMES) / sizeof(ATTR_NAMES[0]));
+    static constexpr string_view TRUE_STR = "true";
+    static constexpr string_view FALSE_STR = "false";
 
-    static void DfsVisitNode(const json &root, NodeVisitor visitor, string_view hierarchy)
+    string_view StringPool::Intern(string_view str)
     {
-        DCHECK(visitor != nullptr);
-        auto attributesData = root["attributes"];
-        auto childrenData = root["children"];
-        map<string, string> attributeDict;
-        for (auto &item : attributesData.items()) {
-            attributeDict[item.key()] = item.value();
+        if (str.empty()) {
+            return string_view();
         }
-        visitor(hierarchy, move(attributeDict));
-        const size_t childCount = childrenData.size();
-        for (size_t idx = 0; idx < childCount; idx++) {
-            auto &child = childrenData.at(idx);
-            auto childHierarchy = WidgetHierarchyBuilder::Build(hierarchy, idx);
-            DfsVisitNode(child, visitor, childHierarchy);
+        if (auto find = views_.find(str); find != views_.end()) {
+            return *find;
+        }
+        char *dest = nullptr;
+        if (str.length() > POOL_BLOCK_SIZE / INDEX_FOUR) {
+            // large string occupies an exclusive block, insert it ahead to keep the current block in use
+            auto block = make_unique<char[]>(str.length());
+            dest = block.get();
+            blocks_.insert(blocks_.end() - (blocks_.empty() ? 0 : 1), move(block));
+        } else {
+            if (blocks_.empty() || blockUsed_ + str.length() > POOL_BLOCK_SIZE) {
+                blocks_.emplace_back(make_unique<char[]>(POOL_BLOCK_SIZE));
+                blockUsed_ = 0;
+            }
+            dest = blocks_.back().get() + blockUsed_;
+            blockUsed_ += str.length();
         }
+        copy(str.begin(), str.end(), dest);
+        auto view = string_view(dest, str.length());
+        views_.insert(view);
+        storedBytes_ += str.length();
+        return view;
     }
 
-    void WidgetTree::ConstructFromDom(const nlohmann::json &dom, bool amendBounds)
+    /**Resolve the builtin attribute of the given name, returns false if it's not a builtin one.*/
+    static bool ResolveBuiltinAttr(string_view name, UiAttr &attr)
     {
-        DCHECK(!widgetsConstructed_);
-        map<string, map<string, string>> widgetDict;
-        vector<string> visitTrace;
-        auto nodeVisitor = [&widgetDict, &visitTrace](string_view hierarchy, map<string, string> &&attrs) {
-            visitTrace.emplace_back(hierarchy);
-            widgetDict.insert(make_pair(hierarchy, attrs));
-        };
-        DfsVisitNode(dom, nodeVisitor, ROOT_HIERARCHY);
-        for (auto &hierarchy : visitTrace) {
-            auto findWidgetAttrs = widgetDict.find(hierarchy);
-            DCHECK(findWidgetAttrs != widgetDict.end());
-            Widget widget(hierarchy);
-            widget.SetHostTreeId(this->identifier_);
-            SetWidgetAttributes(widget, findWidgetAttrs->second);
-            auto findParent = widgetMap_.find(WidgetHierarchyBuilder::GetParentWidgetHierarchy(hierarchy));
-            const auto bounds = widget.GetBounds();
-            auto newBounds = Rect(0, 0, 0, 0);
-            if (!amendBounds || hierarchy == ROOT_HIERARCHY) {
-                newBounds = bounds;
-            } else if (findParent == widgetMap_.end()) {
-                newBounds = Rect(0, 0, 0, 0); // parent was discarded
-            } else {
-                // amend bounds, intersect with parent, compute visibility
-                auto parentBounds = findParent->second.GetBounds();
-                if (!bounds.ComputeIntersection(parentBounds, newBounds)) {
-                    newBounds = Rect(0, 0, 0, 0);
-                }
+        for (uint8_t index = 0; index < BUILTIN_ATTR_COUNT; index++) {
+            if (name == ATTR_NAMES[index]) {
+                attr = static_cast<UiAttr>(index);
+                return true;
             }
-            if (!newBounds.CompareTo(bounds)) {
-                widget.SetBounds(newBounds.left_, newBounds.right_, newBounds.top_, newBounds.bottom_);
-                LOG_D("Amend bounds %{public}s from %{public}s", widget.ToStr().c_str(), Rect2JsonStr(bounds).c_str());
+        }
+        return false;
+    }
+
+    /**Parse the id value, returns false if it cannot be restored exactly from the parsed integer.*/
+    static bool ParseIdValue(string_view text, int32_t &value)
+    {
+        static constexpr int64_t FACTOR = 10;
+        const bool negative = !text.empty() && text.front() == '-';
+        const auto digits = negative ? text.substr(1) : text;
+        if (digits.empty() || (digits.front() == '0' && (digits.length() > 1 || negative))) {
+            return false; // empty, leading zero or negative zero
+        }
+        int64_t result = 0;
+        for (char ch : digits) {
+            if (ch < '0' || ch > '9') {
+                return false;
             }
-            if (!amendBounds || (newBounds.GetWidth() > 0 && newBounds.GetHeight() > 0)) {
-                widgetMap_.insert(make_pair(hierarchy, move(widget)));
-                widgetHierarchyIdDfsOrder_.emplace_back(hierarchy);
-            } else {
-                LOG_D("Discard invisible node '%{public}s'and its descendants", widget.ToStr().c_str());
+            result = result * FACTOR + (ch - '0');
+            if (result > INT32_MAX + (negative ? 1LL : 0LL)) {
+                return false;
             }
         }
-        widgetsConstructed_ = true;
+        value = static_cast<int32_t>(negative ? -result : result);
+        return true;
     }
 
-    static void DfsMarshalWidget(const WidgetTree& tree, const Widget& root, nlohmann::json& dom)
+    Widget::Widget(string_view hierarchy) : standalone_(make_unique<StandaloneData>())
     {
-        auto attributesData = json();
-        auto dict = map<string, string>();
-        root.DumpAttributes(dict);
-        for (auto& [name, value] : dict) {
-            if (name == ATTR_HIERARCHY) { // do not expose inner used attributes
-                continue;
+        pool_ = &(standalone_->pool_);
+        standalone_->hierarchy_ = hierarchy;
+    }
+
+    const pair<string_view, string_view> *Widget::FindCustomAttr(string_view name) const
+    {
+        for (auto &entry : customAttrs_) {
+            if (entry.first == name) {
+                return &entry;
             }
-            attributesData[name] = value;
         }
-        stringstream stream;
-        auto rect = root.GetBounds();
-        stream << "[" << rect.left_ << "," << rect.top_ << "]" << "[" << rect.right_ << "," << rect.bottom_ << "]";
-        attributesData[ATTR_NAMES[UiAttr::BOUNDS]] = stream.str();
-        
-        auto childrenData = json::array();
-        uint32_t childIndex = 0;
-        auto child = tree.GetChildWidget(root, childIndex);
-        while (child != nullptr) {
-            auto childData = json();
-            DfsMarshalWidget(tree, *child, childData);
-            childrenData.emplace_back(childData);
-            childIndex++;
-            child = tree.GetChildWidget(root, childIndex);
+        return nullptr;
+    }
+
+    bool Widget::HasAttr(string_view name) const
+    {
+        if (name == ATTR_HIERARCHY) {
+            return true;
         }
-        
-        dom["attributes"] = attributesData;
-        dom["children"] = childrenData;
+        UiAttr attr;
+        if (ResolveBuiltinAttr(name, attr) && (presentBits_ & (1U << attr)) != 0) {
+            return true;
+        }
+        return FindCustomAttr(name) != nullptr;
     }
 
-    void WidgetTree::MarshalIntoDom(nlohmann::json& dom) const
+    string Widget::GetAttr(string_view name, string_view defaultVal) const
     {
-        DCHECK(widgetsConstructed_);
-        auto root = GetRootWidget();
-        if (root != nullptr) {
-            DfsMarshalWidget(*this, *root, dom);
+        if (name == ATTR_HIERARCHY) {
+            return GetHierarchy();
         }
+        UiAttr attr;
+        if (ResolveBuiltinAttr(name, attr) && (presentBits_ & (1U << attr)) != 0) {
+            return RenderAttr(attr);
+        }
+        auto entry = FindCustomAttr(name);
+        return entry == nullptr ? string(defaultVal) : string(entry->second);
     }
 
-    const Widget *WidgetTree::GetRootWidget() const
+    bool Widget::GetCustomAttr(string_view name, string_view &value) const
     {
-        return GetWidgetByHierarchy(ROOT_HIERARCHY);
+        auto entry = FindCustomAttr(name);
+        if (entry == nullptr) {
+            return false;
+        }
+        value = entry->second;
+        return true;
     }
 
-    const Widget *WidgetTree::GetParentWidget(const Widget &widget) const
+    string_view Widget::GetStrAttr(UiAttr attr) const
     {
-        DCHECK(CheckIsMyNode(widget));
-        if (widget.GetHierarchy() == ROOT_HIERARCHY) {
-            return nullptr;
+        DCHECK(ATTR_TYPES[attr] == STRING);
+        if ((presentBits_ & (1U << attr)) != 0) {
+            return strings_[attr - UiAttr::TEXT];
         }
-        const auto parentHierarchy = WidgetHierarchyBuilder::GetParentWidgetHierarchy(widget.GetHierarchy());
-        return GetWidgetByHierarchy(parentHierarchy);
+        auto entry = FindCustomAttr(ATTR_NAMES[attr]);
+        return entry == nullptr ? string_view() : entry->second;
     }
 
-    const Widget *WidgetTree::GetChildWidget(const Widget &widget, uint32_t index) const
+    bool Widget::GetBoolAttr(UiAttr attr) const
     {
-        DCHECK(CheckIsMyNode(widget));
-        if (index < 0) {
-            return nullptr;
+        DCHECK(ATTR_TYPES[attr] == BOOL);
+        return (presentBits_ & boolBits_ & (1U << attr)) != 0;
+    }
+
+    int32_t Widget::GetIntAttr(UiAttr attr) const
+    {
+        DCHECK(ATTR_TYPES[attr] == INT);
+        return (presentBits_ & (1U << attr)) != 0 ? id_ : 0;
+    }
+
+    void Widget::RenderAttr(UiAttr attr, string &buffer) const
+    {
+        buffer.clear();
+        switch (ATTR_TYPES[attr]) {
+            case INT:
+                AppendInt(id_, buffer);
+                break;
+            case STRING:
+                buffer.append(strings_[attr - UiAttr::TEXT]);
+                break;
+            case RECT_JSON:
+                RenderRectJson(bounds_, buffer);
+                break;
+            case BOOL:
+                buffer.append((boolBits_ & (1U << attr)) != 0 ? TRUE_STR : FALSE_STR);
+                break;
+            default:
+                break;
         }
-        auto childHierarchy = WidgetHierarchyBuilder::GetChildHierarchy(widget.GetHierarchy(), index);
-        return GetWidgetByHierarchy(childHierarchy);
     }
 
-    const Widget *WidgetTree::GetWidgetByHierarchy(string_view hierarchy) const
+    bool Widget::GetAttrView(string_view name, string &buffer, string_view &value) const
     {
-        auto findWidget = widgetMap_.find(string(hierarchy));
-        if (findWidget != widgetMap_.end()) {
-            return &(findWidget->second);
+        if (name == ATTR_HIERARCHY) {
+            if (hostTopology_ == nullptr) {
+                value = standalone_->hierarchy_;
+            } else {
+                WidgetTree::BuildHierarchy(*hostTopology_, hostIndex_, buffer);
+                value = buffer;
+            }
+            return true;
         }
-        return nullptr;
+        UiAttr attr;
+        if (ResolveBuiltinAttr(name, attr) && (presentBits_ & (1U << attr)) != 0) {
+            if (ATTR_TYPES[attr] == STRING) {
+                value = strings_[attr - UiAttr::TEXT];
+            } else if (ATTR_TYPES[attr] == BOOL) {
+                value = (boolBits_ & (1U << attr)) != 0 ? TRUE_STR : FALSE_STR;
+            } else {
+                RenderAttr(attr, buffer);
+                value = buffer;
+            }
+            return true;
+        }
+        auto entry = FindCustomAttr(name);
+        if (entry == nullptr) {
+            return false;
+        }
+        value = entry->second;
+        return true;
+    }
+
+    string Widget::RenderAttr(UiAttr attr) const
+    {
+        switch (ATTR_TYPES[attr]) {
+            case INT:
+                return to_string(id_);
+            case STRING:
+                return string(strings_[attr - UiAttr::TEXT]);
+            case RECT_JSON:
+                return Rect2JsonStr(bounds_);
+            case BOOL:
+                return string((boolBits_ & (1U << attr)) != 0 ? TRUE_STR : FALSE_STR);
+            default:
+                return "";
+        }
+    }
+
+    string Widget::GetHierarchy() const
+    {
+        if (hostTopology_ == nullptr) {
+            return standalone_->hierarchy_;
+        }
+        return WidgetTree::BuildHierarchy(*hostTopology_, hostIndex_);
+    }
+
+    void Widget::SetAttr(string_view name, string_view value)
+    {
+        UiAttr attr;
+        bool typed = false;
+        if (ResolveBuiltinAttr(name, attr)) {
+            const uint16_t bit = 1U << attr;
+            switch (ATTR_TYPES[attr]) {
+                case INT:
+                    typed = ParseIdValue(value, id_);
+                    break;
+                case STRING:
+                    strings_[attr - UiAttr::TEXT] = pool_->Intern(value);
+                    typed = true;
+                    break;
+                case BOOL:
+                    typed = value == TRUE_STR || value == FALSE_STR;
+                    if (typed) {
+                        boolBits_ = value == TRUE_STR ? (boolBits_ | bit) : (boolBits_ & ~bit);
+                    }
+                    break;
+                default:
+                    break; // bounds text is not parsed here, keep it as custom value
+            }
+            presentBits_ = typed ? (presentBits_ | bit) : (presentBits_ & ~bit);
+        }
+        auto entry = find_if(customAttrs_.begin(), customAttrs_.end(), [name](const auto &e) {
+            return e.first == name;
+        });
+        if (typed) {
+            if (entry != customAttrs_.end()) {
+                customAttrs_.erase(entry);
+            }
+        } else if (entry != customAttrs_.end()) {
+            entry->second = pool_->Intern(value);
+        } else {
+            customAttrs_.emplace_back(pool_->Intern(name), pool_->Intern(value));
+        }
+    }
+
+    void Widget::SetHostTreeId(string_view tid)
+    {
+        if (standalone_ != nullptr) {
+            standalone_->hostTreeId_ = tid;
+        }
+    }
+
+    string Widget::GetHostTreeId() const
+    {
+        return hostTopology_ == nullptr ? standalone_->hostTreeId_ : hostTopology_->treeId_;
+    }
+
+    void Widget::SetBounds(int32_t cl, int32_t cr, int32_t ct, int32_t cb)
+    {
+        bounds_ = Rect(cl, cr, ct, cb);
+        // bounds are kept as structured data and rendered on demand
+        presentBits_ |= (1U << UiAttr::BOUNDS);
+        auto entry = find_if(customAttrs_.begin(), customAttrs_.end(), [](const auto &e) {
+            return e.first == ATTR_NAMES[UiAttr::BOUNDS];
+        });
+        if (entry != customAttrs_.end()) {
+            customAttrs_.erase(entry);
+        }
+    }
+
+    string Widget::ToStr() const
+    {
+        stringstream os;
+        os << "Widget{" << ATTR_HIERARCHY << "='" << GetHierarchy() << "',";
+        for (uint8_t index = 0; index < BUILTIN_ATTR_COUNT; index++) {
+            if ((presentBits_ & (1U << index)) != 0) {
+                os << ATTR_NAMES[index] << "='" << RenderAttr(static_cast<UiAttr>(index)) << "',";
+            }
+        }
+        for (auto &[name, value] : customAttrs_) {
+            os << name << "='" << value << "',";
+        }
+        os << "}";
+        return os.str();
+    }
+
+    void Widget::DumpAttributes(map<string, string> &receiver) const
+    {
+        receiver[ATTR_HIERARCHY] = GetHierarchy();
+        for (uint8_t index = 0; index < BUILTIN_ATTR_COUNT; index++) {
+            if ((presentBits_ & (1U << index)) != 0) {
+                receiver[ATTR_NAMES[index]] = RenderAttr(static_cast<UiAttr>(index));
+            }
+        }
+        for (auto &[name, value] : customAttrs_) {
+            receiver[string(name)] = value;
+        }
+    }
+
+    static void SetWidgetBounds(Widget &widget, string_view boundsStr)
+    {
+        // set bounds
+        int32_t val = -1;
+        int32_t integers[4];
+        int32_t index = 0;
+        bool negative = false;
+        static constexpr int32_t FACTOR = 10;
+        for (char ch : boundsStr) {
+            if (ch == '-') {
+                DCHECK(val == -1); // should be a start of a number
+                negative = true;
+            } else if (ch >= '0' && ch <= '9') {
+                val = max(val, 0); // ensure accumulation
+                val = val * FACTOR + (int32_t)(ch - '0');
+            } else if (val >= 0) {
+                DCHECK(index < INDEX_FOUR);
+                integers[index] = val * (negative ? -1 : 1);
+                // after harvest, rest variables and increase ptrIdx
+                index++;
+                val = -1;
+                negative = false;
+            }
+        }
+
+        DCHECK(index == INDEX_FOUR);
+        widget.SetBounds(integers[INDEX_ZERO], integers[INDEX_TWO], integers[INDEX_ONE], integers[INDEX_THREE]);
+    }
+
+    void WidgetTree::DfsTraverse(WidgetVisitor &visitor) const
+    {
+        for (size_t index = 0; index < widgets_.GetSize() && !visitor.IsSatisfied(); index++) {
+            visitor.Visit(widgets_[index]);
+        }
+    }
+
+    void WidgetTree::DfsTraverseFronts(WidgetVisitor &visitor, const Widget &pivot) const
+    {
+        DCHECK(widgetsConstructed_);
+        DCHECK(CheckIsMyNode(pivot));
+        for (uint32_t index = 0; index < pivot.hostIndex_ && !visitor.IsSatisfied(); index++) {
+            visitor.Visit(widgets_[index]);
+        }
+    }
+
+    void WidgetTree::DfsTraverseRears(WidgetVisitor &visitor, const Widget &pivot) const
+    {
+        DCHECK(widgetsConstructed_);
+        DCHECK(CheckIsMyNode(pivot));
+        // skip self and start traverse from next one
+        for (uint32_t index = pivot.hostIndex_ + 1; index < widgets_.GetSize() && !visitor.IsSatisfied(); index++) {
+            visitor.Visit(widgets_[index]);
+        }
+    }
+
+    void WidgetTree::DfsTraverseDescendants(WidgetVisitor &visitor, const Widget &root) const
+    {
+        DCHECK(widgetsConstructed_);
+        DCHECK(CheckIsMyNode(root));
+        // descendants are arranged right after the root in dfs order
+        const auto end = nodes_[root.hostIndex_].subtreeEnd_;
+        for (uint32_t index = root.hostIndex_; index < end && !visitor.IsSatisfied(); index++) {
+            visitor.Visit(widgets_[index]);
+        }
+    }
+
+    void WidgetTree::DfsTraverseAncestors(WidgetVisitor &visitor, const Widget &widget) const
+    {
+        DCHECK(widgetsConstructed_);
+        DCHECK(CheckIsMyNode(widget));
+        vector<int32_t> ancestors;
+        for (auto cursor = nodes_[widget.hostIndex_].parent_; cursor >= 0; cursor = nodes_[cursor].parent_) {
+            ancestors.emplace_back(cursor);
+        }
+        for (auto iter = ancestors.rbegin(); iter != ancestors.rend() && !visitor.IsSatisfied(); iter++) {
+            visitor.Visit(widgets_[*iter]);
+        }
+    }
+
+    void WidgetTree::GetDfsInterval(const Widget &widget, uint32_t &enter, uint32_t &exit) const
+    {
+        DCHECK(CheckIsMyNode(widget));
+        enter = widget.hostIndex_;
+        exit = nodes_[widget.hostIndex_].subtreeEnd_;
+    }
+
+    bool WidgetTree::IsDescendantOf(const Widget &widget, const Widget &ancestor) const
+    {
+        DCHECK(CheckIsMyNode(widget) && CheckIsMyNode(ancestor));
+        return widget.hostIndex_ > ancestor.hostIndex_ && widget.hostIndex_ < nodes_[ancestor.hostIndex_].subtreeEnd_;
+    }
+
+    uint64_t WidgetTree::GetSubtreeHash(const Widget &widget) const
+    {
+        DCHECK(CheckIsMyNode(widget));
+        return nodes_[widget.hostIndex_].subtreeHash_;
+    }
+
+    void WidgetTree::CollectChangedSubtrees(const Widget &root, const WidgetTree &base, const Widget &baseRoot,
+                                            vector<const Widget *> &receiver) const
+    {
+        DCHECK(CheckIsMyNode(root) && base.CheckIsMyNode(baseRoot));
+        vector<pair<int32_t, int32_t>> pending = {{root.hostIndex_, baseRoot.hostIndex_}};
+        while (!pending.empty()) {
+            const auto [index, baseIndex] = pending.back();
+            pending.pop_back();
+            if (nodes_[index].subtreeHash_ == base.nodes_[baseIndex].subtreeHash_) {
+                continue;
+            }
+            // descend into the children pairwise if the node itself and its children count are unchanged
+            vector<pair<int32_t, int32_t>> childPairs;
+            auto child = nodes_[index].firstChild_;
+            auto baseChild = base.nodes_[baseIndex].firstChild_;
+            for (; child >= 0 && baseChild >= 0; child = nodes_[child].nextSibling_) {
+                childPairs.emplace_back(child, baseChild);
+                baseChild = base.nodes_[baseChild].nextSibling_;
+            }
+            const auto sameContent = HashWidgetContent(widgets_[index]) == HashWidgetContent(base.widgets_[baseIndex]);
+            if (!sameContent || child >= 0 || baseChild >= 0 || childPairs.empty()) {
+                receiver.emplace_back(&widgets_[index]);
+                continue;
+            }
+            // keep dfs order of the results
+            pending.insert(pending.end(), childPairs.rbegin(), childPairs.rend());
+        }
+    }
+
+    uint32_t WidgetTree::AppendWidget(Widget &&widget, int32_t parent, uint32_t childIndex, vector<int32_t> &lastChildren)
+    {
+        const auto index = static_cast<uint32_t>(widgets_.GetSize());
+        widget.hostTopology_ = topology_.get();
+        widget.hostIndex_ = index;
+        widgets_.EmplaceBack(move(widget));
+        WidgetNode node;
+        node.parent_ = parent;
+        node.childIndex_ = childIndex;
+        node.subtreeEnd_ = index + 1;
+        nodes_.EmplaceBack(node);
+        lastChildren.emplace_back(-1);
+        if (parent >= 0) {
+            auto &prevSibling = lastChildren[parent];
+            if (prevSibling < 0) {
+                nodes_.GetMutable(parent).firstChild_ = index;
+            } else {
+                nodes_.GetMutable(prevSibling).nextSibling_ = index;
+            }
+            prevSibling = index;
+        }
+        return index;
+    }
+
+    int32_t WidgetTree::AppendBuiltWidget(Widget &&widget, int32_t parent, uint32_t childIndex, bool amendBounds,
+                                          vector<int32_t> &lastChildren)
+    {
+        const auto bounds = widget.GetBounds();
+        auto newBounds = Rect(0, 0, 0, 0);
+        if (!amendBounds || parent < 0) {
+            newBounds = bounds;
+        } else {
+            // amend bounds, intersect with parent, compute visibility
+            auto parentBounds = widgets_[parent].GetBounds();
+            if (!bounds.ComputeIntersection(parentBounds, newBounds)) {
+                newBounds = Rect(0, 0, 0, 0);
+            }
+        }
+        if (!newBounds.CompareTo(bounds)) {
+            widget.SetBounds(newBounds.left_, newBounds.right_, newBounds.top_, newBounds.bottom_);
+            LOG_D("Amend bounds %{public}s from %{public}s", widget.ToStr().c_str(), Rect2JsonStr(bounds).c_str());
+        }
+        if (amendBounds && (newBounds.GetWidth() <= 0 || newBounds.GetHeight() <= 0)) {
+            LOG_D("Discard invisible node '%{public}s'and its descendants", widget.ToStr().c_str());
+            return -1;
+        }
+        return AppendWidget(move(widget), parent, childIndex, lastChildren);
+    }
+
+    /**Builder that appends the received nodes into the tree, the attributes are applied to the pending widget until
+     * its first child or its end arrives.*/
+    class WidgetTree::NodeSink final : public WidgetTreeBuilder {
+    public:
+        NodeSink(WidgetTree &tree, bool amendBounds) : tree_(tree), amendBounds_(amendBounds) {}
+
+        ~NodeSink() override {}
+
+        void BeginNode() override
+        {
+            CommitPending();
+            const auto childIndex = nextChildIndex_;
+            nextChildIndex_.reset();
+            if (skipDepth_ > 0) {
+                skipDepth_++;
+                return;
+            }
+            DCHECK(!tree_.widgetsConstructed_ && (!frames_.empty() || tree_.widgets_.IsEmpty()));
+            pendingParent_ = -1;
+            pendingChildIndex_ = 0;
+            if (!frames_.empty()) {
+                auto &parent = frames_.back();
+                pendingParent_ = parent.self_;
+                pendingChildIndex_ = childIndex.value_or(parent.childCount_);
+                parent.childCount_ = pendingChildIndex_ + 1;
+            }
+            pending_.emplace(tree_.CreateWidget());
+        }
+
+        /**Begin node with the given widget whose attributes are all set.*/
+        void BeginNode(Widget &&widget)
+        {
+            BeginNode();
+            if (pending_.has_value()) {
+                pending_.reset();
+                pending_.emplace(move(widget));
+            }
+        }
+
+        /**Specify the child index of the next node, the following siblings are indexed after it.*/
+        void SetNextChildIndex(uint32_t childIndex)
+        {
+            nextChildIndex_ = childIndex;
+        }
+
+        void Attr(string_view name, string_view value) override
+        {
+            if (!pending_.has_value()) {
+                return; // skipped node, or attribute arrives after the children
+            }
+            if (name == ATTR_NAMES[UiAttr::BOUNDS]) {
+                SetWidgetBounds(*pending_, value);
+            } else {
+                pending_->SetAttr(name, value);
+            }
+        }
+
+        void Bounds(const Rect &bounds) override
+        {
+            if (pending_.has_value()) {
+                pending_->SetBounds(bounds.left_, bounds.right_, bounds.top_, bounds.bottom_);
+            }
+        }
+
+        void EndNode() override
+        {
+            CommitPending();
+            if (skipDepth_ > 0) {
+                skipDepth_--;
+            } else if (!frames_.empty()) {
+                frames_.pop_back();
+            }
+        }
+
+    private:
+        /**Open node whose children are being received.*/
+        struct Frame {
+            int32_t self_;
+            uint32_t childCount_;
+        };
+
+        void CommitPending()
+        {
+            if (!pending_.has_value()) {
+                return;
+            }
+            const auto self = tree_.AppendBuiltWidget(move(*pending_), pendingParent_, pendingChildIndex_,
+                                                      amendBounds_, lastChildren_);
+            pending_.reset();
+            if (self < 0) {
+                skipDepth_ = 1; // discarded node, skip its descendants till it ends
+            } else {
+                frames_.push_back({self, 0});
+            }
+        }
+
+        WidgetTree &tree_;
+        const bool amendBounds_;
+        vector<Frame> frames_;
+        vector<int32_t> lastChildren_;
+        optional<Widget> pending_;
+        int32_t pendingParent_ = -1;
+        uint32_t pendingChildIndex_ = 0;
+        optional<uint32_t> nextChildIndex_;
+        // depth of the discarded subtree being received, 0 for none
+        uint32_t skipDepth_ = 0;
+    };
+
+    void WidgetTreeBuilder::AcceptDom(const json &dom)
+    {
+        // walk the dom by reference in dfs order with an explicit stack, each frame holds the children of an
+        // entered node and the cursor of the next child to visit
+        struct VisitFrame {
+            const json *children_;
+            size_t next_;
+        };
+        vector<VisitFrame> stack;
+        string valueText;
+        const auto enterNode = [this, &stack, &valueText](const json &node) {
+            BeginNode();
+            if (auto attributes = node.find("attributes"); attributes != node.end()) {
+                for (auto iter = attributes->cbegin(); iter != attributes->cend(); iter++) {
+                    const auto &value = iter.value();
+                    // read string values by reference, other value types are kept as their json text
+                    if (value.is_string()) {
+                        Attr(iter.key(), value.get_ref<const string &>());
+                    } else {
+                        valueText = value.dump();
+                        Attr(iter.key(), valueText);
+                    }
+                }
+            }
+            static const auto noChildren = json::array();
+            auto children = node.find("children");
+            stack.push_back({children == node.end() ? &noChildren : &(*children), 0});
+        };
+        enterNode(dom);
+        while (!stack.empty()) {
+            auto &frame = stack.back();
+            if (frame.next_ >= frame.children_->size()) {
+                stack.pop_back();
+                EndNode();
+                continue;
+            }
+            // 'frame' might be invalidated by pushing, read everything needed ahead
+            enterNode(frame.children_->at(frame.next_++));
+        }
+    }
+
+    /**Sax handler which pushes the layout nodes into the builder, objects and arrays out of the layout structure are
+     * ignored, so are the non-scalar attribute values.*/
+    class LayoutSaxHandler final : public json_sax<json> {
+    public:
+        explicit LayoutSaxHandler(WidgetTreeBuilder &builder) : builder_(builder) {}
+
+        ~LayoutSaxHandler() override {}
+
+        bool null() override
+        {
+            return Scalar("null");
+        }
+
+        bool boolean(bool val) override
+        {
+            return Scalar(val ? TRUE_STR : FALSE_STR);
+        }
+
+        bool number_integer(number_integer_t val) override
+        {
+            return Scalar(to_string(val));
+        }
+
+        bool number_unsigned(number_unsigned_t val) override
+        {
+            return Scalar(to_string(val));
+        }
+
+        bool number_float(number_float_t val, const string_t &text) override
+        {
+            return Scalar(text);
+        }
+
+        bool string(string_t &val) override
+        {
+            return Scalar(val);
+        }
+
+        bool binary(binary_t &val) override
+        {
+            return true;
+        }
+
+        bool start_object(size_t elements) override
+        {
+            auto scope = OTHER;
+            if (scopes_.empty() || scopes_.back() == CHILDREN) {
+                scope = NODE;
+                builder_.BeginNode();
+            } else if (scopes_.back() == NODE && key_ == "attributes") {
+                scope = ATTRIBUTES;
+            }
+            scopes_.push_back(scope);
+            return true;
+        }
+
+        bool key(string_t &val) override
+        {
+            key_ = val;
+            return true;
+        }
+
+        bool end_object() override
+        {
+            if (scopes_.back() == NODE) {
+                builder_.EndNode();
+            }
+            scopes_.pop_back();
+            return true;
+        }
+
+        bool start_array(size_t elements) override
+        {
+            const bool children = !scopes_.empty() && scopes_.back() == NODE && key_ == "children";
+            scopes_.push_back(children ? CHILDREN : OTHER);
+            return true;
+        }
+
+        bool end_array() override
+        {
+            scopes_.pop_back();
+            return true;
+        }
+
+        bool parse_error(size_t position, const std::string &lastToken, const detail::exception &ex) override
+        {
+            LOG_E("Illegal layout json at %{public}zu: %{public}s", position, ex.what());
+            return false;
+        }
+
+    private:
+        enum Scope : uint8_t { NODE, ATTRIBUTES, CHILDREN, OTHER };
+
+        bool Scalar(string_view value)
+        {
+            if (!scopes_.empty() && scopes_.back() == ATTRIBUTES) {
+                builder_.Attr(key_, value);
+            }
+            return true;
+        }
+
+        WidgetTreeBuilder &builder_;
+        std::string key_;
+        vector<Scope> scopes_;
+    };
+
+    bool WidgetTreeBuilder::AcceptLayout(string_view layout)
+    {
+        LayoutSaxHandler handler(*this);
+        return json::sax_parse(layout.begin(), layout.end(), &handler);
+    }
+
+    void WidgetTree::ConstructFromDom(const nlohmann::json &dom, bool amendBounds)
+    {
+        DCHECK(!widgetsConstructed_);
+        NodeSink sink(*this, amendBounds);
+        sink.AcceptDom(dom);
+        FinishConstruction();
+    }
+
+    bool WidgetTree::ConstructFromLayout(string_view layout, bool amendBounds)
+    {
+        DCHECK(!widgetsConstructed_);
+        NodeSink sink(*this, amendBounds);
+        const auto success = sink.AcceptLayout(layout);
+        FinishConstruction();
+        return success;
+    }
+
+    void WidgetTree::ConstructFromSource(const function<void(WidgetTreeBuilder &)> &source, bool amendBounds)
+    {
+        DCHECK(!widgetsConstructed_ && source != nullptr);
+        NodeSink sink(*this, amendBounds);
+        source(sink);
+        FinishConstruction();
+    }
+
+    bool WidgetTree::ConstructFromBase(const WidgetTree &base, const vector<const Widget *> &dirtyRoots,
+                                       const function<bool(const Widget &, WidgetTreeBuilder &)> &source,
+                                       bool amendBounds)
+    {
+        DCHECK(!widgetsConstructed_ && widgets_.IsEmpty() && base.widgetsConstructed_ && source != nullptr);
+        stringPool_ = base.stringPool_;
+        backingData_ = base.backingData_;
+        topology_->treeId_ = base.topology_->treeId_;
+        vector<uint32_t> roots;
+        for (auto widget : dirtyRoots) {
+            DCHECK(widget != nullptr && base.CheckIsMyNode(*widget));
+            roots.emplace_back(widget->hostIndex_);
+        }
+        sort(roots.begin(), roots.end());
+        // fetch the outermost dirty subtrees ahead, each under a copy of its parent which clips the bounds, so the
+        // node counts are known before placing them
+        vector<uint32_t> outerRoots;
+        vector<unique_ptr<WidgetTree>> subtrees;
+        bool sameSizes = true;
+        for (auto root : roots) {
+            if (!outerRoots.empty() && root < base.nodes_[outerRoots.back()].subtreeEnd_) {
+                continue;
+            }
+            auto subtree = make_unique<WidgetTree>(name_);
+            subtree->stringPool_ = stringPool_;
+            subtree->backingData_ = backingData_;
+            NodeSink sink(*subtree, amendBounds);
+            const auto &node = base.nodes_[root];
+            if (node.parent_ >= 0) {
+                sink.BeginNode(subtree->CloneWidget(base.widgets_[node.parent_]));
+            }
+            sink.SetNextChildIndex(node.childIndex_);
+            const auto success = source(base.widgets_[root], sink);
+            if (node.parent_ >= 0) {
+                sink.EndNode();
+            }
+            if (!success) {
+                FinishConstruction();
+                return false;
+            }
+            subtree->FinishConstruction();
+            const auto offset = node.parent_ >= 0 ? 1 : 0;
+            sameSizes = sameSizes && subtree->widgets_.GetSize() - offset == node.subtreeEnd_ - root;
+            outerRoots.emplace_back(root);
+            subtrees.emplace_back(move(subtree));
+        }
+        if (sameSizes) {
+            ShareFromBase(base, outerRoots, subtrees);
+            return true;
+        }
+        // the node indexes are shifted, copy all the nodes in dfs order with the fetched subtrees in place
+        NodeSink sink(*this, amendBounds);
+        // subtree ends of the copied nodes which are not ended yet
+        vector<uint32_t> openEnds;
+        size_t next = 0;
+        uint32_t index = 0;
+        while (index < base.widgets_.GetSize()) {
+            for (; !openEnds.empty() && openEnds.back() <= index; openEnds.pop_back()) {
+                sink.EndNode();
+            }
+            const auto &node = base.nodes_[index];
+            if (next >= outerRoots.size() || outerRoots[next] != index) {
+                sink.SetNextChildIndex(node.childIndex_);
+                sink.BeginNode(CloneWidget(base.widgets_[index]));
+                openEnds.push_back(node.subtreeEnd_);
+                index++;
+                continue;
+            }
+            // replay the fetched subtree, whose root is indexed as in the base tree
+            const auto &subtree = *subtrees[next++];
+            vector<uint32_t> subtreeEnds;
+            for (uint32_t from = node.parent_ >= 0 ? 1 : 0; from < subtree.widgets_.GetSize(); from++) {
+                for (; !subtreeEnds.empty() && subtreeEnds.back() <= from; subtreeEnds.pop_back()) {
+                    sink.EndNode();
+                }
+                sink.SetNextChildIndex(subtree.nodes_[from].childIndex_);
+                sink.BeginNode(CloneWidget(subtree.widgets_[from]));
+                subtreeEnds.push_back(subtree.nodes_[from].subtreeEnd_);
+            }
+            for (; !subtreeEnds.empty(); subtreeEnds.pop_back()) {
+                sink.EndNode();
+            }
+            index = node.subtreeEnd_;
+        }
+        for (; !openEnds.empty(); openEnds.pop_back()) {
+            sink.EndNode();
+        }
+        FinishConstruction();
+        return true;
+    }
+
+    void WidgetTree::ShareFromBase(const WidgetTree &base, const vector<uint32_t> &roots,
+                                   const vector<unique_ptr<WidgetTree>> &subtrees)
+    {
+        widgets_.ShareChunks(base.widgets_);
+        nodes_.ShareChunks(base.nodes_);
+        vector<uint32_t> ancestors;
+        vector<size_t> dirtyChunks;
+        for (size_t position = 0; position < roots.size(); position++) {
+            const auto root = roots[position];
+            const auto &rootNode = base.nodes_[root];
+            const auto &subtree = *subtrees[position];
+            const uint32_t offset = rootNode.parent_ >= 0 ? 1 : 0;
+            // move the fetched nodes from the subtree indexes to the tree indexes
+            const auto shift = static_cast<int32_t>(root - offset);
+            auto relink = [shift](int32_t link) { return link < 0 ? link : link + shift; };
+            for (uint32_t from = offset; from < subtree.nodes_.GetSize(); from++) {
+                auto node = subtree.nodes_[from];
+                node.parent_ = from == offset ? rootNode.parent_ : relink(node.parent_);
+                node.firstChild_ = relink(node.firstChild_);
+                node.nextSibling_ = from == offset ? rootNode.nextSibling_ : relink(node.nextSibling_);
+                node.subtreeEnd_ += shift;
+                nodes_.GetMutable(from + shift) = node;
+            }
+            for (auto cursor = rootNode.parent_; cursor >= 0; cursor = base.nodes_[cursor].parent_) {
+                ancestors.emplace_back(cursor);
+            }
+            for (auto chunk = root >> ChunkedArray<Widget>::CHUNK_BITS;
+                 chunk <= (rootNode.subtreeEnd_ - 1) >> ChunkedArray<Widget>::CHUNK_BITS; chunk++) {
+                if (dirtyChunks.empty() || dirtyChunks.back() != chunk) {
+                    dirtyChunks.emplace_back(chunk);
+                }
+            }
+        }
+        // the widgets are shared by chunks, rebuild the chunks holding any fetched widget
+        size_t position = 0;
+        for (auto chunk : dirtyChunks) {
+            const auto begin = static_cast<uint32_t>(chunk << ChunkedArray<Widget>::CHUNK_BITS);
+            const auto end = min(begin + ChunkedArray<Widget>::CHUNK_SIZE, static_cast<uint32_t>(widgets_.GetSize()));
+            vector<Widget> items;
+            items.reserve(ChunkedArray<Widget>::CHUNK_SIZE);
+            for (auto index = begin; index < end; index++) {
+                while (position < roots.size() && base.nodes_[roots[position]].subtreeEnd_ <= index) {
+                    position++;
+                }
+                const auto fetched = position < roots.size() && roots[position] <= index;
+                if (fetched) {
+                    const auto &subtree = *subtrees[position];
+                    const auto offset = base.nodes_[roots[position]].parent_ >= 0 ? 1 : 0;
+                    items.emplace_back(CloneWidget(subtree.widgets_[index - roots[position] + offset]));
+                } else {
+                    items.emplace_back(CloneWidget(base.widgets_[index]));
+                }
+                items.back().hostTopology_ = topology_.get();
+                items.back().hostIndex_ = index;
+            }
+            widgets_.ReplaceChunk(chunk, move(items));
+        }
+        // children are placed behind their parent, update the ancestor hashes from the deepest one
+        sort(ancestors.begin(), ancestors.end(), greater<uint32_t>());
+        ancestors.erase(unique(ancestors.begin(), ancestors.end()), ancestors.end());
+        for (auto ancestor : ancestors) {
+            nodes_.GetMutable(ancestor).subtreeHash_ = ComputeSubtreeHash(ancestor);
+        }
+        MarkConstructed();
+    }
+
+    Widget WidgetTree::CloneWidget(const Widget &from)
+    {
+        Widget widget(*stringPool_);
+        widget.presentBits_ = from.presentBits_;
+        widget.boolBits_ = from.boolBits_;
+        widget.id_ = from.id_;
+        widget.bounds_ = from.bounds_;
+        if (from.pool_ == stringPool_.get()) {
+            // the strings are already in the shared pool
+            copy(begin(from.strings_), end(from.strings_), begin(widget.strings_));
+            widget.customAttrs_ = from.customAttrs_;
+            return widget;
+        }
+        for (size_t index = 0; index < sizeof(from.strings_) / sizeof(from.strings_[0]); index++) {
+            widget.strings_[index] = stringPool_->Intern(from.strings_[index]);
+        }
+        for (auto &[name, value] : from.customAttrs_) {
+            widget.customAttrs_.emplace_back(stringPool_->Intern(name), stringPool_->Intern(value));
+        }
+        return widget;
+    }
+
+    uint64_t WidgetTree::ComputeSubtreeHash(uint32_t index) const
+    {
+        auto hash = HashWidgetContent(widgets_[index]);
+        uint64_t childCount = 0;
+        for (auto child = nodes_[index].firstChild_; child >= 0; child = nodes_[child].nextSibling_) {
+            hash = MixHash(hash, nodes_[child].subtreeHash_);
+            childCount++;
+        }
+        return MixHash(hash, childCount);
+    }
+
+    void WidgetTree::FinishConstruction()
+    {
+        // fill subtree ranges and hashes bottom-up, children are always placed behind their parent
+        for (auto index = static_cast<int32_t>(nodes_.GetSize()) - 1; index >= 0; index--) {
+            auto &node = nodes_.GetMutable(index);
+            node.subtreeHash_ = ComputeSubtreeHash(index);
+            if (index > 0) {
+                auto &parentNode = nodes_.GetMutable(node.parent_);
+                parentNode.subtreeEnd_ = max(parentNode.subtreeEnd_, node.subtreeEnd_);
+            }
+        }
+        MarkConstructed();
+    }
+
+    void WidgetTree::MarkConstructed()
+    {
+        spatialIndex_.reset();
+        attrIndexes_.clear();
+        foldedIndexes_.clear();
+        matchBits_.clear();
+        static atomic<uint64_t> generationCounter(0);
+        generation_ = ++generationCounter;
+        widgetsConstructed_ = true;
+    }
+
+    void WidgetTree::MarshalWidget(uint32_t index, nlohmann::json &dom) const
+    {
+        auto attributesData = json();
+        auto dict = map<string, string>();
+        widgets_[index].DumpAttributes(dict);
+        for (auto& [name, value] : dict) {
+            if (name == ATTR_HIERARCHY) { // do not expose inner used attributes
+                continue;
+            }
+            attributesData[name] = value;
+        }
+        stringstream stream;
+        auto rect = widgets_[index].GetBounds();
+        stream << "[" << rect.left_ << "," << rect.top_ << "]" << "[" << rect.right_ << "," << rect.bottom_ << "]";
+        attributesData[ATTR_NAMES[UiAttr::BOUNDS]] = stream.str();
+
+        auto childrenData = json::array();
+        for (auto child = nodes_[index].firstChild_; child >= 0; child = nodes_[child].nextSibling_) {
+            auto childData = json();
+            MarshalWidget(child, childData);
+            childrenData.emplace_back(childData);
+        }
+
+        dom["attributes"] = attributesData;
+        dom["children"] = childrenData;
+    }
+
+    void WidgetTree::MarshalIntoDom(nlohmann::json& dom) const
+    {
+        DCHECK(widgetsConstructed_);
+        if (!widgets_.IsEmpty()) {
+            MarshalWidget(0, dom);
+        }
+    }
+
+    /**
+     * Layout of the binary format: header, string offsets (u32[stringCount + 1]), string chars padded to 4 bytes,
+     * bounds (i32[nodeCount] of left, right, top and bottom), nodes (dfs order) and custom attributes (u32 pairs of
+     * name/value string indexes, in node order). Values are in the byte order of the writer, which is marked in the
+     * header, the data of the other byte order is rejected. The string at index 0 is empty.
+     * */
+    struct BinaryLayoutHeader {
+        char magic_[4];
+        // BINARY_BYTE_ORDER_MARK written in the byte order of the values
+        uint32_t byteOrder_;
+        uint32_t version_;
+        uint32_t nodeCount_;
+        uint32_t stringCount_;
+        uint32_t attrCount_;
+        uint32_t charBytes_;
+    };
+
+    static constexpr size_t STRING_SLOT_COUNT = UiAttr::TYPE - UiAttr::TEXT + 1;
+
+    struct BinaryLayoutNode {
+        int32_t parent_;
+        uint32_t childIndex_;
+        uint16_t presentBits_;
+        uint16_t boolBits_;
+        int32_t id_;
+        uint32_t strings_[STRING_SLOT_COUNT];
+        uint32_t attrCount_;
+    };
+
+    static_assert(sizeof(BinaryLayoutHeader) == 28 && sizeof(BinaryLayoutNode) == 32, "Unexpected padding");
+    static constexpr char BINARY_LAYOUT_MAGIC[] = {'U', 'I', 'T', 'B'};
+    static constexpr uint32_t BINARY_LAYOUT_VERSION = 2;
+    static constexpr uint32_t BINARY_BYTE_ORDER_MARK = 0x01020304;
+    static constexpr size_t BINARY_BOUNDS_ARRAYS = 4;
+
+    /**Offsets of the binary layout sections.*/
+    struct BinaryLayoutSections {
+        BinaryLayoutHeader header_;
+        size_t offsets_;
+        size_t chars_;
+        size_t bounds_;
+        size_t nodes_;
+        size_t attrs_;
+        size_t end_;
+    };
+
+    static inline size_t AlignTo4(size_t size)
+    {
+        static constexpr size_t mask = 3;
+        return (size + mask) & ~mask;
+    }
+
+    /**Read the value at the given offset, the data might be unaligned.*/
+    template<typename T>
+    static inline T ReadBinary(string_view data, size_t offset)
+    {
+        T value;
+        memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    static inline void AppendBinary(string &out, const T *items, size_t count)
+    {
+        out.append(reinterpret_cast<const char *>(items), sizeof(T) * count);
+    }
+
+    static bool LocateBinarySections(string_view data, BinaryLayoutSections &sections)
+    {
+        if (data.size() < sizeof(BinaryLayoutHeader)) {
+            return false;
+        }
+        auto &header = sections.header_;
+        header = ReadBinary<BinaryLayoutHeader>(data, 0);
+        if (memcmp(header.magic_, BINARY_LAYOUT_MAGIC, sizeof(BINARY_LAYOUT_MAGIC)) != 0) {
+            return false;
+        }
+        if (header.byteOrder_ != BINARY_BYTE_ORDER_MARK) {
+            LOG_E("Binary layout of another byte order is not supported");
+            return false;
+        }
+        if (header.version_ != BINARY_LAYOUT_VERSION || header.stringCount_ == 0) {
+            return false;
+        }
+        // compute in 64 bits, the counts are 32 bits so no overflow happens
+        const uint64_t nodeCount = header.nodeCount_;
+        sections.offsets_ = sizeof(BinaryLayoutHeader);
+        sections.chars_ = sections.offsets_ + sizeof(uint32_t) * (uint64_t(header.stringCount_) + 1);
+        sections.bounds_ = AlignTo4(sections.chars_ + uint64_t(header.charBytes_));
+        sections.nodes_ = sections.bounds_ + sizeof(int32_t) * BINARY_BOUNDS_ARRAYS * nodeCount;
+        sections.attrs_ = sections.nodes_ + sizeof(BinaryLayoutNode) * nodeCount;
+        sections.end_ = sections.attrs_ + sizeof(uint32_t) * INDEX_TWO * uint64_t(header.attrCount_);
+        return sections.end_ == data.size();
+    }
+
+    void WidgetTree::MarshalIntoBinary(string &out) const
+    {
+        DCHECK(widgetsConstructed_);
+        vector<string_view> strings = {""};
+        unordered_map<string_view, uint32_t> stringIndexes = {{"", 0}};
+        auto indexOf = [&strings, &stringIndexes](string_view str) {
+            auto [entry, inserted] = stringIndexes.emplace(str, strings.size());
+            if (inserted) {
+                strings.emplace_back(str);
+            }
+            return entry->second;
+        };
+        const auto nodeCount = widgets_.GetSize();
+        vector<BinaryLayoutNode> nodes(nodeCount);
+        vector<int32_t> bounds(nodeCount * BINARY_BOUNDS_ARRAYS);
+        vector<uint32_t> attrs;
+        for (size_t index = 0; index < nodeCount; index++) {
+            const auto &widget = widgets_[index];
+            auto &node = nodes[index];
+            node.parent_ = nodes_[index].parent_;
+            node.childIndex_ = nodes_[index].childIndex_;
+            node.presentBits_ = widget.presentBits_;
+            node.boolBits_ = widget.boolBits_;
+            node.id_ = widget.id_;
+            for (size_t slot = 0; slot < STRING_SLOT_COUNT; slot++) {
+                node.strings_[slot] = indexOf(widget.strings_[slot]);
+            }
+            node.attrCount_ = widget.customAttrs_.size();
+            for (auto &[name, value] : widget.customAttrs_) {
+                attrs.emplace_back(indexOf(name));
+                attrs.emplace_back(indexOf(value));
+            }
+            bounds[index] = widget.bounds_.left_;
+            bounds[index + nodeCount] = widget.bounds_.right_;
+            bounds[index + nodeCount * INDEX_TWO] = widget.bounds_.top_;
+            bounds[index + nodeCount * INDEX_THREE] = widget.bounds_.bottom_;
+        }
+        vector<uint32_t> offsets = {0};
+        for (auto str : strings) {
+            offsets.emplace_back(offsets.back() + str.length());
+        }
+        BinaryLayoutHeader header;
+        memcpy(header.magic_, BINARY_LAYOUT_MAGIC, sizeof(BINARY_LAYOUT_MAGIC));
+        header.byteOrder_ = BINARY_BYTE_ORDER_MARK;
+        header.version_ = BINARY_LAYOUT_VERSION;
+        header.nodeCount_ = nodeCount;
+        header.stringCount_ = strings.size();
+        header.attrCount_ = attrs.size() / INDEX_TWO;
+        header.charBytes_ = offsets.back();
+        out.clear();
+        AppendBinary(out, &header, 1);
+        AppendBinary(out, offsets.data(), offsets.size());
+        for (auto str : strings) {
+            out.append(str);
+        }
+        out.resize(AlignTo4(out.size()), '\0');
+        AppendBinary(out, bounds.data(), bounds.size());
+        AppendBinary(out, nodes.data(), nodes.size());
+        AppendBinary(out, attrs.data(), attrs.size());
+    }
+
+    bool WidgetTree::ConstructFromBinary(string_view data)
+    {
+        return ConstructFromBinaryData(data, false);
+    }
+
+    bool WidgetTree::LoadFromBinaryFile(string_view path)
+    {
+        const auto fd = open(string(path).c_str(), O_RDONLY);
+        if (fd < 0) {
+            LOG_E("Failed to open binary layout file: %{public}s", string(path).c_str());
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        const auto size = static_cast<size_t>(fileStat.st_size);
+        auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            LOG_E("Failed to map binary layout file: %{public}s", string(path).c_str());
+            return false;
+        }
+        auto mapping = shared_ptr<const void>(address, [size](const void *ptr) {
+            munmap(const_cast<void *>(ptr), size);
+        });
+        // the mapping is kept only if the tree refers to it, it's released here on failure
+        if (!ConstructFromBinaryData(string_view(static_cast<const char *>(address), size), true)) {
+            return false;
+        }
+        backingData_ = move(mapping);
+        return true;
+    }
+
+    bool WidgetTree::ConstructFromBinaryData(string_view data, bool inPlace)
+    {
+        DCHECK(!widgetsConstructed_ && widgets_.IsEmpty());
+        BinaryLayoutSections sections;
+        if (!LocateBinarySections(data, sections)) {
+            LOG_E("Invalid binary layout data");
+            return false;
+        }
+        const auto &header = sections.header_;
+        // validate all the references ahead of constructing, so that nothing is left on failure
+        vector<string_view> strings(header.stringCount_);
+        for (uint32_t index = 0; index < header.stringCount_; index++) {
+            const auto begin = ReadBinary<uint32_t>(data, sections.offsets_ + index * sizeof(uint32_t));
+            const auto end = ReadBinary<uint32_t>(data, sections.offsets_ + (index + 1) * sizeof(uint32_t));
+            if (begin > end || end > header.charBytes_) {
+                return false;
+            }
+            strings[index] = data.substr(sections.chars_ + begin, end - begin);
+        }
+        const auto nodeCount = header.nodeCount_;
+        vector<int32_t> path;
+        // the child index of the last visited child of each node on the path, -1 if none
+        vector<int64_t> lastChildIndexes;
+        uint64_t attrTotal = 0;
+        for (uint32_t index = 0; index < nodeCount; index++) {
+            const auto node = ReadBinary<BinaryLayoutNode>(data, sections.nodes_ + index * sizeof(BinaryLayoutNode));
+            // the parent must be on the path to the previous node, so that the nodes are in dfs order
+            while (!path.empty() && path.back() != node.parent_) {
+                path.pop_back();
+                lastChildIndexes.pop_back();
+            }
+            if ((index == 0) != (node.parent_ < 0) || (index > 0 && path.empty())) {
+                return false;
+            }
+            // the child indexes ascend strictly under each parent, so that the hierarchies are unique
+            if (index > 0) {
+                if (int64_t(node.childIndex_) <= lastChildIndexes.back()) {
+                    return false;
+                }
+                lastChildIndexes.back() = node.childIndex_;
+            }
+            path.emplace_back(index);
+            lastChildIndexes.emplace_back(-1);
+            for (auto stringIndex : node.strings_) {
+                if (stringIndex >= header.stringCount_) {
+                    return false;
+                }
+            }
+            attrTotal += node.attrCount_;
+        }
+        if (attrTotal != header.attrCount_) {
+            return false;
+        }
+        for (uint64_t index = 0; index < uint64_t(header.attrCount_) * INDEX_TWO; index++) {
+            if (ReadBinary<uint32_t>(data, sections.attrs_ + index * sizeof(uint32_t)) >= header.stringCount_) {
+                return false;
+            }
+        }
+        if (!inPlace) {
+            for (auto &str : strings) {
+                str = stringPool_->Intern(str);
+            }
+        }
+        vector<int32_t> lastChildren;
+        size_t attrOffset = sections.attrs_;
+        for (uint32_t index = 0; index < nodeCount; index++) {
+            const auto node = ReadBinary<BinaryLayoutNode>(data, sections.nodes_ + index * sizeof(BinaryLayoutNode));
+            auto widget = CreateWidget();
+            widget.presentBits_ = node.presentBits_;
+            widget.boolBits_ = node.boolBits_;
+            widget.id_ = node.id_;
+            for (size_t slot = 0; slot < STRING_SLOT_COUNT; slot++) {
+                widget.strings_[slot] = strings[node.strings_[slot]];
+            }
+            widget.customAttrs_.reserve(node.attrCount_);
+            for (uint32_t attr = 0; attr < node.attrCount_; attr++) {
+                const auto name = ReadBinary<uint32_t>(data, attrOffset);
+                const auto value = ReadBinary<uint32_t>(data, attrOffset + sizeof(uint32_t));
+                widget.customAttrs_.emplace_back(strings[name], strings[value]);
+                attrOffset += sizeof(uint32_t) * INDEX_TWO;
+            }
+            int32_t edges[BINARY_BOUNDS_ARRAYS];
+            for (size_t edge = 0; edge < BINARY_BOUNDS_ARRAYS; edge++) {
+                const auto offset = sections.bounds_ + (edge * nodeCount + index) * sizeof(int32_t);
+                edges[edge] = ReadBinary<int32_t>(data, offset);
+            }
+            // keep the normalized rectangle for malformed data
+            widget.bounds_ = Rect(edges[INDEX_ZERO], max(edges[INDEX_ZERO], edges[INDEX_ONE]),
+                                  edges[INDEX_TWO], max(edges[INDEX_TWO], edges[INDEX_THREE]));
+            AppendWidget(move(widget), node.parent_, node.childIndex_, lastChildren);
+        }
+        FinishConstruction();
+        return true;
+    }
+
+    const Widget *WidgetTree::GetRootWidget() const
+    {
+        return widgets_.IsEmpty() ? nullptr : &(widgets_[0]);
+    }
+
+    const Widget *WidgetTree::GetParentWidget(const Widget &widget) const
+    {
+        DCHECK(CheckIsMyNode(widget));
+        const auto parent = nodes_[widget.hostIndex_].parent_;
+        return parent < 0 ? nullptr : &(widgets_[parent]);
+    }
+
+    const Widget *WidgetTree::GetChildWidget(const Widget &widget, uint32_t index) const
+    {
+        DCHECK(CheckIsMyNode(widget));
+        for (auto child = nodes_[widget.hostIndex_].firstChild_; child >= 0; child = nodes_[child].nextSibling_) {
+            if (nodes_[child].childIndex_ == index) {
+                return &(widgets_[child]);
+            }
+        }
+        return nullptr;
+    }
+
+    const Widget *WidgetTree::GetWidgetByHierarchy(string_view hierarchy) const
+    {
+        static constexpr size_t rootLen = string_view(ROOT_HIERARCHY).length();
+        if (widgets_.IsEmpty() || hierarchy.substr(0, rootLen) != ROOT_HIERARCHY) {
+            return nullptr;
+        }
+        const Widget *widget = &(widgets_[0]);
+        size_t cursor = rootLen;
+        static constexpr uint32_t FACTOR = 10;
+        while (cursor < hierarchy.length() && widget != nullptr) {
+            if (hierarchy[cursor] != HIERARCHY_SEPARATOR || cursor + 1 >= hierarchy.length()) {
+                return nullptr; // invalid hierarchy string
+            }
+            cursor++;
+            uint32_t childIndex = 0;
+            for (; cursor < hierarchy.length() && hierarchy[cursor] != HIERARCHY_SEPARATOR; cursor++) {
+                const char ch = hierarchy[cursor];
+                if (ch < '0' || ch > '9') {
+                    return nullptr;
+                }
+                childIndex = childIndex * FACTOR + static_cast<uint32_t>(ch - '0');
+            }
+            widget = GetChildWidget(*widget, childIndex);
+        }
+        return widget;
+    }
+
+    const Widget *WidgetTree::GetWidgetById(int32_t id) const
+    {
+        // resolved by the value index of the id attribute, which is built once and shared by the lookups
+        const auto &widgets = GetWidgetsByAttrValue(ATTR_NAMES[UiAttr::ID], to_string(id));
+        return widgets.empty() ? nullptr : &widgets_[widgets.front()];
+    }
+
+    const SpatialIndex &WidgetTree::GetSpatialIndex() const
+    {
+        if (spatialIndex_ == nullptr) {
+            vector<Rect> rects;
+            rects.reserve(widgets_.GetSize());
+            for (size_t index = 0; index < widgets_.GetSize(); index++) {
+                rects.emplace_back(widgets_[index].bounds_);
+            }
+            spatialIndex_ = make_unique<SpatialIndex>(rects);
+        }
+        return *spatialIndex_;
+    }
+
+    WidgetTree::AttrValueIndex &WidgetTree::GetAttrValueIndex(string_view attrName) const
+    {
+        DCHECK(attrName != ATTR_HIERARCHY);
+        auto &index = attrIndexes_[string(attrName)];
+        if (index != nullptr) {
+            return *index;
+        }
+        index = make_unique<AttrValueIndex>();
+        UiAttr attr = UiAttr::ID;
+        const bool builtin = ResolveBuiltinAttr(attrName, attr);
+        for (uint32_t widgetIndex = 0; widgetIndex < widgets_.GetSize(); widgetIndex++) {
+            const auto &widget = widgets_[widgetIndex];
+            string_view attrValue;
+            if (builtin && widget.HasTypedAttr(attr)) {
+                if (ATTR_TYPES[attr] == STRING) {
+                    attrValue = widget.strings_[attr - UiAttr::TEXT];
+                } else if (ATTR_TYPES[attr] == BOOL) {
+                    attrValue = widget.GetBoolAttr(attr) ? TRUE_STR : FALSE_STR;
+                } else {
+                    attrValue = index->renderedValues_.emplace_back(widget.RenderAttr(attr));
+                }
+            } else if (!widget.GetCustomAttr(attrName, attrValue)) {
+                continue;
+            }
+            index->postings_[attrValue].emplace_back(widgetIndex);
+        }
+        return *index;
+    }
+
+    WidgetTree::AttrValueIndex &WidgetTree::GetFoldedValueIndex(string_view attrName, uint8_t flags) const
+    {
+        auto &index = foldedIndexes_[string(1, static_cast<char>('0' + flags)).append(attrName)];
+        if (index != nullptr) {
+            return *index;
+        }
+        const auto &plainIndex = GetAttrValueIndex(attrName);
+        index = make_unique<AttrValueIndex>();
+        string folded;
+        for (auto &[value, widgets] : plainIndex.postings_) {
+            FoldValue(value, flags, folded);
+            auto find = index->postings_.find(folded);
+            if (find == index->postings_.end()) {
+                // the unchanged values are viewed in place, only the changed ones are copied
+                const string_view key = folded == value ? value : index->renderedValues_.emplace_back(folded);
+                index->postings_.emplace(key, widgets);
+                continue;
+            }
+            // several values fold to the same one, merge their ascending widgets
+            auto &merged = find->second;
+            const auto middle = merged.size();
+            merged.insert(merged.end(), widgets.begin(), widgets.end());
+            inplace_merge(merged.begin(), merged.begin() + middle, merged.end());
+        }
+        return *index;
+    }
+
+    const vector<uint32_t> &WidgetTree::GetWidgetsByAttrValue(string_view attrName, string_view value) const
+    {
+        static const vector<uint32_t> noWidgets;
+        const auto &index = GetAttrValueIndex(attrName);
+        auto find = index.postings_.find(value);
+        return find == index.postings_.end() ? noWidgets : find->second;
+    }
+
+    static constexpr size_t GRAM_LENGTH = 3;
+
+    static uint32_t PackGram(const char *gram)
+    {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(gram[0])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(gram[1])) << 8) | static_cast<uint8_t>(gram[2]);
+    }
+
+    void WidgetTree::BuildAffixIndex(AttrValueIndex &index)
+    {
+        for (auto &[value, widgets] : index.postings_) {
+            index.sortedValues_.emplace_back(value);
+        }
+        sort(index.sortedValues_.begin(), index.sortedValues_.end());
+        for (uint32_t position = 0; position < index.sortedValues_.size(); position++) {
+            const auto value = index.sortedValues_[position];
+            index.reversedValues_.emplace_back(string(value.rbegin(), value.rend()), position);
+            for (size_t offset = 0; offset + GRAM_LENGTH <= value.length(); offset++) {
+                auto &values = index.trigrams_[PackGram(value.data() + offset)];
+                // a gram may repeat in one value, positions are visited ascendingly so dedup the tail only
+                if (values.empty() || values.back() != position) {
+                    values.emplace_back(position);
+                }
+            }
+        }
+        sort(index.reversedValues_.begin(), index.reversedValues_.end());
+        index.affixIndexed_ = true;
+    }
+
+    void WidgetTree::CollectValuesContaining(const AttrValueIndex &index, string_view testValue,
+                                             vector<uint32_t> &positions)
+    {
+        const auto &values = index.sortedValues_;
+        if (testValue.length() < GRAM_LENGTH) {
+            for (uint32_t position = 0; position < values.size(); position++) {
+                if (FindSubstring(values[position], testValue) != string_view::npos) {
+                    positions.emplace_back(position);
+                }
+            }
+            return;
+        }
+        vector<const vector<uint32_t> *> gramPostings;
+        for (size_t offset = 0; offset + GRAM_LENGTH <= testValue.length(); offset++) {
+            auto find = index.trigrams_.find(PackGram(testValue.data() + offset));
+            if (find == index.trigrams_.end()) {
+                return;
+            }
+            gramPostings.emplace_back(&find->second);
+        }
+        auto shortest = min_element(gramPostings.begin(), gramPostings.end(),
+            [](auto a, auto b) { return a->size() < b->size(); });
+        for (auto position : **shortest) {
+            // grams are necessary but not sufficient (order and overlapping), verify the candidate value
+            if (FindSubstring(values[position], testValue) != string_view::npos) {
+                positions.emplace_back(position);
+            }
+        }
+    }
+
+    void WidgetTree::GetWidgetsByAttrMatch(string_view attrName, string_view testValue, ValueMatchRule rule,
+                                           vector<uint32_t> &receiver, uint32_t maxDistance, uint8_t flags) const
+    {
+        auto &index = flags == 0 ? GetAttrValueIndex(attrName) : GetFoldedValueIndex(attrName, flags);
+        if (rule == EQ) {
+            auto find = index.postings_.find(testValue);
+            if (find != index.postings_.end()) {
+                receiver.insert(receiver.end(), find->second.begin(), find->second.end());
+            }
+            return;
+        }
+        if (rule == REGEX || rule == FUZZY) {
+            // the automaton or the edit distance runs once per distinct value, an illegal pattern matches nothing
+            const auto regex = rule == REGEX ? RegexAutomaton::Get(testValue) : nullptr;
+            const auto fuzzy = rule == FUZZY ? EditDistancePattern::Get(testValue, maxDistance) : nullptr;
+            const auto offset = receiver.size();
+            for (auto &[value, widgets] : index.postings_) {
+                if (regex != nullptr ? regex->Matches(value) : fuzzy != nullptr && fuzzy->Matches(value)) {
+                    receiver.insert(receiver.end(), widgets.begin(), widgets.end());
+                }
+            }
+            sort(receiver.begin() + offset, receiver.end());
+            return;
+        }
+        if (!index.affixIndexed_) {
+            BuildAffixIndex(index);
+        }
+        vector<uint32_t> positions;
+        if (rule == STARTS_WITH) {
+            const auto &values = index.sortedValues_;
+            const auto lowerBound = lower_bound(values.begin(), values.end(), testValue);
+            size_t position = static_cast<size_t>(lowerBound - values.begin());
+            for (; position < values.size() && values[position].substr(0, testValue.length()) == testValue;
+                 position++) {
+                positions.emplace_back(position);
+            }
+        } else if (rule == ENDS_WITH) {
+            const auto &values = index.reversedValues_;
+            const string reversed(testValue.rbegin(), testValue.rend());
+            auto iter = lower_bound(values.begin(), values.end(), reversed,
+                [](const auto &entry, const string &target) { return entry.first < target; });
+            for (; iter != values.end() && string_view(iter->first).substr(0, reversed.length()) == reversed; iter++) {
+                positions.emplace_back(iter->second);
+            }
+        } else {
+            CollectValuesContaining(index, testValue, positions);
+        }
+        // the widgets of distinct values are disjoint, merging them needs no dedup
+        const auto offset = receiver.size();
+        for (auto position : positions) {
+            const auto &widgets = index.postings_.find(index.sortedValues_[position])->second;
+            receiver.insert(receiver.end(), widgets.begin(), widgets.end());
+        }
+        sort(receiver.begin() + offset, receiver.end());
+    }
+
+    shared_ptr<const DfsBitset> WidgetTree::GetAttrMatchBits(string_view attrName, string_view testValue,
+                                                             ValueMatchRule rule, uint32_t maxDistance,
+                                                             uint8_t flags) const
+    {
+        static constexpr size_t maxCachedSets = 256;
+        // length-prefixed attribute name, then the rule and the flags, the max distance of the FUZZY rule and the
+        // test value
+        string key = to_string(attrName.length());
+        key.append(1, ':').append(attrName).append(1, static_cast<char>('0' + rule));
+        key.append(1, static_cast<char>('0' + flags));
+        if (rule == FUZZY) {
+            key.append(to_string(maxDistance)).append(1, ':');
+        }
+        key.append(testValue);
+        auto find = matchBits_.find(key);
+        if (find != matchBits_.end()) {
+            return find->second;
+        }
+        if (matchBits_.size() >= maxCachedSets) {
+            // keep the memory bounded for long-living snapshots, the sets are cheap to recompute from the indexes
+            matchBits_.clear();
+        }
+        auto bits = make_shared<DfsBitset>(static_cast<uint32_t>(widgets_.GetSize()));
+        vector<uint32_t> indexes;
+        GetWidgetsByAttrMatch(attrName, testValue, rule, indexes, maxDistance, flags);
+        for (auto index : indexes) {
+            bits->Set(index);
+        }
+        matchBits_.emplace(move(key), bits);
+        return bits;
+    }
+
+    const Widget *WidgetTree::GetWidgetAt(const Point &point) const
+    {
+        vector<uint32_t> indexes;
+        GetSpatialIndex().QueryPoint(point, indexes);
+        return indexes.empty() ? nullptr : &widgets_[indexes.back()];
+    }
+
+    const Widget *WidgetTree::GetNearestWidget(const Point &point, const function<bool(const Widget &)> &filter) const
+    {
+        uint32_t index = 0;
+        auto accept = [this, &filter](uint32_t candidate) { return filter(widgets_[candidate]); };
+        return GetSpatialIndex().QueryNearest(point, accept, index) ? &widgets_[index] : nullptr;
+    }
+
+    string WidgetTree::BuildHierarchy(const WidgetTopology &topology, uint32_t index)
+    {
+        string hierarchy;
+        BuildHierarchy(topology, index, hierarchy);
+        return hierarchy;
+    }
+
+    void WidgetTree::BuildHierarchy(const WidgetTopology &topology, uint32_t index, string &buffer)
+    {
+        // append the reversed segments from the node up to the root, then reverse the whole text
+        buffer.clear();
+        const auto &nodes = topology.nodes_;
+        for (auto cursor = static_cast<int32_t>(index); nodes[cursor].parent_ >= 0; cursor = nodes[cursor].parent_) {
+            const auto segmentBegin = buffer.length();
+            AppendInt(static_cast<int32_t>(nodes[cursor].childIndex_), buffer);
+            reverse(buffer.begin() + segmentBegin, buffer.end());
+            buffer.push_back(HIERARCHY_SEPARATOR);
+        }
+        buffer.append(string_view(ROOT_HIERARCHY).rbegin(), string_view(ROOT_HIERARCHY).rend());
+        reverse(buffer.begin(), buffer.end());
     }
 
     bool WidgetTree::IsRootWidgetHierarchy(string_view hierarchy)
@@ -436,6 +2168,6 @@ namespace OHOS::uitest {
 
     inline bool WidgetTree::CheckIsMyNode(const Widget &widget) const
     {
-        return this->identifier_ == widget.GetHostTreeId();
+        return widget.hostIndex_ < widgets_.GetSize() && &widgets_[widget.hostIndex_] == &widget;
     }
 } // namespace OHOS::uitest
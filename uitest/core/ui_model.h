@@ -17,7 +17,14 @@
 #define UI_MODEL_H
 
 #include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
 #include <sstream>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include "common_defines.h"
 #include "common_utilities_hpp.h"
 #include "json.hpp"
 
@@ -68,36 +75,316 @@ namespace OHOS::uitest {
         bool CompareTo(const Rect &other) const;
     };
 
+    /**
+     * Packed R-tree over a fixed set of rectangles, the position of each rectangle in the source list is its id.
+     * Point and nearest queries visit the overlapping/closest branches only, which is sublinear in the rectangle count.
+     * */
+    class SpatialIndex {
+    public:
+        explicit SpatialIndex(const std::vector<Rect> &rects);
+
+        /**Collect ids of the rectangles containing the point (right/bottom edges exclusive), in ascending order.*/
+        void QueryPoint(const Point &point, std::vector<uint32_t> &ids) const;
+
+        /**Collect ids of the rectangles overlapping the given area (with positive overlapped size), ascending order.*/
+        void QueryRect(const Rect &area, std::vector<uint32_t> &ids) const;
+
+        /**
+         * Find the rectangle accepted by the filter which is nearest to the point, the distance is zero if the point
+         * is inside the rectangle. Ties are broken by the larger id.
+         *
+         * @returns false if no rectangle is accepted.
+         * */
+        bool QueryNearest(const Point &point, const std::function<bool(uint32_t)> &filter, uint32_t &id) const;
+
+    private:
+        /**Index node, the children are items_[begin_, end_) for leaves, otherwise nodes_[begin_, end_).*/
+        struct Node {
+            Rect box_ = {0, 0, 0, 0};
+            uint32_t begin_ = 0;
+            uint32_t end_ = 0;
+            bool leaf_ = true;
+        };
+
+        std::vector<Rect> rects_;
+        std::vector<uint32_t> items_;
+        // nodes are stored level by level from the leaves, the root is the last one
+        std::vector<Node> nodes_;
+    };
+
+    /**
+     * Dense set of dfs indexes of the widgets on a tree. The set operations run word by word over plain arrays, which
+     * the compiler vectorizes, and the members are enumerated in ascending order by skipping the zero words.
+     * */
+    class DfsBitset {
+    public:
+        DfsBitset() = default;
+
+        /**Create a set over the indexes [0, size), which is empty or full.*/
+        explicit DfsBitset(uint32_t size, bool full = false);
+
+        uint32_t GetSize() const
+        {
+            return size_;
+        }
+
+        void Set(uint32_t index)
+        {
+            words_[index / WORD_BITS] |= uint64_t(1) << (index % WORD_BITS);
+        }
+
+        bool Test(uint32_t index) const
+        {
+            return (words_[index / WORD_BITS] & (uint64_t(1) << (index % WORD_BITS))) != 0;
+        }
+
+        /**Intersect with the other set of the same size.*/
+        void And(const DfsBitset &other);
+
+        /**Unite with the other set of the same size.*/
+        void Or(const DfsBitset &other);
+
+        /**Remove the members of the other set of the same size.*/
+        void AndNot(const DfsBitset &other);
+
+        /**Keep the members in the range [from, to) only.*/
+        void KeepRange(uint32_t from, uint32_t to);
+
+        /**Add all the indexes in the range [from, to) as members.*/
+        void SetRange(uint32_t from, uint32_t to);
+
+        uint32_t Count() const;
+
+        bool IsEmpty() const;
+
+        /**Find the smallest member, returns false if the set is empty.*/
+        bool FindFirst(uint32_t &index) const;
+
+        /**Find the largest member, returns false if the set is empty.*/
+        bool FindLast(uint32_t &index) const;
+
+        /**Visit the members in ascending order.*/
+        template<class Receiver> void ForEach(Receiver &&receiver) const
+        {
+            for (uint32_t word = 0; word < words_.size(); word++) {
+                for (auto bits = words_[word]; bits != 0; bits &= bits - 1) {
+                    receiver(word * WORD_BITS + static_cast<uint32_t>(__builtin_ctzll(bits)));
+                }
+            }
+        }
+
+    private:
+        static constexpr uint32_t WORD_BITS = 64;
+        uint32_t size_ = 0;
+        // bits beyond the size are always zero
+        std::vector<uint64_t> words_;
+    };
+
     class Widget;
 
+    class WidgetTree;
+
     /**Inner used widget attributes.*/
     constexpr auto ATTR_HIERARCHY = "hierarchy";
     constexpr auto ATTR_HASHCODE = "hashcode";
 
-    class Widget {
+    /**
+     * Fold the value by the ValueMatchFlag bits into the receiver. IGNORE_CASE lowers the ASCII, Latin-1, Greek and
+     * Cyrillic capital letters, NORMALIZE_WHITESPACE trims the whitespaces (ASCII, no-break and ideographic spaces)
+     * and collapses their runs into one space.
+     * */
+    void FoldValue(std::string_view value, uint8_t flags, std::string &receiver);
+
+    /**Pool of interned strings, the interned string views keep valid during the lifetime of the pool.*/
+    class StringPool {
     public:
-        // disable default constructor, copy constructor and assignment operator
-        explicit Widget(std::string_view hierarchy) : hierarchy_(hierarchy)
+        StringPool() = default;
+
+        StringPool(const StringPool &) = delete;
+
+        StringPool &operator=(const StringPool &) = delete;
+
+        ~StringPool() {}
+
+        /**Intern the given string, returns the pooled view equals to it. Equal strings share the same storage.*/
+        std::string_view Intern(std::string_view str);
+
+        /**Get the total length of the interned strings.*/
+        size_t GetStoredBytes() const
+        {
+            return storedBytes_;
+        }
+
+    private:
+        std::unordered_set<std::string_view> views_;
+        // chunked character storage, blocks are never reallocated so the views keep valid
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        size_t blockUsed_ = 0;
+        size_t storedBytes_ = 0;
+    };
+
+    /**
+     * Append-only array stored in fixed-size chunks. The chunks are shared between arrays by reference and a shared
+     * chunk is copied on its first modification. Items never move once appended, so their addresses stay valid.
+     * */
+    template<typename T>
+    class ChunkedArray {
+    public:
+        static constexpr uint32_t CHUNK_BITS = 6;
+        static constexpr uint32_t CHUNK_SIZE = 1U << CHUNK_BITS;
+
+        size_t GetSize() const
+        {
+            return size_;
+        }
+
+        bool IsEmpty() const
         {
-            attributes_.insert(std::make_pair(ATTR_HIERARCHY, hierarchy));
+            return size_ == 0;
+        }
+
+        const T &operator[](size_t index) const
+        {
+            return chunks_[index >> CHUNK_BITS]->items_[index & (CHUNK_SIZE - 1)];
+        }
+
+        /**Get the item for modification. If the chunk holding the item is shared, it is copied first.*/
+        T &GetMutable(size_t index)
+        {
+            auto &chunk = chunks_[index >> CHUNK_BITS];
+            if (chunk.use_count() > 1) {
+                auto copied = NewChunk();
+                copied->items_.assign(chunk->items_.begin(), chunk->items_.end());
+                chunk = copied;
+            }
+            return chunk->items_[index & (CHUNK_SIZE - 1)];
+        }
+
+        /**Append an item. The last chunk must not be shared.*/
+        template<typename... Args>
+        T &EmplaceBack(Args &&...args)
+        {
+            if ((size_ & (CHUNK_SIZE - 1)) == 0) {
+                chunks_.emplace_back(NewChunk());
+            }
+            size_++;
+            return chunks_.back()->items_.emplace_back(std::forward<Args>(args)...);
+        }
+
+        /**Share all the chunks of the other array, replacing the current content.*/
+        void ShareChunks(const ChunkedArray &other)
+        {
+            chunks_ = other.chunks_;
+            size_ = other.size_;
+        }
+
+        /**Replace the chunk at the given position. The items must cover exactly the range of the replaced chunk.*/
+        void ReplaceChunk(size_t chunkIndex, std::vector<T> &&items)
+        {
+            auto chunk = NewChunk();
+            chunk->items_ = std::move(items);
+            chunks_[chunkIndex] = chunk;
+        }
+
+        /**Set the object that the chunks created from now on keep alive, the items may refer to it.*/
+        void SetChunkOwner(std::shared_ptr<const void> owner)
+        {
+            owner_ = std::move(owner);
+        }
+
+    private:
+        struct Chunk {
+            std::vector<T> items_;
+            std::shared_ptr<const void> owner_;
         };
 
+        std::shared_ptr<Chunk> NewChunk() const
+        {
+            auto chunk = std::make_shared<Chunk>();
+            chunk->items_.reserve(CHUNK_SIZE);
+            chunk->owner_ = owner_;
+            return chunk;
+        }
+
+        std::vector<std::shared_ptr<Chunk>> chunks_;
+        size_t size_ = 0;
+        std::shared_ptr<const void> owner_;
+    };
+
+    /**Topology of a widget node, all the links are indexes of the dfs-ordered widgets, -1 for none.*/
+    struct WidgetNode {
+        int32_t parent_ = -1;
+        int32_t firstChild_ = -1;
+        int32_t nextSibling_ = -1;
+        // end (exclusive) of the dfs-ordered subtree range rooted at this node, the node index and it form the
+        // dfs interval of the node, nested intervals are of the descendants
+        uint32_t subtreeEnd_ = 0;
+        // index of this node in the children of its parent on the source dom
+        uint32_t childIndex_ = 0;
+        // merkle hash of the subtree rooted at this node
+        uint64_t subtreeHash_ = 0;
+    };
+
+    /**
+     * Topology of the widgets constructed by a tree. Trees constructed from a base share its unchanged widgets. A
+     * shared widget keeps the topology of the tree that created it, which is still valid for the widget because its
+     * index and its ancestors are unchanged.
+     * */
+    struct WidgetTopology {
+        ChunkedArray<WidgetNode> nodes_;
+        // identifier of the tree, inherited by the trees constructed from base
+        std::string treeId_;
+    };
+
+    class Widget {
+    public:
+        // disable default constructor, copy constructor and assignment operator
+        explicit Widget(std::string_view hierarchy);
+
         virtual ~Widget() {}
 
+        Widget(Widget &&) = default;
+
         bool HasAttr(std::string_view name) const;
 
         std::string GetAttr(std::string_view name, std::string_view defaultVal) const;
 
-        Rect GetBounds() const
+        /**
+         * Get the attribute value without heap allocation in steady state: the stored values are viewed in place and
+         * the others (id, bounds, hierarchy) are rendered into the given buffer, whose capacity is reused across calls.
+         * The view is valid until the buffer is changed. Returns false if there's no such attribute.
+         * */
+        bool GetAttrView(std::string_view name, std::string &buffer, std::string_view &value) const;
+
+        /**Get the value of string typed builtin attribute (text/key/type), returns empty view if absent.*/
+        std::string_view GetStrAttr(UiAttr attr) const;
+
+        /**Get the value of bool typed builtin attribute, returns false if absent.*/
+        bool GetBoolAttr(UiAttr attr) const;
+
+        /**Get the value of int typed builtin attribute (id), returns 0 if absent.*/
+        int32_t GetIntAttr(UiAttr attr) const;
+
+        /**Check if the builtin attribute is present and held in its typed slot.*/
+        bool HasTypedAttr(UiAttr attr) const
         {
-            return bounds_;
+            return (presentBits_ & (1U << attr)) != 0;
         }
 
-        std::string GetHierarchy() const
+        /**
+         * Get the value of the custom attribute, or the builtin one whose value does not fit its typed slot, without
+         * copying. Returns false if there's no such attribute.
+         * */
+        bool GetCustomAttr(std::string_view name, std::string_view &value) const;
+
+        Rect GetBounds() const
         {
-            return hierarchy_;
+            return bounds_;
         }
 
+        /**Get the hierarchy of this widget, which is generated on demand for the tree-hosted widgets.*/
+        std::string GetHierarchy() const;
+
         void SetAttr(std::string_view name, std::string_view value);
 
         void SetHostTreeId(std::string_view tid);
@@ -111,10 +398,39 @@ namespace OHOS::uitest {
         void DumpAttributes(std::map<std::string, std::string> &receiver) const;
 
     private:
-        const std::string hierarchy_;
-        std::string hostTreeId_;
-        std::map <std::string, std::string> attributes_;
+        friend class WidgetTree;
+        /**Construct widget whose strings are interned into the given pool, used by the host tree.*/
+        explicit Widget(StringPool &pool) : pool_(&pool) {}
+
+        /**Render the builtin attribute value as text, the attribute must be present.*/
+        std::string RenderAttr(UiAttr attr) const;
+
+        /**Render the builtin attribute value as text into the buffer, the attribute must be present.*/
+        void RenderAttr(UiAttr attr, std::string &buffer) const;
+
+        /**Find the custom attribute entry, returns <code>nullptr</code> if absent.*/
+        const std::pair<std::string_view, std::string_view> *FindCustomAttr(std::string_view name) const;
+
+        /**Data of standalone widget, tree-hosted widgets get them from the host tree.*/
+        struct StandaloneData {
+            StringPool pool_;
+            std::string hierarchy_;
+            std::string hostTreeId_;
+        };
+
+        StringPool *pool_ = nullptr;
+        std::unique_ptr<StandaloneData> standalone_;
+        // topology of the tree constructing this widget and the dfs-order index of this widget on it
+        const WidgetTopology *hostTopology_ = nullptr;
+        uint32_t hostIndex_ = 0;
+        // typed slots of builtin attributes, indexed by UiAttr
+        uint16_t presentBits_ = 0;
+        uint16_t boolBits_ = 0;
+        int32_t id_ = 0;
+        std::string_view strings_[UiAttr::TYPE - UiAttr::TEXT + 1];
         Rect bounds_ = {0, 0, 0, 0};
+        // custom attributes and the builtin ones whose value does not fit the typed slot, names are unique
+        std::vector<std::pair<std::string_view, std::string_view>> customAttrs_;
     };
 
     // ensure Widget is movable, since we need to move a constructed Widget object into WidgetTree
@@ -123,15 +439,59 @@ namespace OHOS::uitest {
     class WidgetVisitor {
     public:
         virtual void Visit(const Widget &widget) = 0;
+
+        /**Check if the visitor needs no more widgets, the traversal stops once it returns true.*/
+        virtual bool IsSatisfied() const
+        {
+            return false;
+        }
+    };
+
+    /**
+     * Sink of widget nodes, which receives the nodes in dfs order: <code>BeginNode</code>, the attributes and bounds
+     * of the node, the child nodes, then <code>EndNode</code>.
+     * */
+    class WidgetTreeBuilder {
+    public:
+        virtual ~WidgetTreeBuilder() = default;
+
+        virtual void BeginNode() = 0;
+
+        virtual void Attr(std::string_view name, std::string_view value) = 0;
+
+        virtual void Bounds(const Rect &bounds) = 0;
+
+        virtual void EndNode() = 0;
+
+        /**Push the nodes of the given dom data into this builder.*/
+        void AcceptDom(const nlohmann::json &dom);
+
+        /**
+         * Push the nodes of the given layout json text into this builder by sax parsing, without building the dom.
+         * Node attributes are expected ahead of the children, which is the key order of the dumped layouts.
+         *
+         * @returns false if the text is not a well-formed json.
+         * */
+        bool AcceptLayout(std::string_view layout);
     };
 
     class WidgetTree {
     public:
         WidgetTree() = delete;
 
+        // the tree refers into its topology, so it is neither copyable nor movable
+        WidgetTree(const WidgetTree &) = delete;
+
+        WidgetTree &operator=(const WidgetTree &) = delete;
+
         ~WidgetTree() {}
 
-        explicit WidgetTree(std::string name) : name_(std::move(name)), identifier_(GenerateTreeId()) {}
+        explicit WidgetTree(std::string name) : name_(std::move(name))
+        {
+            topology_->treeId_ = GenerateTreeId();
+            // the widgets refer to the topology, keep it alive with their chunks which may outlive this tree
+            widgets_.SetChunkOwner(topology_);
+        }
 
         /**
          * Construct tree nodes from the given dom data.
@@ -141,6 +501,42 @@ namespace OHOS::uitest {
          * */
         void ConstructFromDom(const nlohmann::json& dom, bool amendBounds);
 
+        /**
+         * Construct tree nodes from the given layout json text, the dom data is not built.
+         *
+         * @param layout: the layout json text.
+         * @param amendBounds: if or not amend widget bounds and visibility.
+         * @returns false if the text is not a well-formed json.
+         * */
+        bool ConstructFromLayout(std::string_view layout, bool amendBounds);
+
+        /**
+         * Construct tree nodes pushed by the given source.
+         *
+         * @param source: the function which pushes the nodes into the given builder.
+         * @param amendBounds: if or not amend widget bounds and visibility.
+         * */
+        void ConstructFromSource(const std::function<void(WidgetTreeBuilder &)> &source, bool amendBounds);
+
+        /**
+         * Construct tree nodes from the given base tree, where the subtrees rooted at the given widgets are pushed by
+         * the source again, and the other nodes keep their hierarchies. The string storage is shared with the base
+         * tree, so the trees should be constructed on the same thread. If every subtree is pushed with its previous
+         * node count, the nodes keep their indexes and the unchanged ranges are shared with the base tree by chunks,
+         * so only the chunks holding the pushed nodes and the ancestor hashes are rebuilt. Otherwise all the nodes
+         * are copied.
+         *
+         * @param base: the base tree.
+         * @param dirtyRoots: the root widgets of the subtrees to update, which are on the base tree.
+         * @param source: the function which pushes the subtree of the given widget into the builder, returns false
+         * if the subtree is not available.
+         * @param amendBounds: if or not amend widget bounds and visibility.
+         * @returns false if any subtree is not available, then the constructed tree should be discarded.
+         * */
+        bool ConstructFromBase(const WidgetTree &base, const std::vector<const Widget *> &dirtyRoots,
+                               const std::function<bool(const Widget &, WidgetTreeBuilder &)> &source,
+                               bool amendBounds);
+
         /**
          * Marshal tree nodes hierarchy into the given dom data.
          *
@@ -148,6 +544,35 @@ namespace OHOS::uitest {
          * */
         void MarshalIntoDom(nlohmann::json& dom) const;
 
+        /**
+         * Marshal tree nodes into the compact binary layout format, which holds a deduplicated string table, the
+         * bounds in separated arrays and a fixed-size node table. Hierarchies are kept, bounds are not amended again.
+         *
+         * @param out: receives the binary layout data.
+         * */
+        void MarshalIntoBinary(std::string &out) const;
+
+        /**
+         * Construct tree nodes from the binary layout data, the strings are copied into this tree. The data is in the
+         * byte order of the host writing it, so it's portable between the hosts of the same byte order only. Loading
+         * constructs every widget, which is O(n) in the node count, though no text is parsed.
+         *
+         * @param data: the binary layout data.
+         * @returns false if the data is not a valid binary layout of the supported version and host byte order.
+         * */
+        bool ConstructFromBinary(std::string_view data);
+
+        /**
+         * Construct tree nodes from the binary layout file by memory mapping, nothing is parsed and the strings are
+         * referenced in place, but every widget is still constructed in O(n). The mapping is released with the last
+         * tree referencing it. The byte order requirement is the same as <code>ConstructFromBinary</code>.
+         *
+         * @param path: the binary layout file path.
+         * @returns false if the file cannot be mapped or it's not a valid binary layout of the supported version and
+         * host byte order.
+         * */
+        bool LoadFromBinaryFile(std::string_view path);
+
         void DfsTraverse(WidgetVisitor &visitor) const;
 
         void DfsTraverseFronts(WidgetVisitor &visitor, const Widget &pivot) const;
@@ -156,6 +581,39 @@ namespace OHOS::uitest {
 
         void DfsTraverseDescendants(WidgetVisitor &visitor, const Widget &root) const;
 
+        /**Visit the ancestors of the given widget in dfs order, from the root to its parent.*/
+        void DfsTraverseAncestors(WidgetVisitor &visitor, const Widget &widget) const;
+
+        /**
+         * Get the dfs interval of the given widget, the widgets of its subtree are those whose dfs index are in it.
+         *
+         * @param widget: the widget on this tree.
+         * @param enter: receives the dfs index of the widget.
+         * @param exit: receives the end (exclusive) dfs index of its subtree.
+         * */
+        void GetDfsInterval(const Widget &widget, uint32_t &enter, uint32_t &exit) const;
+
+        /**Check if the widget is a descendant of the given ancestor, in O(1) time.*/
+        bool IsDescendantOf(const Widget &widget, const Widget &ancestor) const;
+
+        /**
+         * Get the merkle hash of the subtree rooted at the given widget, which covers the type and text of the nodes
+         * and the tree structure. Equal subtrees on any trees have the same hash.
+         * */
+        uint64_t GetSubtreeHash(const Widget &widget) const;
+
+        /**
+         * Collect the topmost changed subtrees of this tree compared to the subtree of the base tree.
+         *
+         * @param root: the root of the subtree on this tree.
+         * @param base: the base tree.
+         * @param baseRoot: the root of the compared subtree on the base tree.
+         * @param receiver: receives the roots of the changed subtrees on this tree, a node is changed if its type,
+         * text or children count differs, or any descendant is changed.
+         * */
+        void CollectChangedSubtrees(const Widget &root, const WidgetTree &base, const Widget &baseRoot,
+                                    std::vector<const Widget *> &receiver) const;
+
         /**
          * Get the root widget node.
          *
@@ -180,28 +638,197 @@ namespace OHOS::uitest {
          * */
         const Widget *GetChildWidget(const Widget &widget, uint32_t index) const;
 
+        /**
+         * Get widget by hierarchy, return <code>nullptr</code> if no such widget exist.
+         * */
+        const Widget *GetWidgetByHierarchy(std::string_view hierarchy) const;
+
+        /**Get the widget whose id attribute is the given value, returns <code>nullptr</code> if no such widget exist.*/
+        const Widget *GetWidgetById(int32_t id) const;
+
+        /**
+         * Get the topmost widget whose bounds contains the given point, which is the last one in dfs order.
+         *
+         * @returns the widget pointer, or <code>nullptr</code> if no widget is at the point.
+         * */
+        const Widget *GetWidgetAt(const Point &point) const;
+
+        /**
+         * Get the widget accepted by the filter whose bounds is nearest to the given point, the topmost one wins ties.
+         *
+         * @returns the widget pointer, or <code>nullptr</code> if no widget is accepted.
+         * */
+        const Widget *GetNearestWidget(const Point &point, const std::function<bool(const Widget &)> &filter) const;
+
+        /**
+         * Get the dfs indexes of the widgets whose attribute value equals to the given value, in ascending order. The
+         * value index of the attribute is built on first query, the hierarchy attribute is not indexed.
+         * */
+        const std::vector<uint32_t> &GetWidgetsByAttrValue(std::string_view attrName, std::string_view value) const;
+
+        /**
+         * Get the dfs indexes of the widgets whose attribute value matches the test value by the rule, in ascending
+         * order. Besides the value index, the sorted affix and trigram indexes of the attribute are built on first
+         * non-EQ query, so only the distinct values sharing the affix or grams are tested. The max edit distance
+         * applies to the FUZZY rule only. With the ValueMatchFlag bits, the values are folded by <code>FoldValue</code>
+         * and indexed on first query, the test value must be folded by the caller.
+         * */
+        void GetWidgetsByAttrMatch(std::string_view attrName, std::string_view testValue, ValueMatchRule rule,
+                                   std::vector<uint32_t> &receiver, uint32_t maxDistance = 0, uint8_t flags = 0) const;
+
+        /**
+         * Get the set of the widgets whose attribute value matches the test value by the rule. The sets are computed
+         * from the attribute indexes and cached on the tree, so the selectors sharing predicates reuse them. The
+         * hierarchy attribute is not supported.
+         * */
+        std::shared_ptr<const DfsBitset> GetAttrMatchBits(std::string_view attrName, std::string_view testValue,
+                                                          ValueMatchRule rule, uint32_t maxDistance = 0,
+                                                          uint8_t flags = 0) const;
+
+        /**Get the widget at the given dfs index, which must be less than the widget count.*/
+        const Widget &GetWidgetByDfsIndex(uint32_t index) const
+        {
+            return widgets_[index];
+        }
+
+        /**Get the dfs index of the widget, which must be hosted on this tree.*/
+        uint32_t GetDfsIndex(const Widget &widget) const
+        {
+            return widget.hostIndex_;
+        }
+
+        /**Get the spatial index over the widget bounds whose ids are the dfs indexes, it's built on first use.*/
+        const SpatialIndex &GetSpatialIndex() const;
+
+        /**
+         * Get the generation of this tree, which is unique among the constructed trees and increases by construction
+         * order. A tree is immutable once constructed, so the trees of the same generation are the same snapshot.
+         * */
+        uint64_t GetGeneration() const
+        {
+            return generation_;
+        }
+
+        /**
+         * Get the total length of the strings stored for this tree. The storage is shared with the trees constructed
+         * from base and never shrinks, so it includes the strings of the base trees and of the derived ones.
+         * */
+        size_t GetStringStorageSize() const
+        {
+            return stringPool_->GetStoredBytes();
+        }
+
+        /**Get the count of the widgets on this tree.*/
+        size_t GetWidgetCount() const
+        {
+            return widgets_.GetSize();
+        }
+
         /**Check if the given widget node hierarchy is the root node hierarchy.*/
         static bool IsRootWidgetHierarchy(std::string_view hierarchy);
 
     private:
         const std::string name_;
-        const std::string identifier_;
+        const std::shared_ptr<WidgetTopology> topology_ = std::make_shared<WidgetTopology>();
         bool widgetsConstructed_ = false;
-        // widget-hierarchy VS widget-ptr
-        std::map <std::string, Widget> widgetMap_;
-        // widget-hierarchies, dfs order
-        std::vector <std::string> widgetHierarchyIdDfsOrder_;
+        uint64_t generation_ = 0;
+        // storage of the widget strings, declared ahead of the widgets to outlive them. The trees constructed from
+        // base share the pool of the base tree, so the unchanged strings are stored once across the snapshots
+        std::shared_ptr<StringPool> stringPool_ = std::make_shared<StringPool>();
+        // storage of the strings referenced in place (the mapped binary layout), shared with the derived trees
+        std::shared_ptr<const void> backingData_;
+        // widgets and their topology nodes, dfs order. The chunks of the unchanged ranges are shared with the base tree
+        ChunkedArray<Widget> widgets_;
+        ChunkedArray<WidgetNode> &nodes_ = topology_->nodes_;
+        // lazily built spatial index of the widget bounds
+        mutable std::unique_ptr<SpatialIndex> spatialIndex_;
+        /**Inverted index of an attribute, from the value to the ascending dfs indexes of the widgets.*/
+        struct AttrValueIndex {
+            std::unordered_map<std::string_view, std::vector<uint32_t>> postings_;
+            // rendered values which are not stored on the widgets, the views keep valid in the deque
+            std::deque<std::string> renderedValues_;
+            // distinct values in lexicographic order, for the prefix lookup
+            std::vector<std::string_view> sortedValues_;
+            // reversed distinct values in lexicographic order with their positions in sortedValues_
+            std::vector<std::pair<std::string, uint32_t>> reversedValues_;
+            // from the packed 3-byte grams to the ascending positions in sortedValues_ of the values containing them
+            std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams_;
+            bool affixIndexed_ = false;
+        };
+        // lazily built inverted indexes, keyed by attribute name
+        mutable std::unordered_map<std::string, std::unique_ptr<AttrValueIndex>> attrIndexes_;
+        // lazily built inverted indexes of the folded values, keyed by the flags and the attribute name
+        mutable std::unordered_map<std::string, std::unique_ptr<AttrValueIndex>> foldedIndexes_;
+        // cached match sets of the attribute predicates, keyed by the predicate
+        mutable std::unordered_map<std::string, std::shared_ptr<const DfsBitset>> matchBits_;
+
+        /**Get the inverted index of the attribute, build it if absent.*/
+        AttrValueIndex &GetAttrValueIndex(std::string_view attrName) const;
+
+        /**Get the inverted index of the attribute values folded by the flags, build it from the plain one if absent.*/
+        AttrValueIndex &GetFoldedValueIndex(std::string_view attrName, uint8_t flags) const;
+
+        /**Build the sorted affix and trigram indexes over the distinct values of the inverted index.*/
+        static void BuildAffixIndex(AttrValueIndex &index);
+
+        /**Collect the positions of the sorted values containing the test value, by the gram postings.*/
+        static void CollectValuesContaining(const AttrValueIndex &index, std::string_view testValue,
+                                            std::vector<uint32_t> &positions);
+
+        /**Append widget as the last child of the given parent (-1 for root), returns the widget index.*/
+        uint32_t AppendWidget(Widget &&widget, int32_t parent, uint32_t childIndex, std::vector<int32_t> &lastChildren);
+
+        /**Amend bounds of the widget and append it, returns the widget index or -1 if it's discarded.*/
+        int32_t AppendBuiltWidget(Widget &&widget, int32_t parent, uint32_t childIndex, bool amendBounds,
+                                  std::vector<int32_t> &lastChildren);
+
+        /**Create an empty widget whose strings are interned into this tree.*/
+        Widget CreateWidget()
+        {
+            return Widget(*stringPool_);
+        }
+
+        /**Create a copy of the given widget whose strings are interned into this tree.*/
+        Widget CloneWidget(const Widget &from);
+
+        /**Fill subtree ranges and hashes, and mark the construction done, called after all the nodes are appended.*/
+        void FinishConstruction();
+
+        /**Reset the lazily built caches and mark the construction done.*/
+        void MarkConstructed();
+
+        /**Compute the subtree hash of the widget at the given index, whose children hashes are computed.*/
+        uint64_t ComputeSubtreeHash(uint32_t index) const;
 
         /**
-         * Get WidgetTree by hierarchy,return <code>nullptr</code> if no such widget exist.
+         * Construct the nodes from the base tree, sharing the chunks outside of the refetched subtrees. Each
+         * subtree must be fetched with the same node count, so that all the other nodes keep their indexes.
          * */
-        const Widget *GetWidgetByHierarchy(std::string_view hierarchy) const;
+        void ShareFromBase(const WidgetTree &base, const std::vector<uint32_t> &roots,
+                           const std::vector<std::unique_ptr<WidgetTree>> &subtrees);
+
+        class NodeSink;
+
+        /**Construct tree nodes from the binary layout data, the strings are referenced in place or interned.*/
+        bool ConstructFromBinaryData(std::string_view data, bool inPlace);
+
+        /**Build the hierarchy string of the widget at the given index on the topology.*/
+        static std::string BuildHierarchy(const WidgetTopology &topology, uint32_t index);
+
+        /**Build the hierarchy of the widget at the given index on the topology into the buffer, without other
+         * allocation.*/
+        static void BuildHierarchy(const WidgetTopology &topology, uint32_t index, std::string &buffer);
+
+        /**Marshal the subtree rooted at the given widget index into dom data.*/
+        void MarshalWidget(uint32_t index, nlohmann::json &dom) const;
 
         /**Check if the given widget is in this tree.*/
         inline bool CheckIsMyNode(const Widget &widget) const;
 
         /**Generated an unique tree-identifier.*/
         static std::string GenerateTreeId();
+
+        friend class Widget;
     };
 } // namespace uitest
 
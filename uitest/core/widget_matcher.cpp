@@ -13,6 +13,11 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <charconv>
+#include <mutex>
+#include <unordered_map>
+#include "substring_search.h"
 #include "widget_matcher.h"
 
 namespace OHOS::uitest {
@@ -30,47 +35,177 @@ namespace OHOS::uitest {
                 return "startsWith";
             case ENDS_WITH:
                 return "endsWith";
+            case REGEX:
+                return "matches";
+            case FUZZY:
+                return "fuzzy";
         }
     }
 
-    bool ValueMatcher::Matches(string_view testedValue) const
+    // selectivity ranks of the rules, lower is more selective: EQ, CONTAINS, STARTS_WITH, ENDS_WITH, REGEX, FUZZY
+    static constexpr uint8_t RULE_RANKS[] = {0, 2, 1, 1, 3, 4};
+
+    /**Get the compiled automaton of the test value if the rule is REGEX.*/
+    static shared_ptr<const RegexAutomaton> GetRegex(string_view testValue, ValueMatchRule rule)
+    {
+        return rule == REGEX ? RegexAutomaton::Get(testValue) : nullptr;
+    }
+
+    /**Get the compiled edit distance pattern of the test value if the rule is FUZZY.*/
+    static shared_ptr<const EditDistancePattern> GetFuzzy(string_view testValue, ValueMatchRule rule,
+                                                          uint32_t maxDistance)
     {
-        switch (rule_) {
+        return rule == FUZZY ? EditDistancePattern::Get(testValue, maxDistance) : nullptr;
+    }
+
+    /**Test the value with the compiled automaton of the REGEX rule or the compiled pattern of the FUZZY rule, an
+     * illegal pattern matches nothing.*/
+    static inline bool MatchValue(string_view testedValue, string_view testValue, ValueMatchRule rule,
+                                  const shared_ptr<const RegexAutomaton> &regex,
+                                  const shared_ptr<const EditDistancePattern> &fuzzy)
+    {
+        if (rule == REGEX) {
+            return regex != nullptr && regex->Matches(testedValue);
+        } else if (rule == FUZZY) {
+            return fuzzy->Matches(testedValue);
+        }
+        return MatchValue(testedValue, testValue, rule);
+    }
+
+    /**Fold the test value by the flags, the escaped characters of a REGEX pattern are kept as they are and its
+     * whitespaces are not normalized, which would change the meaning of the pattern.*/
+    static string FoldTestValue(string_view testValue, ValueMatchRule rule, uint8_t flags)
+    {
+        string folded;
+        if (rule != REGEX) {
+            FoldValue(testValue, flags, folded);
+            return folded;
+        }
+        if ((flags & IGNORE_CASE) == 0) {
+            return string(testValue);
+        }
+        string piece;
+        for (size_t offset = 0; offset < testValue.length();) {
+            const auto escape = testValue.find('\\', offset);
+            FoldValue(testValue.substr(offset, escape - offset), IGNORE_CASE, piece);
+            folded.append(piece);
+            if (escape == string_view::npos) {
+                break;
+            }
+            folded.append(testValue.substr(escape, INDEX_TWO));
+            offset = escape + INDEX_TWO;
+        }
+        return folded;
+    }
+
+    // buffer of the tested values folded for matching, reused to avoid allocation per widget
+    static thread_local string g_foldBuffer;
+
+    /**Fold the tested value by the flags into the reused buffer, the value is returned as is without flags.*/
+    static inline string_view FoldTestedValue(string_view testedValue, uint8_t flags)
+    {
+        if (flags == 0) {
+            return testedValue;
+        }
+        FoldValue(testedValue, flags, g_foldBuffer);
+        return g_foldBuffer;
+    }
+
+    /**Describe the match flags, empty if there is none.*/
+    static string DescribeFlags(uint8_t flags)
+    {
+        string desc;
+        if ((flags & IGNORE_CASE) != 0) {
+            desc.append(" ignoreCase");
+        }
+        if ((flags & NORMALIZE_WHITESPACE) != 0) {
+            desc.append(" normalizeWhitespace");
+        }
+        return desc;
+    }
+
+    bool MatchValue(string_view testedValue, string_view testValue, ValueMatchRule rule, uint32_t maxDistance)
+    {
+        switch (rule) {
             case EQ:
-                return testedValue == testValue_;
+                return testedValue == testValue;
             case CONTAINS:
-                return testedValue.find(testValue_) != string::npos;
+                return FindSubstring(testedValue, testValue) != string_view::npos;
             case STARTS_WITH:
-                return testedValue.find(testValue_) == 0;
+                return testedValue.substr(0, testValue.length()) == testValue;
             case ENDS_WITH:
-                return (testedValue.find(testValue_) == (testedValue.length() - testValue_.length()));
+                return testedValue.length() >= testValue.length() &&
+                    testedValue.substr(testedValue.length() - testValue.length()) == testValue;
+            case REGEX:
+                return MatchValue(testedValue, testValue, rule, RegexAutomaton::Get(testValue), nullptr);
+            case FUZZY:
+                return EditDistancePattern::Get(testValue, maxDistance)->Matches(testedValue);
+            default:
+                return false;
         }
     }
 
+    ValueMatcher::ValueMatcher(string testValue, ValueMatchRule rule, uint32_t maxDistance, uint8_t flags)
+        : testValue_(move(testValue)), rule_(rule), maxDistance_(rule == FUZZY ? maxDistance : 0), flags_(flags),
+          foldedValue_(FoldTestValue(testValue_, rule_, flags_)), regex_(GetRegex(foldedValue_, rule_)),
+          fuzzy_(GetFuzzy(foldedValue_, rule_, maxDistance_)) {}
+
+    bool ValueMatcher::Matches(string_view testedValue) const
+    {
+        return MatchValue(FoldTestedValue(testedValue, flags_), foldedValue_, rule_, regex_, fuzzy_);
+    }
+
     string ValueMatcher::Describe() const
     {
         stringstream ss;
         ss << GetRuleName(rule_);
         ss << " '" << testValue_ << "'";
+        if (rule_ == FUZZY) {
+            ss << " within " << maxDistance_;
+        }
+        ss << DescribeFlags(flags_);
         return ss.str();
     }
 
-    WidgetAttrMatcher::WidgetAttrMatcher(string_view attr, string_view testValue, ValueMatchRule rule)
-        : attrName_(attr), testVal_(testValue), matchRule_(rule) {}
+    WidgetAttrMatcher::WidgetAttrMatcher(string_view attr, string_view testValue, ValueMatchRule rule,
+                                         uint32_t maxDistance, uint8_t flags)
+        : attrName_(attr), testVal_(testValue), matchRule_(rule), maxDistance_(rule == FUZZY ? maxDistance : 0),
+          flags_(flags), foldedVal_(FoldTestValue(testValue, rule, flags)), regex_(GetRegex(foldedVal_, rule)),
+          fuzzy_(GetFuzzy(foldedVal_, rule, maxDistance_)) {}
+
+    // buffer of the attribute values rendered for matching, reused to avoid allocation per widget
+    static thread_local string g_renderBuffer;
 
     bool WidgetAttrMatcher::Matches(const Widget &widget) const
     {
-        if (!widget.HasAttr(attrName_)) {
-            return false;
-        }
-        auto attrValue = widget.GetAttr(attrName_, "");
-        auto valueMatcher = ValueMatcher(testVal_, matchRule_);
-        return valueMatcher.Matches(attrValue);
+        string_view value;
+        return widget.GetAttrView(attrName_, g_renderBuffer, value) &&
+            MatchValue(FoldTestedValue(value, flags_), foldedVal_, matchRule_, regex_, fuzzy_);
     };
 
+    void WidgetMatcher::MatchBits(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        const auto count = static_cast<uint32_t>(tree.GetWidgetCount());
+        bits = DfsBitset(count);
+        for (uint32_t index = 0; index < count; index++) {
+            if (Matches(tree.GetWidgetByDfsIndex(index))) {
+                bits.Set(index);
+            }
+        }
+    }
+
+    void WidgetAttrMatcher::MatchBits(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        if (attrName_ == ATTR_HIERARCHY) {
+            WidgetMatcher::MatchBits(tree, bits);
+        } else {
+            bits = *tree.GetAttrMatchBits(attrName_, foldedVal_, matchRule_, maxDistance_, flags_);
+        }
+    }
+
     string WidgetAttrMatcher::Describe() const
     {
-        auto valueMatcher = ValueMatcher(testVal_, matchRule_);
+        auto valueMatcher = ValueMatcher(testVal_, matchRule_, maxDistance_, flags_);
         return "$" + string(attrName_) + " " + valueMatcher.Describe();
     }
 
@@ -79,14 +214,26 @@ namespace OHOS::uitest {
         data["attr_name"] = attrName_;
         data["test_value"] = testVal_;
         data["match_rule"] = matchRule_;
+        data["max_distance"] = maxDistance_;
+        data["match_flags"] = flags_;
     }
 
     void WidgetAttrMatcher::ReadFromParcel(const json &data)
     {
         attrName_ = data["attr_name"];
         testVal_ = data["test_value"];
-        uint8_t intVal = data["match_rule"];
+        // the parcel comes from the client, so the rule and the distance are checked as the AddMatcher api does
+        uint32_t intVal = data["match_rule"];
+        if (intVal > FUZZY) {
+            LOG_W("Illegal match rule: %{public}u, read as EQ", intVal);
+            intVal = EQ;
+        }
         matchRule_ = static_cast<ValueMatchRule>(intVal);
+        maxDistance_ = matchRule_ == FUZZY ? min(data.value("max_distance", 0u), MAX_FUZZY_DISTANCE) : 0;
+        flags_ = data.value("match_flags", static_cast<uint8_t>(0));
+        foldedVal_ = FoldTestValue(testVal_, matchRule_, flags_);
+        regex_ = GetRegex(foldedVal_, matchRule_);
+        fuzzy_ = GetFuzzy(foldedVal_, matchRule_, maxDistance_);
     }
 
     All::All(const WidgetAttrMatcher &ma, const WidgetAttrMatcher &mb)
@@ -114,6 +261,16 @@ namespace OHOS::uitest {
         return match;
     }
 
+    void All::MatchBits(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        bits = DfsBitset(static_cast<uint32_t>(tree.GetWidgetCount()), true);
+        DfsBitset leafBits;
+        for (auto &matcher : matchers_) {
+            matcher.MatchBits(tree, leafBits);
+            bits.And(leafBits);
+        }
+    }
+
     string All::Describe() const
     {
         stringstream desc;
@@ -142,6 +299,7 @@ namespace OHOS::uitest {
     {
         if (matcher_.Matches(widget)) {
             receiver_.emplace_back(widget);
+            collected_++;
         }
     }
 
@@ -168,6 +326,16 @@ namespace OHOS::uitest {
         return match;
     }
 
+    void Any::MatchBits(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        bits = DfsBitset(static_cast<uint32_t>(tree.GetWidgetCount()));
+        DfsBitset leafBits;
+        for (auto &matcher : matchers_) {
+            matcher.MatchBits(tree, leafBits);
+            bits.Or(leafBits);
+        }
+    }
+
     string Any::Describe() const
     {
         stringstream desc;
@@ -181,4 +349,229 @@ namespace OHOS::uitest {
         }
         return desc.str();
     }
-} // namespace uitest
\ No newline at end of file
+
+    // enough for the decimal text of any int32 value
+    static constexpr size_t INT_TEXT_CAPACITY = 16;
+
+    static bool ResolveAttr(string_view name, UiAttr &attr)
+    {
+        for (uint8_t index = 0; index < sizeof(ATTR_NAMES) / sizeof(ATTR_NAMES[0]); index++) {
+            if (name == ATTR_NAMES[index]) {
+                attr = static_cast<UiAttr>(index);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**Parse the canonical decimal text of int32 value, which equals to the rendered text of the parsed value.*/
+    static bool ParseCanonicalInt(string_view text, int32_t &value)
+    {
+        auto [ptr, ec] = from_chars(text.data(), text.data() + text.length(), value);
+        if (ec != errc() || ptr != text.data() + text.length()) {
+            return false;
+        }
+        char buf[INT_TEXT_CAPACITY];
+        auto result = to_chars(begin(buf), end(buf), value);
+        return string_view(buf, result.ptr - buf) == text;
+    }
+
+    SelectorPlan::SelectorPlan(const vector<WidgetAttrMatcher> &matchers) : fingerprint_(ComputeFingerprint(matchers))
+    {
+        for (auto &matcher : matchers) {
+            Predicate predicate;
+            predicate.attrName_ = matcher.GetAttrName();
+            predicate.rule_ = matcher.GetMatchRule();
+            predicate.flags_ = matcher.GetMatchFlags();
+            predicate.testValue_ = FoldTestValue(matcher.GetTestValue(), predicate.rule_, predicate.flags_);
+            predicate.maxDistance_ = matcher.GetMaxDistance();
+            predicate.regex_ = GetRegex(predicate.testValue_, predicate.rule_);
+            predicate.fuzzy_ = GetFuzzy(predicate.testValue_, predicate.rule_, predicate.maxDistance_);
+            ranked_ = ranked_ || predicate.rule_ == FUZZY;
+            UiAttr attr = UiAttr::ID;
+            if (!ResolveAttr(predicate.attrName_, attr)) {
+                predicate.kind_ = predicate.attrName_ == ATTR_HIERARCHY ? Predicate::GENERIC : Predicate::CUSTOM;
+            } else if (ATTR_TYPES[attr] == BOOL) {
+                predicate.kind_ = Predicate::BOOL;
+                predicate.matchTrue_ = MatchPredicateValue(predicate, "true");
+                predicate.matchFalse_ = MatchPredicateValue(predicate, "false");
+            } else if (ATTR_TYPES[attr] == INT) {
+                const bool eq = predicate.rule_ == EQ && ParseCanonicalInt(predicate.testValue_, predicate.intValue_);
+                predicate.kind_ = eq ? Predicate::ID_EQ : Predicate::ID;
+            } else if (ATTR_TYPES[attr] == STRING) {
+                predicate.kind_ = Predicate::STRING;
+            } else {
+                predicate.kind_ = Predicate::GENERIC;
+            }
+            predicate.attr_ = attr;
+            predicates_.emplace_back(move(predicate));
+        }
+        // cheaper kinds first, then the more selective rules: EQ, STARTS_WITH/ENDS_WITH and CONTAINS
+        stable_sort(predicates_.begin(), predicates_.end(), [](const Predicate &a, const Predicate &b) {
+            if (a.kind_ != b.kind_) {
+                return a.kind_ < b.kind_;
+            }
+            return RULE_RANKS[a.rule_] < RULE_RANKS[b.rule_];
+        });
+    }
+
+    string SelectorPlan::ComputeFingerprint(const vector<WidgetAttrMatcher> &matchers)
+    {
+        // length-prefixed fields, sorted to be independent of the matchers order
+        vector<string> parts;
+        for (auto &matcher : matchers) {
+            stringstream part;
+            part << matcher.GetAttrName().length() << ":" << matcher.GetAttrName() << ",";
+            part << static_cast<uint32_t>(matcher.GetMatchRule()) << ",";
+            if (matcher.GetMatchRule() == FUZZY) {
+                part << matcher.GetMaxDistance() << ",";
+            }
+            if (matcher.GetMatchFlags() != 0) {
+                part << "flags=" << static_cast<uint32_t>(matcher.GetMatchFlags()) << ",";
+            }
+            part << matcher.GetTestValue().length() << ":" << matcher.GetTestValue() << ";";
+            parts.emplace_back(part.str());
+        }
+        sort(parts.begin(), parts.end());
+        string fingerprint;
+        for (auto &part : parts) {
+            fingerprint.append(part);
+        }
+        return fingerprint;
+    }
+
+    shared_ptr<const SelectorPlan> SelectorPlan::Compile(const vector<WidgetAttrMatcher> &matchers)
+    {
+        static constexpr size_t cacheCapacity = 64;
+        static mutex cacheMutex;
+        static unordered_map<string, shared_ptr<const SelectorPlan>> cache;
+        auto fingerprint = ComputeFingerprint(matchers);
+        lock_guard<mutex> guard(cacheMutex);
+        auto find = cache.find(fingerprint);
+        if (find != cache.end()) {
+            return find->second;
+        }
+        if (cache.size() >= cacheCapacity) {
+            cache.clear(); // selectors are mostly reused in a short period, simply start over
+        }
+        auto plan = make_shared<const SelectorPlan>(matchers);
+        cache.emplace(move(fingerprint), plan);
+        return plan;
+    }
+
+    bool SelectorPlan::MatchPredicateValue(const Predicate &predicate, string_view value)
+    {
+        return MatchValue(FoldTestedValue(value, predicate.flags_), predicate.testValue_, predicate.rule_,
+                          predicate.regex_, predicate.fuzzy_);
+    }
+
+    bool SelectorPlan::MatchPredicate(const Predicate &predicate, const Widget &widget)
+    {
+        const auto kind = predicate.kind_;
+        if ((kind == Predicate::ID_EQ || kind == Predicate::ID || kind == Predicate::BOOL ||
+            kind == Predicate::STRING) && widget.HasTypedAttr(predicate.attr_)) {
+            switch (kind) {
+                case Predicate::ID_EQ:
+                    return widget.GetIntAttr(predicate.attr_) == predicate.intValue_;
+                case Predicate::BOOL:
+                    return widget.GetBoolAttr(predicate.attr_) ? predicate.matchTrue_ : predicate.matchFalse_;
+                case Predicate::ID: {
+                    char buf[INT_TEXT_CAPACITY];
+                    auto result = to_chars(begin(buf), end(buf), widget.GetIntAttr(predicate.attr_));
+                    return MatchPredicateValue(predicate, string_view(buf, result.ptr - buf));
+                }
+                default:
+                    return MatchPredicateValue(predicate, widget.GetStrAttr(predicate.attr_));
+            }
+        }
+        string_view value;
+        if (kind == Predicate::GENERIC) {
+            return widget.GetAttrView(predicate.attrName_, g_renderBuffer, value) &&
+                MatchPredicateValue(predicate, value);
+        }
+        // custom attributes, or the builtin ones whose value does not fit the typed slot
+        return widget.GetCustomAttr(predicate.attrName_, value) &&
+            MatchPredicateValue(predicate, value);
+    }
+
+    bool SelectorPlan::Matches(const Widget &widget) const
+    {
+        for (auto &predicate : predicates_) {
+            if (!MatchPredicate(predicate, widget)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t SelectorPlan::GetDistance(const Widget &widget) const
+    {
+        uint32_t distance = 0;
+        for (auto &predicate : predicates_) {
+            string_view value;
+            if (predicate.rule_ == FUZZY && widget.GetAttrView(predicate.attrName_, g_renderBuffer, value)) {
+                distance += predicate.fuzzy_->Distance(FoldTestedValue(value, predicate.flags_));
+            }
+        }
+        return distance;
+    }
+
+    void SelectorPlan::MatchBits(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        const auto count = static_cast<uint32_t>(tree.GetWidgetCount());
+        bits = DfsBitset(count, true);
+        vector<const Predicate *> tested;
+        for (auto &predicate : predicates_) {
+            if (predicate.attrName_ == ATTR_HIERARCHY) {
+                tested.emplace_back(&predicate);
+            } else {
+                bits.And(*tree.GetAttrMatchBits(predicate.attrName_, predicate.testValue_, predicate.rule_,
+                                                predicate.maxDistance_, predicate.flags_));
+            }
+            if (bits.IsEmpty()) {
+                return;
+            }
+        }
+        if (tested.empty()) {
+            return;
+        }
+        DfsBitset rejected(count);
+        bits.ForEach([&tree, &tested, &rejected](uint32_t index) {
+            const auto &widget = tree.GetWidgetByDfsIndex(index);
+            for (auto predicate : tested) {
+                if (!MatchPredicate(*predicate, widget)) {
+                    rejected.Set(index);
+                    break;
+                }
+            }
+        });
+        bits.AndNot(rejected);
+    }
+
+    void SelectorPlan::Select(const WidgetTree &tree, vector<reference_wrapper<const Widget>> &receiver) const
+    {
+        DfsBitset bits;
+        MatchBits(tree, bits);
+        bits.ForEach([&tree, &receiver](uint32_t index) { receiver.emplace_back(tree.GetWidgetByDfsIndex(index)); });
+    }
+
+    string SelectorPlan::Describe() const
+    {
+        stringstream desc;
+        uint32_t index = 0;
+        for (auto &predicate : predicates_) {
+            if (index > 0) {
+                desc << " AND ";
+            }
+            desc << "($" << predicate.attrName_ << " " << GetRuleName(predicate.rule_);
+            desc << " '" << predicate.testValue_ << "'";
+            if (predicate.rule_ == FUZZY) {
+                desc << " within " << predicate.maxDistance_;
+            }
+            desc << DescribeFlags(predicate.flags_);
+            desc << ")";
+            index++;
+        }
+        return desc.str();
+    }
+} // namespace uitest
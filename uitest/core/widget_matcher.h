@@ -19,17 +19,29 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <memory>
+#include "edit_distance.h"
+#include "regex_automaton.h"
 #include "ui_model.h"
 #include "extern_api.h"
 
 namespace OHOS::uitest {
+    // upper bound of the max edit distance of the FUZZY rule, larger distances match almost anything
+    constexpr uint32_t MAX_FUZZY_DISTANCE = 64;
+
     /** get the readable name of the ValueMatchRule value.*/
     std::string GetRuleName(ValueMatchRule rule);
 
+    /**Test the value against the test value with the given rule, without allocation. The REGEX and FUZZY test values
+     * are compiled on first use and cached by pattern. The max edit distance applies to the FUZZY rule only.*/
+    bool MatchValue(std::string_view testedValue, std::string_view testValue, ValueMatchRule rule,
+                    uint32_t maxDistance = 0);
+
     class ValueMatcher {
     public:
-        explicit ValueMatcher(std::string testValue, ValueMatchRule rule = EQ)
-            : testValue_(std::move(testValue)), rule_(rule) {}
+        /**Create the matcher, the values are folded by the ValueMatchFlag bits before matching.*/
+        explicit ValueMatcher(std::string testValue, ValueMatchRule rule = EQ, uint32_t maxDistance = 0,
+                              uint8_t flags = 0);
 
         virtual ~ValueMatcher() {}
 
@@ -40,6 +52,14 @@ namespace OHOS::uitest {
     private:
         const std::string testValue_;
         const ValueMatchRule rule_;
+        const uint32_t maxDistance_;
+        const uint8_t flags_;
+        // the test value folded by the flags, which the values are matched against
+        const std::string foldedValue_;
+        // the compiled automaton of the REGEX test value
+        const std::shared_ptr<const RegexAutomaton> regex_;
+        // the compiled pattern of the FUZZY test value
+        const std::shared_ptr<const EditDistancePattern> fuzzy_;
     };
 
     /**Base type of all widget matchers, test on a single Widget and returns true if it's
@@ -49,6 +69,9 @@ namespace OHOS::uitest {
         virtual bool Matches(const Widget &widget) const = 0;
 
         virtual std::string Describe() const = 0;
+
+        /**Compute the set of the matched widgets on the tree, which tests each widget by default.*/
+        virtual void MatchBits(const WidgetTree &tree, DfsBitset &bits) const;
     };
 
     /**match the root widget node.*/
@@ -66,20 +89,62 @@ namespace OHOS::uitest {
     public:
         WidgetAttrMatcher() = delete;
 
-        explicit WidgetAttrMatcher(std::string_view attr, std::string_view testValue, ValueMatchRule rule);
+        /**
+         * Create the matcher, the max edit distance applies to the FUZZY rule only and is 0 for the others. With the
+         * ValueMatchFlag bits, the attribute value and the test value are folded before matching. The escaped
+         * characters of a REGEX pattern are not folded, nor are its whitespaces normalized.
+         * */
+        explicit WidgetAttrMatcher(std::string_view attr, std::string_view testValue, ValueMatchRule rule,
+                                   uint32_t maxDistance = 0, uint8_t flags = 0);
 
         bool Matches(const Widget &widget) const override;
 
         std::string Describe() const override;
 
+        /**Get the cached match set of this predicate from the tree, the hierarchy attribute is tested per widget.*/
+        void MatchBits(const WidgetTree &tree, DfsBitset &bits) const override;
+
         void WriteIntoParcel(nlohmann::json &data) const override;
 
         void ReadFromParcel(const nlohmann::json &data) override;
 
+        const std::string &GetAttrName() const
+        {
+            return attrName_;
+        }
+
+        const std::string &GetTestValue() const
+        {
+            return testVal_;
+        }
+
+        ValueMatchRule GetMatchRule() const
+        {
+            return matchRule_;
+        }
+
+        uint32_t GetMaxDistance() const
+        {
+            return maxDistance_;
+        }
+
+        uint8_t GetMatchFlags() const
+        {
+            return flags_;
+        }
+
     private:
         std::string attrName_;
         std::string testVal_;
         ValueMatchRule matchRule_;
+        uint32_t maxDistance_ = 0;
+        uint8_t flags_ = 0;
+        // the test value folded by the flags, which the attribute values are matched against
+        std::string foldedVal_;
+        // the compiled automaton of the REGEX test value, shared by the matchers of the same pattern
+        std::shared_ptr<const RegexAutomaton> regex_;
+        // the compiled pattern of the FUZZY test value, shared by the matchers of the same pattern and distance
+        std::shared_ptr<const EditDistancePattern> fuzzy_;
     };
 
     /**
@@ -104,6 +169,9 @@ namespace OHOS::uitest {
 
         std::string Describe() const override;
 
+        /**Intersect the match sets of the leaf matchers.*/
+        void MatchBits(const WidgetTree &tree, DfsBitset &bits) const override;
+
     private:
         // hold the leaf matchers
         std::vector<WidgetAttrMatcher> matchers_;
@@ -131,27 +199,113 @@ namespace OHOS::uitest {
 
         std::string Describe() const override;
 
+        /**Unite the match sets of the leaf matchers.*/
+        void MatchBits(const WidgetTree &tree, DfsBitset &bits) const override;
+
     private:
         // hold the leaf matchers
         std::vector<WidgetAttrMatcher> matchers_;
     };
 
+    /**
+     * Immutable plan compiled from the attribute matchers of a selector, which matches the same widgets as
+     * <code>All</code> of them. The predicates are ordered by estimated cost and selectivity: id equality and bool
+     * bits first, then the typed string slots, and the generic attributes last. Matching does not allocate.
+     * */
+    class SelectorPlan final : public WidgetMatcher {
+    public:
+        explicit SelectorPlan(const std::vector<WidgetAttrMatcher> &matchers);
+
+        /**
+         * Get the compiled plan of the matchers, the plans are cached by fingerprint and shared.
+         * */
+        static std::shared_ptr<const SelectorPlan> Compile(const std::vector<WidgetAttrMatcher> &matchers);
+
+        /**Compute the fingerprint of the matchers, which does not depend on the matchers order.*/
+        static std::string ComputeFingerprint(const std::vector<WidgetAttrMatcher> &matchers);
+
+        bool Matches(const Widget &widget) const override;
+
+        /**
+         * Intersect the match sets of the predicates, which are computed from the attribute indexes and cached on the
+         * tree. The hierarchy predicates are tested on the remaining candidates only.
+         * */
+        void MatchBits(const WidgetTree &tree, DfsBitset &bits) const override;
+
+        /**Collect the matched widgets on the tree in dfs order, by enumerating the match set.*/
+        void Select(const WidgetTree &tree, std::vector<std::reference_wrapper<const Widget>> &receiver) const;
+
+        /**Describe the predicates in evaluation order.*/
+        std::string Describe() const override;
+
+        const std::string &GetFingerprint() const
+        {
+            return fingerprint_;
+        }
+
+        /**Check if the matched widgets are ranked by edit distance, which is the case with FUZZY predicates.*/
+        bool IsRanked() const
+        {
+            return ranked_;
+        }
+
+        /**Get the sum of the edit distances of the widget to the FUZZY predicates, the widget must be matched.*/
+        uint32_t GetDistance(const Widget &widget) const;
+
+    private:
+        /**Compiled predicate of an attribute matcher, the kinds are declared in evaluation order.*/
+        struct Predicate {
+            enum Kind : uint8_t { ID_EQ, BOOL, ID, STRING, CUSTOM, GENERIC };
+            Kind kind_ = GENERIC;
+            UiAttr attr_ = UiAttr::ID;
+            ValueMatchRule rule_ = EQ;
+            std::string attrName_;
+            std::string testValue_;
+            int32_t intValue_ = 0;
+            uint32_t maxDistance_ = 0;
+            uint8_t flags_ = 0;
+            std::shared_ptr<const RegexAutomaton> regex_;
+            std::shared_ptr<const EditDistancePattern> fuzzy_;
+            // match results of the bool attribute values
+            bool matchTrue_ = false;
+            bool matchFalse_ = false;
+        };
+
+        /**Match the value against the predicate, after folding it by the predicate flags.*/
+        static bool MatchPredicateValue(const Predicate &predicate, std::string_view value);
+
+        static bool MatchPredicate(const Predicate &predicate, const Widget &widget);
+
+        std::vector<Predicate> predicates_;
+        std::string fingerprint_;
+        bool ranked_ = false;
+    };
+
     /**
     * Common helper visitor to find and collect matched Widget nodes by WidgetMatcher. Matcher widgets are
      * arranged in the given receiver container in visiting order.
     * */
     class MatchedWidgetCollector : public WidgetVisitor {
     public:
-        MatchedWidgetCollector(const WidgetMatcher &matcher, std::vector<std::reference_wrapper<const Widget>> &recv)
-            : matcher_(matcher), receiver_(recv) {}
+        /**Create collector which collects at most <code>limit</code> widgets, 0 for no limit.*/
+        MatchedWidgetCollector(const WidgetMatcher &matcher, std::vector<std::reference_wrapper<const Widget>> &recv,
+                               size_t limit = 0)
+            : matcher_(matcher), receiver_(recv), limit_(limit) {}
 
         ~MatchedWidgetCollector() {}
 
         void Visit(const Widget &widget) override;
 
+        bool IsSatisfied() const override
+        {
+            return limit_ > 0 && collected_ >= limit_;
+        }
+
     private:
         const WidgetMatcher &matcher_;
         std::vector<std::reference_wrapper<const Widget>> &receiver_;
+        const size_t limit_;
+        size_t collected_ = 0;
     };
 } // namespace uitest
 
@@ -13,88 +13,457 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include "widget_selector.h"
 
 namespace OHOS::uitest {
     using namespace std;
     using namespace nlohmann;
 
+    // max distance in pixels between the bounds of the widget near the locator widget and the locator widget
+    static constexpr int32_t NEAR_DISTANCE = 50;
+    // capacity of the selection result cache, in results and in the dfs indexes held by all the results
+    static constexpr size_t SELECTION_CACHE_CAPACITY = 256;
+    static constexpr size_t SELECTION_CACHE_MAX_INDEXES = 64 * 1024;
     static constexpr auto NEST_USAGE_ERROR = "Nesting By usage like 'BY.before(BY.after(...))' is not supported";
 
     void WidgetSelector::AddMatcher(const WidgetAttrMatcher &matcher)
     {
         selfMatchers_.emplace_back(matcher);
+        plan_ = nullptr;
+        fingerprint_.clear();
+    }
+
+    const SelectorPlan &WidgetSelector::GetPlan() const
+    {
+        if (plan_ == nullptr) {
+            plan_ = SelectorPlan::Compile(selfMatchers_);
+        }
+        return *plan_;
+    }
+
+    const string &WidgetSelector::GetFingerprint() const
+    {
+        if (!fingerprint_.empty()) {
+            return fingerprint_;
+        }
+        // length-prefixed sections, tagged by the locator kinds; the self section is never empty, so an empty
+        // fingerprint means not computed
+        static constexpr auto appendSection = [](string &out, char tag, const string &section) {
+            out.append(1, tag).append(to_string(section.length())).append(1, ':').append(section);
+        };
+        string fingerprint;
+        appendSection(fingerprint, 's', GetPlan().GetFingerprint());
+        static constexpr auto appendLocators = [](string &out, char tag, const vector<WidgetSelector> &list) {
+            for (auto &locator : list) {
+                appendSection(out, tag, locator.GetFingerprint());
+            }
+        };
+        appendLocators(fingerprint, 'f', frontLocators_);
+        appendLocators(fingerprint, 'r', rearLocators_);
+        appendLocators(fingerprint, 'a', ancestorLocators_);
+        appendLocators(fingerprint, 'c', childLocators_);
+        appendLocators(fingerprint, 'd', descendantLocators_);
+        for (auto &[relation, locator] : geometricLocators_) {
+            appendSection(fingerprint, static_cast<char>('0' + relation), locator.GetFingerprint());
+        }
+        fingerprint_ = move(fingerprint);
+        return fingerprint_;
+    }
+
+    /**
+     * Process-wide LRU cache of the selection results, keyed by the tree generation, the selection limit and the
+     * selector fingerprint. A tree is immutable once constructed and its generation is never reused, so the cached
+     * results never go stale, those of the replaced snapshots simply age out.
+     * */
+    class SelectionCache {
+    public:
+        static SelectionCache &GetInstance()
+        {
+            static SelectionCache instance;
+            return instance;
+        }
+
+        /**Get the cached dfs indexes into the receiver, and mark them the most recently used.*/
+        bool Lookup(const string &key, vector<uint32_t> &receiver)
+        {
+            lock_guard<mutex> guard(mutex_);
+            auto find = entries_.find(key);
+            if (find == entries_.end()) {
+                stats_.misses_++;
+                return false;
+            }
+            stats_.hits_++;
+            lru_.splice(lru_.begin(), lru_, find->second);
+            receiver = find->second->indexes_;
+            return true;
+        }
+
+        void Store(string key, const vector<uint32_t> &indexes)
+        {
+            if (indexes.size() > SELECTION_CACHE_MAX_INDEXES) {
+                return;
+            }
+            lock_guard<mutex> guard(mutex_);
+            if (entries_.find(key) != entries_.end()) {
+                return; // stored by a concurrent selection meanwhile
+            }
+            lru_.push_front(Entry {move(key), indexes});
+            entries_.emplace(lru_.front().key_, lru_.begin());
+            indexCount_ += indexes.size();
+            while (lru_.size() > SELECTION_CACHE_CAPACITY || indexCount_ > SELECTION_CACHE_MAX_INDEXES) {
+                auto &victim = lru_.back();
+                indexCount_ -= victim.indexes_.size();
+                entries_.erase(victim.key_);
+                lru_.pop_back();
+                stats_.evictions_++;
+            }
+        }
+
+        SelectionCacheStats GetStats()
+        {
+            lock_guard<mutex> guard(mutex_);
+            auto stats = stats_;
+            stats.size_ = lru_.size();
+            return stats;
+        }
+
+        void Reset()
+        {
+            lock_guard<mutex> guard(mutex_);
+            entries_.clear();
+            lru_.clear();
+            indexCount_ = 0;
+            stats_ = SelectionCacheStats();
+        }
+
+    private:
+        struct Entry {
+            string key_;
+            vector<uint32_t> indexes_;
+        };
+
+        mutex mutex_;
+        // most recently used first, the map keys view the keys held by the list nodes, which never move
+        list<Entry> lru_;
+        unordered_map<string_view, list<Entry>::iterator> entries_;
+        size_t indexCount_ = 0;
+        SelectionCacheStats stats_;
+    };
+
+    SelectionCacheStats WidgetSelector::GetSelectionCacheStats()
+    {
+        return SelectionCache::GetInstance().GetStats();
+    }
+
+    void WidgetSelector::ResetSelectionCache()
+    {
+        SelectionCache::GetInstance().Reset();
+    }
+
+    bool WidgetSelector::HasLocators() const
+    {
+        return !frontLocators_.empty() || !rearLocators_.empty() || !ancestorLocators_.empty() ||
+            !childLocators_.empty() || !descendantLocators_.empty() || !geometricLocators_.empty();
     }
 
     void WidgetSelector::AddFrontLocator(const WidgetSelector &selector, ApiCallErr &error)
     {
-        if (!selector.rearLocators_.empty() || !selector.rearLocators_.empty()) {
+        if (selector.HasLocators()) {
             error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
             return;
         }
         frontLocators_.emplace_back(selector);
+        fingerprint_.clear();
     }
 
     void WidgetSelector::AddRearLocator(const WidgetSelector &selector, ApiCallErr &error)
     {
-        if (!selector.rearLocators_.empty() || !selector.rearLocators_.empty()) {
+        if (selector.HasLocators()) {
             error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
             return;
         }
         rearLocators_.emplace_back(selector);
+        fingerprint_.clear();
     }
 
-    static bool CheckHasLocator(const WidgetTree &tree, const Widget &widget, const WidgetMatcher &matcher, bool front)
+    void WidgetSelector::AddAncestorLocator(const WidgetSelector &selector, ApiCallErr &error)
     {
-        vector<reference_wrapper<const Widget>> locators;
-        locators.clear();
-        MatchedWidgetCollector collector(matcher, locators);
-        if (front) {
-            tree.DfsTraverseFronts(collector, widget);
-        } else {
-            tree.DfsTraverseRears(collector, widget);
+        if (selector.HasLocators()) {
+            error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
+            return;
         }
-        return !locators.empty();
+        ancestorLocators_.emplace_back(selector);
+        fingerprint_.clear();
     }
 
-    void WidgetSelector::Select(const WidgetTree &tree, vector<std::reference_wrapper<const Widget>> &results) const
+    void WidgetSelector::AddChildLocator(const WidgetSelector &selector, ApiCallErr &error)
     {
-        auto allSelfMatcher = All(selfMatchers_);
-        MatchedWidgetCollector selfCollector(allSelfMatcher, results);
-        tree.DfsTraverse(selfCollector);
-        if (results.empty()) {
-            LOG_W("Self node not found matching:%{public}s", allSelfMatcher.Describe().c_str());
+        if (selector.HasLocators()) {
+            error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
+            return;
+        }
+        childLocators_.emplace_back(selector);
+        fingerprint_.clear();
+    }
+
+    void WidgetSelector::AddDescendantLocator(const WidgetSelector &selector, ApiCallErr &error)
+    {
+        if (selector.HasLocators()) {
+            error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
+            return;
+        }
+        descendantLocators_.emplace_back(selector);
+        fingerprint_.clear();
+    }
+
+    void WidgetSelector::AddGeometricLocator(const WidgetSelector &selector, GeometricRelation relation,
+                                             ApiCallErr &error)
+    {
+        if (relation > NEAR) {
+            error = ApiCallErr(USAGE_ERROR, "Illegal geometric relation: " + to_string(relation));
+            return;
+        }
+        if (selector.HasLocators()) {
+            error = ApiCallErr(USAGE_ERROR, NEST_USAGE_ERROR);
             return;
         }
+        geometricLocators_.emplace_back(relation, selector);
+        fingerprint_.clear();
+    }
+
+    bool WidgetSelector::FindLocatorsBound(const WidgetTree &tree, const vector<WidgetSelector> &locators, bool front,
+                                           uint32_t &bound)
+    {
+        // a widget has all the front locators before it iff it's after the first match of each of them, so the bound
+        // is the max first match index; likewise the rear bound is the min last match index
+        DfsBitset bits;
+        bound = front ? 0 : static_cast<uint32_t>(tree.GetWidgetCount());
+        for (auto &locator : locators) {
+            locator.GetPlan().MatchBits(tree, bits);
+            uint32_t index = 0;
+            if (!(front ? bits.FindFirst(index) : bits.FindLast(index))) {
+                return false;
+            }
+            bound = front ? max(bound, index) : min(bound, index);
+        }
+        return true;
+    }
+
+    void WidgetSelector::ApplyStructuralLocators(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        const auto count = static_cast<uint32_t>(tree.GetWidgetCount());
+        DfsBitset locatorBits;
+        for (auto &locator : ancestorLocators_) {
+            locator.GetPlan().MatchBits(tree, locatorBits);
+            DfsBitset within(count);
+            // the interval of a locator after another one's is either nested in it or disjoint, skip the nested
+            uint32_t coveredEnd = 0;
+            locatorBits.ForEach([&tree, &within, &coveredEnd](uint32_t index) {
+                if (index < coveredEnd) {
+                    return;
+                }
+                uint32_t enter = 0;
+                tree.GetDfsInterval(tree.GetWidgetByDfsIndex(index), enter, coveredEnd);
+                within.SetRange(enter + 1, coveredEnd);
+            });
+            bits.And(within);
+        }
+        for (auto &locator : childLocators_) {
+            locator.GetPlan().MatchBits(tree, locatorBits);
+            DfsBitset parents(count);
+            locatorBits.ForEach([&tree, &parents](uint32_t index) {
+                if (auto parent = tree.GetParentWidget(tree.GetWidgetByDfsIndex(index)); parent != nullptr) {
+                    parents.Set(tree.GetDfsIndex(*parent));
+                }
+            });
+            bits.And(parents);
+        }
+        for (auto &locator : descendantLocators_) {
+            locator.GetPlan().MatchBits(tree, locatorBits);
+            DfsBitset ancestors(count);
+            locatorBits.ForEach([&tree, &ancestors](uint32_t index) {
+                // the ancestors of a marked widget are marked already, stop there
+                auto parent = tree.GetParentWidget(tree.GetWidgetByDfsIndex(index));
+                while (parent != nullptr && !ancestors.Test(tree.GetDfsIndex(*parent))) {
+                    ancestors.Set(tree.GetDfsIndex(*parent));
+                    parent = tree.GetParentWidget(*parent);
+                }
+            });
+            bits.And(ancestors);
+        }
+    }
 
-        vector<uint32_t> discardWidgetOffsets;
-        uint32_t offset = 0;
-        // check locators at each direction and filter out unsatisfied widgets
-        for (size_t idx = 0; idx < INDEX_TWO; idx++) {
-            discardWidgetOffsets.clear();
-            offset = 0;
-            for (auto &result:results) {
-                const bool front = idx == 0;
-                const auto &locators = front ? frontLocators_ : rearLocators_;
-                for (auto &locator:locators) {
-                    auto locatorMatcher = All(locator.selfMatchers_);
-                    if (!CheckHasLocator(tree, result.get(), locatorMatcher, front)) {
-                        // this means not all the required front locator are found, exclude this candidate
-                        discardWidgetOffsets.emplace_back(offset);
-                        break;
+    /**Get the area where the widgets in the relation to the locator bounds overlap.*/
+    static Rect GetRelationArea(const Rect &locator, GeometricRelation relation)
+    {
+        static constexpr auto minPos = numeric_limits<int32_t>::min();
+        static constexpr auto maxPos = numeric_limits<int32_t>::max();
+        switch (relation) {
+            case LEFT_OF:
+                return Rect(minPos, locator.left_, locator.top_, locator.bottom_);
+            case RIGHT_OF:
+                return Rect(locator.right_, maxPos, locator.top_, locator.bottom_);
+            case ABOVE:
+                return Rect(locator.left_, locator.right_, minPos, locator.top_);
+            case BELOW:
+                return Rect(locator.left_, locator.right_, locator.bottom_, maxPos);
+            default: {
+                // the overlapping must be positive, extend one more pixel to include the widgets at the distance
+                const auto extent = NEAR_DISTANCE + 1;
+                return Rect(locator.left_ - extent, locator.right_ + extent, locator.top_ - extent,
+                            locator.bottom_ + extent);
+            }
+        }
+    }
+
+    /**Check if the bounds in the relation area are in the relation to the locator bounds.*/
+    static bool IsInRelation(const Rect &bounds, const Rect &locator, GeometricRelation relation)
+    {
+        switch (relation) {
+            case LEFT_OF:
+                return bounds.right_ <= locator.left_;
+            case RIGHT_OF:
+                return bounds.left_ >= locator.right_;
+            case ABOVE:
+                return bounds.bottom_ <= locator.top_;
+            case BELOW:
+                return bounds.top_ >= locator.bottom_;
+            default: {
+                const int64_t dx = max({0, locator.left_ - bounds.right_, bounds.left_ - locator.right_});
+                const int64_t dy = max({0, locator.top_ - bounds.bottom_, bounds.top_ - locator.bottom_});
+                return dx * dx + dy * dy <= int64_t(NEAR_DISTANCE) * NEAR_DISTANCE;
+            }
+        }
+    }
+
+    void WidgetSelector::ApplyGeometricLocators(const WidgetTree &tree, DfsBitset &bits) const
+    {
+        const auto &spatialIndex = tree.GetSpatialIndex();
+        DfsBitset locatorBits;
+        vector<uint32_t> ids;
+        for (auto &[relation, locator] : geometricLocators_) {
+            locator.GetPlan().MatchBits(tree, locatorBits);
+            DfsBitset related(static_cast<uint32_t>(tree.GetWidgetCount()));
+            locatorBits.ForEach([&tree, &spatialIndex, &related, &ids, relation = relation](uint32_t index) {
+                const auto &locatorWidget = tree.GetWidgetByDfsIndex(index);
+                const auto bounds = locatorWidget.GetBounds();
+                ids.clear();
+                spatialIndex.QueryRect(GetRelationArea(bounds, relation), ids);
+                for (auto id : ids) {
+                    const auto &widget = tree.GetWidgetByDfsIndex(id);
+                    if (id == index || !IsInRelation(widget.GetBounds(), bounds, relation)) {
+                        continue;
+                    }
+                    // the containers and the contents of the locator overlap it, which are not near to it
+                    if (relation == NEAR && (tree.IsDescendantOf(widget, locatorWidget) ||
+                        tree.IsDescendantOf(locatorWidget, widget))) {
+                        continue;
                     }
+                    related.Set(id);
                 }
-                offset++;
+            });
+            bits.And(related);
+        }
+    }
+
+    void WidgetSelector::Select(const WidgetTree &tree, vector<std::reference_wrapper<const Widget>> &results,
+                                size_t limit) const
+    {
+        const auto generation = tree.GetGeneration();
+        if (generation == 0) {
+            // the tree is not constructed, nothing to select
+            return;
+        }
+        auto &cache = SelectionCache::GetInstance();
+        vector<uint32_t> indexes;
+        auto key = to_string(generation).append(1, ':').append(to_string(limit)).append(1, ':');
+        key.append(GetFingerprint());
+        if (!cache.Lookup(key, indexes)) {
+            SelectIndexes(tree, indexes, limit);
+            cache.Store(move(key), indexes);
+        }
+        for (auto index : indexes) {
+            results.emplace_back(tree.GetWidgetByDfsIndex(index));
+        }
+    }
+
+    void WidgetSelector::SelectIndexes(const WidgetTree &tree, vector<uint32_t> &indexes, size_t limit) const
+    {
+        const auto &selfPlan = GetPlan();
+        const bool structural = !ancestorLocators_.empty() || !childLocators_.empty() || !descendantLocators_.empty();
+        if (limit > 0 && rearLocators_.empty() && !structural && geometricLocators_.empty() && !selfPlan.IsRanked()) {
+            // no rear locator needs the rest of the tree, find the first matches in one forward pass which stops once
+            // the limit is reached: test the pending front locators until all are found, then the candidates after
+            vector<const SelectorPlan *> pending;
+            for (auto &locator : frontLocators_) {
+                pending.emplace_back(&locator.GetPlan());
             }
-            // remove unsatisfied candidates, remove from last to first
-            reverse(discardWidgetOffsets.begin(), discardWidgetOffsets.end());
-            for (auto &off:discardWidgetOffsets) {
-                results.erase(results.begin() + off);
+            size_t collected = 0;
+            const auto count = tree.GetWidgetCount();
+            for (uint32_t index = 0; index < count && collected < limit; index++) {
+                const auto &widget = tree.GetWidgetByDfsIndex(index);
+                if (!pending.empty()) {
+                    auto matched = [&widget](const SelectorPlan *plan) { return plan->Matches(widget); };
+                    pending.erase(remove_if(pending.begin(), pending.end(), matched), pending.end());
+                } else if (selfPlan.Matches(widget)) {
+                    indexes.emplace_back(index);
+                    collected++;
+                }
             }
-            if (results.empty()) {
-                break;
+            return;
+        }
+        DfsBitset bits;
+        selfPlan.MatchBits(tree, bits);
+        if (bits.IsEmpty()) {
+            LOG_W("Self node not found matching:%{public}s", selfPlan.Describe().c_str());
+            return;
+        }
+        // candidates must be in the dfs index range [from, to) required by the locators
+        uint32_t from = 0;
+        uint32_t to = static_cast<uint32_t>(tree.GetWidgetCount());
+        uint32_t bound = 0;
+        if (!frontLocators_.empty()) {
+            if (!FindLocatorsBound(tree, frontLocators_, true, bound)) {
+                return;
             }
+            from = bound + 1;
         }
+        if (!rearLocators_.empty()) {
+            if (!FindLocatorsBound(tree, rearLocators_, false, bound)) {
+                return;
+            }
+            to = bound;
+        }
+        bits.KeepRange(from, to);
+        if (structural) {
+            ApplyStructuralLocators(tree, bits);
+        }
+        if (!geometricLocators_.empty()) {
+            ApplyGeometricLocators(tree, bits);
+        }
+        if (selfPlan.IsRanked()) {
+            // best matches first: ascending edit distance, then dfs order
+            vector<pair<uint32_t, uint32_t>> ranked;
+            bits.ForEach([&tree, &selfPlan, &ranked](uint32_t index) {
+                ranked.emplace_back(selfPlan.GetDistance(tree.GetWidgetByDfsIndex(index)), index);
+            });
+            sort(ranked.begin(), ranked.end());
+            const auto count = limit == 0 ? ranked.size() : min(limit, ranked.size());
+            for (size_t index = 0; index < count; index++) {
+                indexes.emplace_back(ranked[index].second);
+            }
+            return;
+        }
+        bits.ForEach([&indexes, limit](uint32_t index) {
+            if (limit == 0 || indexes.size() < limit) {
+                indexes.emplace_back(index);
+            }
+        });
     }
 
     string WidgetSelector::Describe() const
@@ -115,6 +484,31 @@ namespace OHOS::uitest {
                 ss << "[" << locator.Describe() << "]";
             }
         }
+        if (!ancestorLocators_.empty()) {
+            ss << "; ancestorMatcher=";
+            for (auto &locator:ancestorLocators_) {
+                ss << "[" << locator.Describe() << "]";
+            }
+        }
+        if (!childLocators_.empty()) {
+            ss << "; childMatcher=";
+            for (auto &locator:childLocators_) {
+                ss << "[" << locator.Describe() << "]";
+            }
+        }
+        if (!descendantLocators_.empty()) {
+            ss << "; descendantMatcher=";
+            for (auto &locator:descendantLocators_) {
+                ss << "[" << locator.Describe() << "]";
+            }
+        }
+        if (!geometricLocators_.empty()) {
+            static constexpr const char *relationNames[] = {"leftOf", "rightOf", "above", "below", "near"};
+            ss << "; geometricMatcher=";
+            for (auto &[relation, locator]:geometricLocators_) {
+                ss << "[" << relationNames[relation] << locator.Describe() << "]";
+            }
+        }
         ss << "}";
         return ss.str();
     }
@@ -148,6 +542,28 @@ namespace OHOS::uitest {
             rearLocatorJsonList.push_back(matcherSerialized);
         }
         data["rear"] = rearLocatorJsonList;
+        // the structural locators are written only if present, to keep the parcel compatible with the old readers
+        static constexpr auto writeLocators = [](const vector<WidgetSelector> &locators, json &list) {
+            for (auto &locator : locators) {
+                json matcherSerialized;
+                locator.WriteIntoParcel(matcherSerialized);
+                list.push_back(matcherSerialized);
+            }
+        };
+        if (!ancestorLocators_.empty()) {
+            writeLocators(ancestorLocators_, data["within"]);
+        }
+        if (!childLocators_.empty()) {
+            writeLocators(childLocators_, data["hasChild"]);
+        }
+        if (!descendantLocators_.empty()) {
+            writeLocators(descendantLocators_, data["hasDescendant"]);
+        }
+        for (auto &[relation, locator] : geometricLocators_) {
+            json matcherSerialized;
+            locator.WriteIntoParcel(matcherSerialized);
+            data["geometric"].push_back(json::array({relation, matcherSerialized}));
+        }
     }
 
     void WidgetSelector::ReadFromParcel(const json &data)
@@ -158,6 +574,8 @@ namespace OHOS::uitest {
             matcher.ReadFromParcel(selfMatcherJson);
             selfMatchers_.emplace_back(matcher);
         }
+        plan_ = nullptr;
+        fingerprint_.clear();
 
         json frontLocatorJsonList = data["front"];
         for (auto &frontLocatorJson:frontLocatorJsonList) {
@@ -172,5 +590,31 @@ namespace OHOS::uitest {
             locator.ReadFromParcel(rearLocatorJson);
             rearLocators_.emplace_back(locator);
         }
+
+        static constexpr auto readLocators = [](const json &parcel, const char *key, vector<WidgetSelector> &locators) {
+            if (!parcel.contains(key)) {
+                return;
+            }
+            for (auto &locatorJson : parcel[key]) {
+                auto locator = WidgetSelector();
+                locator.ReadFromParcel(locatorJson);
+                locators.emplace_back(locator);
+            }
+        };
+        readLocators(data, "within", ancestorLocators_);
+        readLocators(data, "hasChild", childLocators_);
+        readLocators(data, "hasDescendant", descendantLocators_);
+        if (data.contains("geometric")) {
+            for (auto &item : data["geometric"]) {
+                const auto relation = item[0].get<uint32_t>();
+                if (relation > NEAR) {
+                    LOG_W("Illegal geometric relation: %{public}u", relation);
+                    continue;
+                }
+                auto locator = WidgetSelector();
+                locator.ReadFromParcel(item[1]);
+                geometricLocators_.emplace_back(static_cast<GeometricRelation>(relation), locator);
+            }
+        }
     }
 }
\ No newline at end of file
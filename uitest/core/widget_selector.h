@@ -20,6 +20,22 @@
 #include "widget_matcher.h"
 
 namespace OHOS::uitest {
+    /**Counters of the process-wide selection result cache.*/
+    struct SelectionCacheStats {
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+        uint64_t evictions_ = 0;
+        // count of the cached results
+        size_t size_ = 0;
+
+        /**Get the ratio of the lookups served from the cache, 0 if there was no lookup.*/
+        double GetHitRate() const
+        {
+            const auto lookups = hits_ + misses_;
+            return lookups == 0 ? 0.0 : static_cast<double>(hits_) / static_cast<double>(lookups);
+        }
+    };
+
     /**
      * Selector that searches Widgets on the given WidgetTree according to the matchers
      * of the target widget and its adjacent (front/rear/ancestor/descendant) widgets.
@@ -39,9 +55,41 @@ namespace OHOS::uitest {
         /**Add a selector as the rear locator widget requirement.*/
         void AddRearLocator(const WidgetSelector &selector, ApiCallErr &error);
 
-        /**Select all the matched widgets on the given tree. Results are arranged in the
-         * receiver in <b>DFS</b> order. */
-        void Select(const WidgetTree &tree, std::vector<std::reference_wrapper<const Widget>> &results) const;
+        /**Add a selector as the ancestor locator widget requirement, the target widget must be within it.*/
+        void AddAncestorLocator(const WidgetSelector &selector, ApiCallErr &error);
+
+        /**Add a selector as the child locator widget requirement, the target widget must have such a child.*/
+        void AddChildLocator(const WidgetSelector &selector, ApiCallErr &error);
+
+        /**Add a selector as the descendant locator widget requirement, the target widget must have such a descendant.*/
+        void AddDescendantLocator(const WidgetSelector &selector, ApiCallErr &error);
+
+        /**
+         * Add a selector as the geometric locator widget requirement, the target widget must be in the relation to
+         * any widget the selector matches, by their bounds on the tree. The leftOf/rightOf targets must share rows
+         * with the locator, the above/below targets must share columns, the near targets are within 50 pixels and are
+         * neither the ancestors nor the descendants of the locator.
+         * */
+        void AddGeometricLocator(const WidgetSelector &selector, GeometricRelation relation, ApiCallErr &error);
+
+        /**Select the matched widgets on the given tree, at most <code>limit</code> ones (0 for all). Results are
+         * arranged in the receiver in <b>DFS</b> order, or by ascending edit distance with FUZZY matchers. The
+         * results are memoized by the tree generation and the selector fingerprint in a process-wide LRU cache,
+         * so repeating a query on an unchanged snapshot is a lookup. */
+        void Select(const WidgetTree &tree, std::vector<std::reference_wrapper<const Widget>> &results,
+                    size_t limit = 0) const;
+
+        /**
+         * Get the fingerprint of this selector, covering the self matchers and all the locators with their relations.
+         * The selectors of the same fingerprint select the same widgets on any tree.
+         * */
+        const std::string &GetFingerprint() const;
+
+        /**Get the counters of the process-wide selection result cache.*/
+        static SelectionCacheStats GetSelectionCacheStats();
+
+        /**Drop all the cached selection results and reset the counters.*/
+        static void ResetSelectionCache();
 
         /**Returns a description of this selector.*/
         std::string Describe() const;
@@ -51,9 +99,42 @@ namespace OHOS::uitest {
         void ReadFromParcel(const nlohmann::json &data) override;
 
     private:
+        /**Check if this selector has any locator, the selectors with locators cannot be nested as locators.*/
+        bool HasLocators() const;
+
+        /**Get the compiled plan of the self matchers, which is compiled on first use.*/
+        const SelectorPlan &GetPlan() const;
+
+        /**Select the dfs indexes of the matched widgets on the given tree, the uncached path of <code>Select</code>.*/
+        void SelectIndexes(const WidgetTree &tree, std::vector<uint32_t> &indexes, size_t limit) const;
+
+        /**
+         * Find the dfs index bound which the candidates must be after (front) or before (rear), from the first/last
+         * member of the match sets of the locators. Returns false if any locator is not found.
+         * */
+        static bool FindLocatorsBound(const WidgetTree &tree, const std::vector<WidgetSelector> &locators,
+                                      bool front, uint32_t &bound);
+
+        /**
+         * Keep the candidates satisfying the ancestor/child/descendant locators. The dfs intervals of the widgets
+         * are nested or disjoint, so the widgets within the locators are the union of their intervals, and the
+         * widgets having the locators are found by walking up from them, each widget is visited once per locator.
+         * */
+        void ApplyStructuralLocators(const WidgetTree &tree, DfsBitset &bits) const;
+
+        /**Keep the candidates in the relations to the geometric locators, found on the spatial index of the tree.*/
+        void ApplyGeometricLocators(const WidgetTree &tree, DfsBitset &bits) const;
+
         std::vector<WidgetAttrMatcher> selfMatchers_;
         std::vector<WidgetSelector> frontLocators_;
         std::vector<WidgetSelector> rearLocators_;
+        std::vector<WidgetSelector> ancestorLocators_;
+        std::vector<WidgetSelector> childLocators_;
+        std::vector<WidgetSelector> descendantLocators_;
+        std::vector<std::pair<GeometricRelation, WidgetSelector>> geometricLocators_;
+        mutable std::shared_ptr<const SelectorPlan> plan_;
+        // computed on first use, empty until then
+        mutable std::string fingerprint_;
     };
 }
 
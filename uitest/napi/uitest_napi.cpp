@@ -220,11 +220,27 @@ namespace OHOS::uitest {
         return napi_ok;
     }
 
+    /**Unmarshal result value, a value list (results of the batched api) is unmarshalled into array recursively.*/
+    static napi_status UnmarshalResultValue(napi_env env, const json &in, napi_value *pOut, const TransactionData &tp)
+    {
+        if (!in.is_array()) {
+            return UnmarshalObject(env, in, pOut, tp);
+        }
+        NAPI_CALL_BASE(env, napi_create_array_with_length(env, in.size(), pOut), NAPI_ERR);
+        for (size_t idx = 0; idx < in.size(); idx++) {
+            napi_value item = nullptr;
+            NAPI_CALL_BASE(env, UnmarshalResultValue(env, in.at(idx), &item, tp), NAPI_ERR);
+            NAPI_CALL_BASE(env, napi_set_element(env, *pOut, idx, item), NAPI_ERR);
+        }
+        return napi_ok;
+    }
+
     /**Generate transaction outgoing arguments-data parcel.*/
     static napi_status MarshalTransactionData(napi_env env, TransactionData &tp)
     {
         LOG_D("Start to marshal transaction parameters, count=%{public}zu", tp.argc_);
-        auto paramList = json::array();
+        // parameters marshalled in advance (expanded from js array) are kept ahead
+        auto paramList = tp.argvParcel_.empty() ? json::array() : json::parse(tp.argvParcel_);
         for (size_t idx = 0; idx < tp.argc_; idx++) {
             json paramItem;
             NAPI_CALL_BASE(env, MarshalObject(env, tp.argv_[idx], tp.argTypes_[idx], paramItem), NAPI_ERR);
@@ -284,7 +300,7 @@ namespace OHOS::uitest {
         LOG_D("Begin to deserialize result, count=%{public}zu", resultCount);
         for (size_t idx = 0; idx < resultCount; idx++) {
             napi_value obj = nullptr;
-            NAPI_CALL(env, UnmarshalObject(env, resultValues.at(idx), &obj, tp));
+            NAPI_CALL(env, UnmarshalResultValue(env, resultValues.at(idx), &obj, tp));
             NAPI_CALL(env, napi_set_element(env, objects, idx, obj));
         }
         if constexpr(kReturnMultiple) {
@@ -412,6 +428,9 @@ namespace OHOS::uitest {
             const bool isNullOrUndefined = valueType == napi_null || valueType == napi_undefined;
             NAPI_ASSERT_BASE(env, !isNullOrUndefined, "Null argument", napi_invalid_arg);
             const TypeId dt = argTypes.at(idx);
+            if (dt == TypeId::NONE) {
+                continue; // untyped argument, checked by the api function
+            }
             auto findPrimitive = PRIMITIVE_TYPE_MAP.find(dt);
             auto findJsonSpec = JSON_TYPE_SPEC_MAP.find(dt);
             if (findPrimitive != PRIMITIVE_TYPE_MAP.end()) {
@@ -488,9 +507,10 @@ namespace OHOS::uitest {
     {
         constexpr auto attrName = ATTR_NAMES[kAttr];
         constexpr auto attrType = ATTR_TYPES[kAttr];
-        // incoming args: testValue, matchPattern(optional)
+        // incoming args: testValue, matchPattern(optional), maxDistance(optional, for the FUZZY pattern),
+        // matchFlags(optional)
         TransactionData tp = {.apiId_= "WidgetSelector::AddMatcher"};
-        NAPI_CALL(env, ExtractCallbackInfo(env, info, 0, {attrType, TypeId::INT}, tp));
+        NAPI_CALL(env, ExtractCallbackInfo(env, info, 0, {attrType, TypeId::INT, TypeId::INT, TypeId::INT}, tp));
         if (attrType == TypeId::BOOL && tp.argc_ == 0) {
             // for attribute of type bool, the input-arg is default to true: By.enabled()===By.enabled(true)
             NAPI_CALL(env, napi_get_boolean(env, true, &(tp.argv_[INDEX_ZERO])));
@@ -499,6 +519,16 @@ namespace OHOS::uitest {
         }
         NAPI_ASSERT(env, tp.argc_ >= 1, "Insufficient argument"); // require attribute testValue
         NAPI_CALL(env, EnsureNonSeedBy(env, tp));
+        if (tp.argc_ == INDEX_FOUR) {
+            // move match flags to index4
+            tp.argv_[INDEX_FOUR] = tp.argv_[INDEX_THREE];
+            tp.argTypes_[INDEX_FOUR] = TypeId::INT;
+        }
+        if (tp.argc_ >= INDEX_THREE) {
+            // move max edit distance to index3
+            tp.argv_[INDEX_THREE] = tp.argv_[INDEX_TWO];
+            tp.argTypes_[INDEX_THREE] = TypeId::INT;
+        }
         if (tp.argc_ == 1) {
             // fill-in default match pattern
             NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::EQ, &(tp.argv_[INDEX_TWO])));
@@ -538,6 +568,22 @@ namespace OHOS::uitest {
         return tp.jsThis_;
     }
 
+    /**Template for geometric relative By-builder functions.*/
+    template<GeometricRelation kRelation>
+    static napi_value ByGeometricBuilder(napi_env env, napi_callback_info info)
+    {
+        // incoming args: relative-By, add the relation parameter
+        TransactionData tp = {.apiId_="WidgetSelector::AddGeometricLocator"};
+        NAPI_CALL(env, ExtractCallbackInfo(env, info, 1, {TypeId::BY}, tp));
+        NAPI_CALL(env, EnsureNonSeedBy(env, tp));
+        NAPI_CALL(env, napi_create_uint32(env, kRelation, &(tp.argv_[tp.argc_])));
+        tp.argTypes_[tp.argc_] = TypeId::INT;
+        tp.argc_++;
+        TransactSync(env, tp);
+        // return jsThis, which has updated its metaData in the transaction
+        return tp.jsThis_;
+    }
+
     /**Template for all UiComponent-attribute-getter functions, which forward invocation to bound UiDriver api.*/
     template<UiAttr kAttr>
     static napi_value ComponentAttrGetter(napi_env env, napi_callback_info info)
@@ -652,25 +698,65 @@ namespace OHOS::uitest {
         return TransactAsync(env, tp);
     }
 
-    /**Find and assert component matching given selector exist. <b>(async function)</b>*/
-    static napi_value UiDriverComponentExistAsserter(napi_env env, napi_callback_info info)
+    /**Find the first component matching given selector, only the first match is requested. <b>(async function)</b>*/
+    template<bool kAssertExist>
+    static napi_value UiDriverComponentFinder(napi_env env, napi_callback_info info)
     {
         TransactionData tp = {.apiId_= "UiDriver::FindWidgets", .returnType_=TypeId::COMPONENT};
         NAPI_CALL(env, ExtractCallbackInfo(env, info, 1, {TypeId::BY}, tp));
-        tp.resultInspector_ = [](napi_env env, napi_value result) -> napi_value {
-            napi_valuetype type = napi_null;
-            if (result != nullptr) {
-                NAPI_CALL(env, napi_typeof(env, result, &type));
-            }
-            if (type == napi_null || type == napi_undefined) {
-                return CreateJsException(env, "ComponentExistAssertionFailure", "ComponentNotExist");
-            } else {
-                return result;
-            }
-        };
+        // add the limit parameter, so the native side stops at the first match
+        NAPI_CALL(env, napi_create_uint32(env, 1, &(tp.argv_[tp.argc_])));
+        tp.argTypes_[tp.argc_] = TypeId::INT;
+        tp.argc_++;
+        if constexpr (kAssertExist) {
+            tp.resultInspector_ = [](napi_env env, napi_value result) -> napi_value {
+                napi_valuetype type = napi_null;
+                if (result != nullptr) {
+                    NAPI_CALL(env, napi_typeof(env, result, &type));
+                }
+                if (type == napi_null || type == napi_undefined) {
+                    return CreateJsException(env, "ComponentExistAssertionFailure", "ComponentNotExist");
+                } else {
+                    return result;
+                }
+            };
+        }
         return TransactAsync(env, tp);
     }
 
+    /**Find components matching each of the given selectors on one UI snapshot. <b>(async function)</b>*/
+    static napi_value UiDriverBatchFinder(napi_env env, napi_callback_info info)
+    {
+        TransactionData tp = {.apiId_= "UiDriver::FindWidgetsBatch", .returnType_=TypeId::COMPONENT};
+        NAPI_CALL(env, ExtractCallbackInfo(env, info, 1, {TypeId::NONE}, tp));
+        bool isArray = false;
+        NAPI_CALL(env, napi_is_array(env, tp.argv_[0], &isArray));
+        NAPI_ASSERT(env, isArray, "Illegal argument type, need array of By");
+        uint32_t count = 0;
+        NAPI_CALL(env, napi_get_array_length(env, tp.argv_[0], &count));
+        // expand the selectors into the parameter list
+        auto paramList = json::array();
+        for (uint32_t idx = 0; idx < count; idx++) {
+            napi_value by = nullptr;
+            NAPI_CALL(env, napi_get_element(env, tp.argv_[0], idx, &by));
+            napi_valuetype valueType = napi_undefined;
+            NAPI_CALL(env, napi_typeof(env, by, &valueType));
+            NAPI_ASSERT(env, valueType == napi_object, "Illegal argument type, need array of By");
+            napi_value idProp = nullptr;
+            int32_t idValue = TypeId::NONE;
+            NAPI_CALL(env, napi_get_named_property(env, by, PROP_TYPE_ID, &idProp));
+            NAPI_CALL(env, napi_get_value_int32(env, idProp, &idValue));
+            NAPI_ASSERT(env, idValue == TypeId::BY, "Illegal argument type, need array of By");
+            json paramItem;
+            NAPI_CALL(env, MarshalObject(env, by, TypeId::BY, paramItem));
+            paramList.emplace_back(paramItem);
+        }
+        tp.argc_ = 0;
+        tp.argv_[0] = nullptr;
+        tp.argvParcel_ = paramList.dump();
+        return TransactAsync<true>(env, tp);
+    }
+
     /**Template for all UiDriver single-pointer-based touch functions (generic-click/swipe/drag), return void.*/
     template<PointerOp kAction>
     static napi_value SinglePointToucher(napi_env env, napi_callback_info info)
@@ -742,25 +828,49 @@ namespace OHOS::uitest {
         napi_value propContains;
         napi_value propStartsWith;
         napi_value propEndsWith;
+        napi_value propRegExp;
+        napi_value propFuzzy;
         NAPI_CALL(env, napi_create_object(env, &propMatchPattern));
         NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::EQ, &propEquals));
         NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::CONTAINS, &propContains));
         NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::STARTS_WITH, &propStartsWith));
         NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::ENDS_WITH, &propEndsWith));
+        NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::REGEX, &propRegExp));
+        NAPI_CALL(env, napi_create_int32(env, ValueMatchRule::FUZZY, &propFuzzy));
         NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "EQUALS", propEquals));
         NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "CONTAINS", propContains));
         NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "STARTS_WITH", propStartsWith));
         NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "ENDS_WITH", propEndsWith));
+        NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "REG_EXP", propRegExp));
+        NAPI_CALL(env, napi_set_named_property(env, propMatchPattern, "FUZZY", propFuzzy));
         NAPI_CALL(env, napi_set_named_property(env, exports, "MatchPattern", propMatchPattern));
         return exports;
     }
 
+    /**Exports 'MatchFlag' enumeration.*/
+    static napi_value ExportMatchFlag(napi_env env, napi_value exports)
+    {
+        napi_value propMatchFlag;
+        napi_value propIgnoreCase;
+        napi_value propNormalizeWhitespace;
+        NAPI_CALL(env, napi_create_object(env, &propMatchFlag));
+        NAPI_CALL(env, napi_create_int32(env, ValueMatchFlag::IGNORE_CASE, &propIgnoreCase));
+        NAPI_CALL(env, napi_create_int32(env, ValueMatchFlag::NORMALIZE_WHITESPACE, &propNormalizeWhitespace));
+        NAPI_CALL(env, napi_set_named_property(env, propMatchFlag, "IGNORE_CASE", propIgnoreCase));
+        NAPI_CALL(env, napi_set_named_property(env, propMatchFlag, "NORMALIZE_WHITESPACE", propNormalizeWhitespace));
+        NAPI_CALL(env, napi_set_named_property(env, exports, "MatchFlag", propMatchFlag));
+        return exports;
+    }
+
     /**Exports 'By' class definition and member functions.*/
     static napi_value ExportBy(napi_env env, napi_value exports)
     {
         static constexpr char cppCreator[] = "WidgetSelector::<init>";
         static constexpr char cppAddRearLocator[] = "WidgetSelector::AddRearLocator";
         static constexpr char cppAddFrontLocator[] = "WidgetSelector::AddFrontLocator";
+        static constexpr char cppAddAncestorLocator[] = "WidgetSelector::AddAncestorLocator";
+        static constexpr char cppAddChildLocator[] = "WidgetSelector::AddChildLocator";
+        static constexpr char cppAddDescendantLocator[] = "WidgetSelector::AddDescendantLocator";
         napi_property_descriptor methods[] = {
             DECLARE_NAPI_FUNCTION(ATTR_NAMES[UiAttr::ID], ByAttributeBuilder<UiAttr::ID>),
             DECLARE_NAPI_FUNCTION(ATTR_NAMES[UiAttr::TEXT], ByAttributeBuilder<UiAttr::TEXT>),
@@ -775,7 +885,15 @@ namespace OHOS::uitest {
             DECLARE_NAPI_FUNCTION(ATTR_NAMES[UiAttr::CHECKABLE], ByAttributeBuilder<UiAttr::CHECKABLE>),
             DECLARE_NAPI_FUNCTION(ATTR_NAMES[UiAttr::CHECKED], ByAttributeBuilder<UiAttr::CHECKED>),
             DECLARE_NAPI_FUNCTION("isBefore", ByRelativeBuilder<cppAddRearLocator>),
-            DECLARE_NAPI_FUNCTION("isAfter", ByRelativeBuilder<cppAddFrontLocator>)
+            DECLARE_NAPI_FUNCTION("isAfter", ByRelativeBuilder<cppAddFrontLocator>),
+            DECLARE_NAPI_FUNCTION("within", ByRelativeBuilder<cppAddAncestorLocator>),
+            DECLARE_NAPI_FUNCTION("hasChild", ByRelativeBuilder<cppAddChildLocator>),
+            DECLARE_NAPI_FUNCTION("hasDescendant", ByRelativeBuilder<cppAddDescendantLocator>),
+            DECLARE_NAPI_FUNCTION("leftOf", ByGeometricBuilder<GeometricRelation::LEFT_OF>),
+            DECLARE_NAPI_FUNCTION("rightOf", ByGeometricBuilder<GeometricRelation::RIGHT_OF>),
+            DECLARE_NAPI_FUNCTION("above", ByGeometricBuilder<GeometricRelation::ABOVE>),
+            DECLARE_NAPI_FUNCTION("below", ByGeometricBuilder<GeometricRelation::BELOW>),
+            DECLARE_NAPI_FUNCTION("near", ByGeometricBuilder<GeometricRelation::NEAR>)
         };
         constexpr size_t num = sizeof(methods) / sizeof(methods[0]);
         constexpr napi_callback initializer = JsObjectInitializer<TypeId::BY>;
@@ -829,14 +947,20 @@ namespace OHOS::uitest {
         static constexpr char cppFinds[] = "UiDriver::FindWidgets";
         static constexpr char cppCap[] = "UiDriver::TakeScreenCap";
         static constexpr char cppWaitFor[] = "UiDriver::WaitForWidget";
+        static constexpr char cppFindAt[] = "UiDriver::FindWidgetAt";
+        static constexpr char cppFindNearest[] = "UiDriver::FindNearestClickableWidget";
         napi_property_descriptor methods[] = {
             DECLARE_NAPI_STATIC_FUNCTION("create", (StaticSyncCreator<cppCreator, TypeId::DRIVER>)),
             DECLARE_NAPI_FUNCTION("delayMs", (GenericAsyncFunc<cppDelay, TypeId::NONE, false, TypeId::INT>)),
             DECLARE_NAPI_FUNCTION("findComponents", (GenericAsyncFunc<cppFinds, TypeId::COMPONENT, true, TypeId::BY>)),
-            DECLARE_NAPI_FUNCTION("findComponent", (GenericAsyncFunc<cppFinds, TypeId::COMPONENT, false, TypeId::BY>)),
+            DECLARE_NAPI_FUNCTION("findComponent", UiDriverComponentFinder<false>),
+            DECLARE_NAPI_FUNCTION("findComponentsBatch", UiDriverBatchFinder),
             DECLARE_NAPI_FUNCTION("waitForComponent", (GenericAsyncFunc<cppWaitFor, COMPONENT, false, BY, INT>)),
+            DECLARE_NAPI_FUNCTION("findComponentAt", (GenericAsyncFunc<cppFindAt, COMPONENT, false, INT, INT>)),
+            DECLARE_NAPI_FUNCTION("findClickableComponentNear",
+                (GenericAsyncFunc<cppFindNearest, COMPONENT, false, INT, INT>)),
             DECLARE_NAPI_FUNCTION("screenCap", (GenericAsyncFunc<cppCap, TypeId::BOOL, false, TypeId::STRING>)),
-            DECLARE_NAPI_FUNCTION("assertComponentExist", UiDriverComponentExistAsserter),
+            DECLARE_NAPI_FUNCTION("assertComponentExist", UiDriverComponentFinder<true>),
             DECLARE_NAPI_FUNCTION("pressBack", UiDriverKeyOperator<UiKey::BACK>),
             DECLARE_NAPI_FUNCTION("triggerKey", UiDriverKeyOperator<UiKey::GENERIC>),
             // raw coordinate based action methods
@@ -879,6 +1003,9 @@ namespace OHOS::uitest {
         if (ExportMatchPattern(env, exports) == nullptr) {
             return nullptr;
         }
+        if (ExportMatchFlag(env, exports) == nullptr) {
+            return nullptr;
+        }
         if (ExportBy(env, exports) == nullptr) {
             return nullptr;
         }
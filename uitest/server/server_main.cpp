@@ -29,6 +29,8 @@ using namespace std::chrono;
 namespace OHOS::uitest {
     struct option g_longOptions[] = {
         {"path", required_argument, nullptr, 'p'},
+        {"format", required_argument, nullptr, 'f'},
+        {nullptr, 0, nullptr, 0},
     };
     /* *Print to the console of this shell process. */
     static inline void PrintToConsole(string_view message)
@@ -57,12 +59,18 @@ namespace OHOS::uitest {
     static int32_t DumpLayout(int32_t argc, char *argv[])
     {
         auto ts = to_string(GetCurrentMicroseconds());
-        auto savePath = "/data/local/tmp/layout_" + ts + ".json";
         map<char, string> params;
-        static constexpr string_view usage = "USAGE: uitestkit dumpLayout -p <path>";
-        if (GetParam(argc, argv, "p:", usage, params) == EXIT_FAILURE) {
+        static constexpr string_view usage = "USAGE: uitestkit dumpLayout -p <path> [-f <json|bin>]";
+        if (GetParam(argc, argv, "p:f:", usage, params) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        auto formatIter = params.find('f');
+        const bool binary = formatIter != params.end() && formatIter->second == "bin";
+        if (formatIter != params.end() && !binary && formatIter->second != "json") {
+            PrintToConsole(usage);
             return EXIT_FAILURE;
         }
+        auto savePath = "/data/local/tmp/layout_" + ts + (binary ? ".bin" : ".json");
         auto iter = params.find('p');
         if (iter != params.end()) {
             savePath = iter->second;
@@ -72,8 +80,19 @@ namespace OHOS::uitest {
             PrintToConsole("Dump layout failed, cannot connect to AAMS");
             return EXIT_FAILURE;
         }
-        auto data = nlohmann::json();
-        controller.GetCurrentUiDom(data);
+        string content;
+        if (binary) {
+            // the binary layout keeps the raw bounds, same as the json layout
+            WidgetTree tree("");
+            tree.ConstructFromSource([&controller](WidgetTreeBuilder &builder) {
+                controller.GetCurrentUiTree(builder);
+            }, false);
+            tree.MarshalIntoBinary(content);
+        } else {
+            auto data = nlohmann::json();
+            controller.GetCurrentUiDom(data);
+            content = data.dump();
+        }
         ofstream fout;
         fout.open(savePath, ios::out | ios::binary);
         if (!fout) {
@@ -81,7 +100,7 @@ namespace OHOS::uitest {
             return EXIT_FAILURE;
         }
         PrintToConsole("DumpLayout saved to:" + savePath);
-        fout << data.dump();
+        fout << content;
         fout.close();
         return EXIT_SUCCESS;
     }
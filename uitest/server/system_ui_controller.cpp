@@ -17,7 +17,9 @@
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <iostream>
+#include <set>
 #include <thread>
 #include <utility>
 #include <condition_variable>
@@ -62,10 +64,20 @@ namespace OHOS::uitest {
 
         bool WaitEventIdle(uint32_t idleThresholdMs, uint32_t timeoutMs);
 
+        /**Mark that the UI changes are unknown, the whole UI need to be fetched.*/
+        void MarkChangesUnknown();
+
+        /**Take the recorded changed nodes, returns false if the changes are unknown.*/
+        bool TakeChangedNodes(vector<int32_t> &ids);
+
     private:
         function<void()> onConnectCallback_ = nullptr;
         function<void()> onDisConnectCallback_ = nullptr;
         atomic<uint64_t> lastEventMillis_ = 0;
+        // the nodes changed since last taken, guarded by changesMutex_
+        mutex changesMutex_;
+        set<int32_t> changedNodes_;
+        bool changesUnknown_ = true;
     };
 
     void UiEventMonitor::SetOnAbilityConnectCallback(function<void()> onConnectCb)
@@ -80,6 +92,7 @@ namespace OHOS::uitest {
 
     void UiEventMonitor::OnAbilityConnected()
     {
+        MarkChangesUnknown(); // events might be missed while not connected
         if (onConnectCallback_ != nullptr) {
             onConnectCallback_();
         }
@@ -87,6 +100,7 @@ namespace OHOS::uitest {
 
     void UiEventMonitor::OnAbilityDisconnected()
     {
+        MarkChangesUnknown();
         if (onDisConnectCallback_ != nullptr) {
             onDisConnectCallback_();
         }
@@ -97,12 +111,47 @@ namespace OHOS::uitest {
                                            | EventType::TYPE_PAGE_STATE_UPDATE | EventType::TYPE_PAGE_CONTENT_UPDATE
                                            | EventType::TYPE_VIEW_SCROLLED_EVENT | EventType::TYPE_WINDOW_UPDATE;
 
+    // the events which changes the content of the source node, any other event might change the whole UI
+    static constexpr uint32_t CONTENT_EVENT_MASK = EventType::TYPE_VIEW_TEXT_UPDATE_EVENT
+                                                   | EventType::TYPE_PAGE_CONTENT_UPDATE;
+    // record at most this count of changed nodes, updating more subtrees costs close to fetching the whole UI
+    static constexpr size_t MAX_CHANGED_NODES = 32;
+
     void UiEventMonitor::OnAccessibilityEvent(const AccessibilityEventInfo &eventInfo)
     {
         LOG_W("OnEvent:0x%{public}x", eventInfo.GetEventType());
-        if ((eventInfo.GetEventType() & EVENT_MASK) > 0) {
-            lastEventMillis_.store(GetCurrentMillisecond());
+        {
+            // track the changes ahead of filtering, the unmonitored events (focus, selection, checked state...)
+            // change the UI too
+            lock_guard<mutex> guard(changesMutex_);
+            if ((eventInfo.GetEventType() & CONTENT_EVENT_MASK) == 0 || changedNodes_.size() >= MAX_CHANGED_NODES) {
+                changesUnknown_ = true;
+            } else if (!changesUnknown_) {
+                changedNodes_.insert(eventInfo.GetAccessibilityId());
+            }
+        }
+        if ((eventInfo.GetEventType() & EVENT_MASK) == 0) {
+            return;
         }
+        lastEventMillis_.store(GetCurrentMillisecond());
+    }
+
+    void UiEventMonitor::MarkChangesUnknown()
+    {
+        lock_guard<mutex> guard(changesMutex_);
+        changesUnknown_ = true;
+    }
+
+    bool UiEventMonitor::TakeChangedNodes(vector<int32_t> &ids)
+    {
+        lock_guard<mutex> guard(changesMutex_);
+        const bool known = !changesUnknown_;
+        if (known) {
+            ids.assign(changedNodes_.begin(), changedNodes_.end());
+        }
+        changedNodes_.clear();
+        changesUnknown_ = false;
+        return known;
     }
 
     uint64_t UiEventMonitor::GetLastEventMillis()
@@ -130,6 +179,9 @@ namespace OHOS::uitest {
         return WaitEventIdle(idleThresholdMs, timeoutMs - sliceMs);
     }
 
+    // UiEventMonitor instance.
+    static shared_ptr<UiEventMonitor> g_monitorInstance_;
+
     SysUiController::SysUiController(string_view name, string_view device) : UiController(name, device) {}
 
     SysUiController::~SysUiController()
@@ -137,52 +189,51 @@ namespace OHOS::uitest {
         DisConnectFromSysAbility();
     }
 
-    static void MarshalAccessibilityNodeAttributes(AccessibilityElementInfo &node, json &to)
+    static void PushAccessibilityNodeAttributes(AccessibilityElementInfo &node, WidgetTreeBuilder &builder)
     {
-        to[ATTR_NAMES[UiAttr::TEXT]] = node.GetContent();
-        to[ATTR_NAMES[UiAttr::ID]] = to_string(node.GetAccessibilityId());
-        to[ATTR_NAMES[UiAttr::KEY]] = node.GetInspectorKey();
-        to[ATTR_NAMES[UiAttr::TYPE]] = node.GetComponentType();
-        to[ATTR_NAMES[UiAttr::ENABLED]] = node.IsEnabled() ? "true" : "false";
-        to[ATTR_NAMES[UiAttr::FOCUSED]] = node.IsFocused() ? "true" : "false";
-        to[ATTR_NAMES[UiAttr::SELECTED]] = node.IsSelected() ? "true" : "false";
-        to[ATTR_NAMES[UiAttr::CHECKABLE]] = node.IsCheckable() ? "true" : "false";
-        to[ATTR_NAMES[UiAttr::CHECKED]] = node.IsChecked() ? "true" : "false";
-        to[ATTR_NAMES[UiAttr::CLICKABLE]] = "false";
-        to[ATTR_NAMES[UiAttr::LONG_CLICKABLE]] = "false";
-        to[ATTR_NAMES[UiAttr::SCROLLABLE]] = "false";
-        const auto bounds = node.GetRectInScreen();
-        const auto rect = Rect(bounds.GetLeftTopXScreenPostion(), bounds.GetRightBottomXScreenPostion(),
-                               bounds.GetLeftTopYScreenPostion(), bounds.GetRightBottomYScreenPostion());
-        stringstream stream;
-        // "[%d,%d][%d,%d]", rect.left, rect.top, rect.right, rect.bottom
-        stream << "[" << rect.left_ << "," << rect.top_ << "]" << "[" << rect.right_ << "," << rect.bottom_ << "]";
-        to[ATTR_NAMES[UiAttr::BOUNDS]] = stream.str();
+        static constexpr string_view trueStr = "true";
+        static constexpr string_view falseStr = "false";
+        builder.Attr(ATTR_NAMES[UiAttr::TEXT], node.GetContent());
+        builder.Attr(ATTR_NAMES[UiAttr::ID], to_string(node.GetAccessibilityId()));
+        builder.Attr(ATTR_NAMES[UiAttr::KEY], node.GetInspectorKey());
+        builder.Attr(ATTR_NAMES[UiAttr::TYPE], node.GetComponentType());
+        builder.Attr(ATTR_NAMES[UiAttr::ENABLED], node.IsEnabled() ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::FOCUSED], node.IsFocused() ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::SELECTED], node.IsSelected() ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::CHECKABLE], node.IsCheckable() ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::CHECKED], node.IsChecked() ? trueStr : falseStr);
+        bool clickable = false;
+        bool longClickable = false;
+        bool scrollable = false;
         auto actionList = node.GetActionList();
         for (auto &action :actionList) {
             switch (action.GetActionType()) {
                 case ACCESSIBILITY_ACTION_CLICK:
-                    to[ATTR_NAMES[UiAttr::CLICKABLE]] = "true";
+                    clickable = true;
                     break;
                 case ACCESSIBILITY_ACTION_LONG_CLICK:
-                    to[ATTR_NAMES[UiAttr::LONG_CLICKABLE]] = "true";
+                    longClickable = true;
                     break;
                 case ACCESSIBILITY_ACTION_SCROLL_FORWARD:
                 case ACCESSIBILITY_ACTION_SCROLL_BACKWARD:
-                    to[ATTR_NAMES[UiAttr::SCROLLABLE]] = "true";
+                    scrollable = true;
                     break;
                 default:
                     break;
             }
         }
+        builder.Attr(ATTR_NAMES[UiAttr::CLICKABLE], clickable ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::LONG_CLICKABLE], longClickable ? trueStr : falseStr);
+        builder.Attr(ATTR_NAMES[UiAttr::SCROLLABLE], scrollable ? trueStr : falseStr);
+        const auto bounds = node.GetRectInScreen();
+        builder.Bounds(Rect(bounds.GetLeftTopXScreenPostion(), bounds.GetRightBottomXScreenPostion(),
+                            bounds.GetLeftTopYScreenPostion(), bounds.GetRightBottomYScreenPostion()));
     }
 
-    static void MarshallAccessibilityNodeInfo(AccessibilityElementInfo &from, json &to)
+    static void PushAccessibilityNodeInfo(AccessibilityElementInfo &from, WidgetTreeBuilder &builder)
     {
-        json attributes;
-        MarshalAccessibilityNodeAttributes(from, attributes);
-        to["attributes"] = attributes;
-        auto childList = json::array();
+        builder.BeginNode();
+        PushAccessibilityNodeAttributes(from, builder);
         const auto childCount = from.GetChildCount();
         AccessibilityElementInfo child;
         auto ability = AccessibilityUITestAbility::GetInstance();
@@ -192,17 +243,59 @@ namespace OHOS::uitest {
                 if (!child.IsVisible()) {
                     continue;
                 }
-                auto parcel = json();
-                MarshallAccessibilityNodeInfo(child, parcel);
-                childList.push_back(parcel);
+                PushAccessibilityNodeInfo(child, builder);
             } else {
                 LOG_W("Get Node child at index=%{public}d failed", index);
             }
         }
-        to["children"] = childList;
+        builder.EndNode();
     }
 
-    static void GetCurrentUiDom2(nlohmann::json& out)
+    /**Builder that marshals the received nodes into dom data.*/
+    class UiDomMarshaller final : public WidgetTreeBuilder {
+    public:
+        explicit UiDomMarshaller(json &out) : out_(out) {}
+
+        ~UiDomMarshaller() override {}
+
+        void BeginNode() override
+        {
+            json *node = &out_;
+            if (!nodes_.empty()) {
+                // the opened nodes are the last child of their parent, appending a child does not move them
+                auto &children = (*nodes_.back())["children"];
+                children.push_back(json());
+                node = &(children.back());
+            }
+            (*node)["attributes"] = json::object();
+            (*node)["children"] = json::array();
+            nodes_.push_back(node);
+        }
+
+        void Attr(string_view name, string_view value) override
+        {
+            (*nodes_.back())["attributes"][string(name)] = string(value);
+        }
+
+        void Bounds(const Rect &rect) override
+        {
+            stringstream stream;
+            // "[%d,%d][%d,%d]", rect.left, rect.top, rect.right, rect.bottom
+            stream << "[" << rect.left_ << "," << rect.top_ << "]" << "[" << rect.right_ << "," << rect.bottom_ << "]";
+            (*nodes_.back())["attributes"][ATTR_NAMES[UiAttr::BOUNDS]] = stream.str();
+        }
+
+        void EndNode() override
+        {
+            nodes_.pop_back();
+        }
+
+    private:
+        json &out_;
+        vector<json *> nodes_;
+    };
+
+    static void GetCurrentUiTree2(WidgetTreeBuilder &builder)
     {
         auto ability = AccessibilityUITestAbility::GetInstance();
         AccessibilityElementInfo elementInfo {};
@@ -217,7 +310,7 @@ namespace OHOS::uitest {
                     break;
                 }
             }
-            MarshallAccessibilityNodeInfo(elementInfo, out);
+            PushAccessibilityNodeInfo(elementInfo, builder);
         } else {
             LOG_I("Root node not found");
         }
@@ -225,7 +318,78 @@ namespace OHOS::uitest {
 
     void SysUiController::GetCurrentUiDom(nlohmann::json& out) const
     {
-        GetCurrentUiDom2(out);
+        UiDomMarshaller marshaller(out);
+        GetCurrentUiTree2(marshaller);
+    }
+
+    void SysUiController::GetCurrentUiTree(WidgetTreeBuilder &builder) const
+    {
+        GetCurrentUiTree2(builder);
+    }
+
+    bool SysUiController::CollectChangedNodes(vector<int32_t> &ids) const
+    {
+        return g_monitorInstance_ != nullptr && g_monitorInstance_->TakeChangedNodes(ids);
+    }
+
+    /**Parse the child indexes along the path from the root out of the node hierarchy, like "ROOT,1,0".*/
+    static bool ParseHierarchyPath(string_view hierarchy, vector<uint32_t> &path)
+    {
+        static constexpr string_view root = "ROOT";
+        static constexpr uint32_t factor = 10;
+        if (hierarchy.substr(0, root.length()) != root) {
+            return false;
+        }
+        for (size_t cursor = root.length(); cursor < hierarchy.length();) {
+            if (hierarchy[cursor] != ',' || cursor + 1 >= hierarchy.length()) {
+                return false;
+            }
+            uint32_t index = 0;
+            for (cursor++; cursor < hierarchy.length() && hierarchy[cursor] != ','; cursor++) {
+                const auto ch = hierarchy[cursor];
+                if (ch < '0' || ch > '9') {
+                    return false;
+                }
+                index = index * factor + static_cast<uint32_t>(ch - '0');
+            }
+            path.push_back(index);
+        }
+        return true;
+    }
+
+    bool SysUiController::GetUiSubtree(int32_t id, string_view hierarchy, WidgetTreeBuilder &builder) const
+    {
+        // walk down from the root along the hierarchy by the accessors fetching the whole UI, the hierarchy indexes
+        // count the visible children only, so each level fetches the children up to the target one
+        vector<uint32_t> path;
+        auto ability = AccessibilityUITestAbility::GetInstance();
+        AccessibilityElementInfo node {};
+        if (!ParseHierarchyPath(hierarchy, path) || !ability->GetRoot(node)) {
+            LOG_W("Get Node of id=%{public}d failed", id);
+            return false;
+        }
+        for (auto position : path) {
+            AccessibilityElementInfo child {};
+            uint32_t visibleCount = 0;
+            bool found = false;
+            for (auto index = 0; index < node.GetChildCount() && !found; index++) {
+                if (ability->GetChildElementInfo(index, node, child) && child.IsVisible()) {
+                    found = visibleCount++ == position;
+                }
+            }
+            if (!found) {
+                LOG_W("Node of id=%{public}d not found at %{public}s", id, string(hierarchy).c_str());
+                return false;
+            }
+            node = child;
+        }
+        // the node at the hierarchy is another one if the UI structure changed
+        if (node.GetAccessibilityId() != id) {
+            LOG_W("Node of id=%{public}d moved from %{public}s", id, string(hierarchy).c_str());
+            return false;
+        }
+        PushAccessibilityNodeInfo(node, builder);
+        return true;
     }
 
     void SysUiController::WaitForUiSteady(uint32_t idleThresholdMs, uint32_t timeoutMs) const
@@ -234,6 +398,9 @@ namespace OHOS::uitest {
 
     void SysUiController::InjectTouchEventSequence(const vector<TouchEvent> &events) const
     {
+        if (g_monitorInstance_ != nullptr) {
+            g_monitorInstance_->MarkChangesUnknown(); // injected events might change the whole UI
+        }
         for (auto& event:events) {
             auto pointerEvent = PointerEvent::Create();
             PointerEvent::PointerItem pinterItem;
@@ -264,6 +431,9 @@ namespace OHOS::uitest {
 
     void SysUiController::InjectKeyEventSequence(const vector<KeyEvent> &events) const
     {
+        if (g_monitorInstance_ != nullptr) {
+            g_monitorInstance_->MarkChangesUnknown(); // injected events might change the whole UI
+        }
         vector<int32_t> downKeys;
         for (auto& event:events) {
             if (event.stage_ == ActionStage::UP) {
@@ -401,9 +571,6 @@ namespace OHOS::uitest {
         return true;
     }
 
-    // UiEventMonitor instance.
-    static shared_ptr<UiEventMonitor> g_monitorInstance_;
-
     bool SysUiController::ConnectToSysAbility()
     {
         if (connected_) {
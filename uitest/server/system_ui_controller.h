@@ -28,6 +28,12 @@ namespace OHOS::uitest {
 
         void GetCurrentUiDom(nlohmann::json& out) const override;
 
+        void GetCurrentUiTree(WidgetTreeBuilder &builder) const override;
+
+        bool CollectChangedNodes(std::vector<int32_t> &ids) const override;
+
+        bool GetUiSubtree(int32_t id, std::string_view hierarchy, WidgetTreeBuilder &builder) const override;
+
         void WaitForUiSteady(uint32_t idleThresholdMs, uint32_t timeoutMs) const override;
 
         void InjectTouchEventSequence(const std::vector<TouchEvent> &events) const override;
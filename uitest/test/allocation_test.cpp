@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include "gtest/gtest.h"
+#include "ui_model.h"
+#include "widget_matcher.h"
+#include "widget_selector.h"
+#include "test_helpers.h"
+
+using namespace OHOS::uitest;
+using namespace std;
+using namespace nlohmann;
+
+// count of the heap allocations in this test binary, to check the allocation-free paths. The replaced allocation
+// functions are kept out of line, so that the compiler pairs each call with its own deallocation function
+static atomic<uint64_t> g_allocationCount(0);
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    g_allocationCount++;
+    if (auto ptr = malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+/**Run the task and returns the count of heap allocations it made.*/
+static uint64_t CountAllocations(const function<void()> &task)
+{
+    const auto start = g_allocationCount.load();
+    task();
+    return g_allocationCount.load() - start;
+}
+
+TEST(AllocationTest, matchingAllocations)
+{
+    static constexpr uint32_t itemCount = 500;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    const vector<WidgetAttrMatcher> matchers = {
+        WidgetAttrMatcher("text", "Contact 1", STARTS_WITH), WidgetAttrMatcher("id", "42", EQ),
+        WidgetAttrMatcher("id", "4", CONTAINS), WidgetAttrMatcher("enabled", "true", EQ),
+        WidgetAttrMatcher("bounds", "\"leftX\":0", CONTAINS), WidgetAttrMatcher("hierarchy", "ROOT,1", STARTS_WITH),
+        WidgetAttrMatcher("key", "", EQ), WidgetAttrMatcher("custom", "none", EQ)};
+    const auto plan = SelectorPlan(matchers);
+    vector<reference_wrapper<const Widget>> found;
+    found.reserve(tree.GetWidgetCount());
+    const auto evaluate = [&tree, &matchers, &plan, &found]() {
+        for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+            const auto &widget = tree.GetWidgetByDfsIndex(index);
+            for (auto &matcher : matchers) {
+                matcher.Matches(widget);
+            }
+            plan.Matches(widget);
+        }
+        for (auto &matcher : matchers) {
+            found.clear();
+            MatchedWidgetCollector collector(matcher, found);
+            tree.DfsTraverse(collector);
+        }
+    };
+    evaluate(); // warm up the reused buffers
+    const auto allocations = CountAllocations(evaluate);
+    // the copying accessors allocate per node and predicate
+    const auto copyingAllocations = CountAllocations([&tree, &matchers]() {
+        for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+            for (auto &matcher : matchers) {
+                const auto &widget = tree.GetWidgetByDfsIndex(index);
+                widget.HasAttr(matcher.GetAttrName()) && widget.GetAttr(matcher.GetAttrName(), "").empty();
+            }
+        }
+    });
+    cout << "Heap allocations matching " << matchers.size() << " predicates on " << tree.GetWidgetCount();
+    cout << " nodes: " << allocations << ", copying accessors: " << copyingAllocations << endl;
+    ASSERT_EQ(0U, allocations);
+    // the selection allocates the match sets and results only, the count does not grow with the nodes
+    WidgetSelector selector;
+    for (auto &matcher : matchers) {
+        selector.AddMatcher(matcher);
+    }
+    WidgetTree largeTree("");
+    largeTree.ConstructFromDom(MakeLayoutDom(itemCount * INDEX_FOUR), false);
+    for (auto target : {&tree, &largeTree}) {
+        found.clear();
+        selector.Select(*target, found); // warm up the indexes
+    }
+    // the results are memoized across the calls, start over to count the selection itself
+    const auto smallSelect = CountAllocations([&tree, &selector, &found]() {
+        WidgetSelector::ResetSelectionCache();
+        selector.Select(tree, found);
+    });
+    const auto largeSelect = CountAllocations([&largeTree, &selector, &found]() {
+        WidgetSelector::ResetSelectionCache();
+        selector.Select(largeTree, found);
+    });
+    ASSERT_GT(smallSelect, 0U);
+    ASSERT_EQ(smallSelect, largeSelect);
+}
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <functional>
+#include <regex>
+#include "gtest/gtest.h"
+#include "substring_search.h"
+#include "ui_model.h"
+#include "widget_matcher.h"
+#include "widget_selector.h"
+#include "test_helpers.h"
+
+using namespace OHOS::uitest;
+using namespace std;
+using namespace nlohmann;
+
+// rounds to run each measurement, the best one is taken to reduce noise
+static constexpr uint32_t BENCHMARK_ROUNDS = 5;
+
+/**Run the task for several rounds and returns the minimum time cost in microseconds.*/
+static uint64_t MeasureMicroseconds(const function<void()> &task)
+{
+    uint64_t best = UINT64_MAX;
+    for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+        const auto start = GetCurrentMicroseconds();
+        task();
+        best = min(best, GetCurrentMicroseconds() - start);
+    }
+    return best;
+}
+
+static json MakeDomNode(string_view type, string_view text)
+{
+    json node;
+    node["attributes"]["type"] = type;
+    node["attributes"]["text"] = text;
+    node["attributes"]["bounds"] = "[0,0][100,100]";
+    node["children"] = json::array();
+    return node;
+}
+
+/**Build dom whose depth is the given value, each nested node holds a leaf and the next nested node.*/
+static json MakeDeepDom(uint32_t depth)
+{
+    auto node = MakeDomNode("Leaf", "bottom");
+    for (uint32_t level = 0; level < depth; level++) {
+        auto parent = MakeDomNode("Node", to_string(level));
+        parent["children"].push_back(MakeDomNode("Leaf", "leaf"));
+        parent["children"].push_back(move(node));
+        node = move(parent);
+    }
+    return node;
+}
+
+TEST(BenchmarkTest, constructDeepTreeScalesLinearly)
+{
+    static constexpr uint32_t smallDepth = 500;
+    static constexpr uint32_t factor = 8;
+    const auto smallDom = MakeDeepDom(smallDepth);
+    const auto largeDom = MakeDeepDom(smallDepth * factor);
+    size_t smallCount = 0;
+    size_t largeCount = 0;
+    const auto smallCost = MeasureMicroseconds([&smallDom, &smallCount]() {
+        WidgetTree tree("");
+        tree.ConstructFromDom(smallDom, true);
+        smallCount = tree.GetWidgetCount();
+    });
+    const auto largeCost = MeasureMicroseconds([&largeDom, &largeCount]() {
+        WidgetTree tree("");
+        tree.ConstructFromDom(largeDom, true);
+        largeCount = tree.GetWidgetCount();
+    });
+    ASSERT_EQ(smallDepth * 2 + 1, smallCount);
+    ASSERT_EQ(smallDepth * factor * 2 + 1, largeCount);
+    cout << "ConstructFromDom: " << smallCount << " nodes " << smallCost << "us, ";
+    cout << largeCount << " nodes " << largeCost << "us" << endl;
+    // copying subtrees at each level costs O(n*depth), which grows by factor^2 here
+    ASSERT_LT(largeCost, max<uint64_t>(smallCost, 1) * factor * 3);
+}
+
+TEST(BenchmarkTest, binaryLayoutSizeAndLoadCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    const auto dom = MakeLayoutDom(itemCount);
+    WidgetTree tree("");
+    tree.ConstructFromDom(dom, false);
+    const auto jsonText = dom.dump();
+    string binary;
+    tree.MarshalIntoBinary(binary);
+    size_t count = 0;
+    const auto jsonCost = MeasureMicroseconds([&jsonText, &count]() {
+        WidgetTree loaded("");
+        loaded.ConstructFromDom(json::parse(jsonText), false);
+        count = loaded.GetWidgetCount();
+    });
+    ASSERT_EQ(tree.GetWidgetCount(), count);
+    const auto binaryCost = MeasureMicroseconds([&binary, &count]() {
+        WidgetTree loaded("");
+        loaded.ConstructFromBinary(binary);
+        count = loaded.GetWidgetCount();
+    });
+    ASSERT_EQ(tree.GetWidgetCount(), count);
+    cout << "Layout of " << count << " nodes: json " << jsonText.size() << " bytes " << jsonCost << "us, ";
+    cout << "binary " << binary.size() << " bytes " << binaryCost << "us" << endl;
+    ASSERT_LE(binary.size() * 5, jsonText.size());
+    ASSERT_LT(binaryCost, jsonCost);
+}
+
+TEST(BenchmarkTest, indexedEqSelectionCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    const auto plan = SelectorPlan({WidgetAttrMatcher("text", "Contact 1999", EQ)});
+    vector<reference_wrapper<const Widget>> found;
+    const auto traverseCost = MeasureMicroseconds([&tree, &plan, &found]() {
+        found.clear();
+        MatchedWidgetCollector collector(plan, found);
+        tree.DfsTraverse(collector);
+    });
+    ASSERT_EQ(1U, found.size());
+    plan.Select(tree, found); // build the index
+    const auto probeCost = MeasureMicroseconds([&tree, &plan, &found]() {
+        found.clear();
+        plan.Select(tree, found);
+    });
+    ASSERT_EQ(1U, found.size());
+    cout << "EQ selection on " << tree.GetWidgetCount() << " nodes: traverse " << traverseCost << "us, ";
+    cout << "index probe " << probeCost << "us" << endl;
+    ASSERT_LE(probeCost, traverseCost);
+}
+
+TEST(BenchmarkTest, affixIndexedSelectionCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    for (auto rule : {CONTAINS, STARTS_WITH, ENDS_WITH}) {
+        const auto testValue = rule == STARTS_WITH ? "Contact 199" : (rule == ENDS_WITH ? "999" : "act 19");
+        const auto plan = SelectorPlan({WidgetAttrMatcher("text", testValue, rule)});
+        vector<reference_wrapper<const Widget>> expected;
+        const auto traverseCost = MeasureMicroseconds([&tree, &plan, &expected]() {
+            expected.clear();
+            MatchedWidgetCollector collector(plan, expected);
+            tree.DfsTraverse(collector);
+        });
+        vector<reference_wrapper<const Widget>> found;
+        plan.Select(tree, found); // build the index
+        const auto probeCost = MeasureMicroseconds([&tree, &plan, &found]() {
+            found.clear();
+            plan.Select(tree, found);
+        });
+        ASSERT_EQ(expected.size(), found.size());
+        cout << GetRuleName(rule) << " selection on " << tree.GetWidgetCount() << " nodes: traverse ";
+        cout << traverseCost << "us, index probe " << probeCost << "us" << endl;
+    }
+}
+
+TEST(BenchmarkTest, regexSelectionCost)
+{
+    // chat-like layout, each message is a text of several dozen words
+    static constexpr uint32_t messageCount = 3000;
+    static constexpr uint32_t wordsPerMessage = 40;
+    static constexpr uint32_t senderCount = 50;
+    const vector<string> words = {"the", "meeting", "is", "moved", "to", "friday", "please", "check", "deadline",
+                                  "report", "and", "reply", "soon", "thanks", "draft", "review"};
+    auto dom = MakeDomNode("List", "");
+    for (uint32_t index = 0; index < messageCount; index++) {
+        string text = "Message " + to_string(index) + " from user" + to_string(index % senderCount) + ":";
+        for (uint32_t word = 0; word < wordsPerMessage; word++) {
+            text.append(" ").append(words[(index * 7 + word * (index % 5 + 1)) % words.size()]);
+        }
+        dom["children"].push_back(MakeDomNode("Text", text));
+    }
+    WidgetTree tree("");
+    tree.ConstructFromDom(dom, false);
+    const auto patterns = {"Message \\d+ from user4\\d: .*deadline report.*", "[\\w: ]+ (thanks|review)",
+                           ".*(friday|soon)$"};
+    for (auto pattern : patterns) {
+        const auto matcher = WidgetAttrMatcher("text", pattern, REGEX);
+        size_t expected = 0;
+        const auto stdRegexCost = MeasureMicroseconds([&tree, &expected, pattern]() {
+            const regex compiled(pattern);
+            expected = 0;
+            for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+                expected += regex_match(tree.GetWidgetByDfsIndex(index).GetAttr("text", ""), compiled) ? 1 : 0;
+            }
+        });
+        size_t found = 0;
+        const auto automatonCost = MeasureMicroseconds([&tree, &found, pattern]() {
+            const auto automaton = RegexAutomaton::Compile(pattern);
+            found = 0;
+            string_view text;
+            string buffer;
+            for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+                const auto &widget = tree.GetWidgetByDfsIndex(index);
+                found += widget.GetAttrView("text", buffer, text) && automaton->Matches(text) ? 1 : 0;
+            }
+        });
+        // the first selection on a new snapshot, which builds the value index and runs once per distinct value
+        WidgetTree snapshot("");
+        snapshot.ConstructFromDom(dom, false);
+        vector<reference_wrapper<const Widget>> selected;
+        const auto start = GetCurrentMicroseconds();
+        SelectorPlan({matcher}).Select(snapshot, selected);
+        const auto selectCost = GetCurrentMicroseconds() - start;
+        ASSERT_EQ(expected, found) << pattern;
+        ASSERT_EQ(expected, selected.size()) << pattern;
+        cout << "Regex '" << pattern << "' on " << tree.GetWidgetCount() << " nodes, " << expected << " matched: ";
+        cout << "std::regex " << stdRegexCost << "us, automaton " << automatonCost << "us, selection ";
+        cout << selectCost << "us" << endl;
+        ASSERT_LT(automatonCost, stdRegexCost) << pattern;
+    }
+}
+
+TEST(BenchmarkTest, substringSearchCost)
+{
+    // multi-KB text nodes such as web contents, the patterns occur near the end or not at all
+    static constexpr uint32_t nodeCount = 500;
+    static constexpr uint32_t textLength = 4096;
+    const vector<string> words = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit"};
+    vector<string> texts;
+    for (uint32_t index = 0; index < nodeCount; index++) {
+        string text;
+        for (uint32_t word = 0; text.length() < textLength; word++) {
+            text.append(words[(index + word * 3) % words.size()]).append(" ");
+        }
+        texts.emplace_back(text.append("paragraph ").append(to_string(index)));
+    }
+    const auto patterns = {"paragraph 42", "elit lorem", "consectetur adipiscing zz", "q"};
+    for (auto pattern : patterns) {
+        size_t expected = 0;
+        const auto stdFindCost = MeasureMicroseconds([&texts, &expected, pattern]() {
+            expected = 0;
+            for (const auto &text : texts) {
+                expected += text.find(pattern) != string::npos ? 1 : 0;
+            }
+        });
+        size_t found = 0;
+        const auto kernelCost = MeasureMicroseconds([&texts, &found, pattern]() {
+            found = 0;
+            for (const auto &text : texts) {
+                found += FindSubstring(text, pattern) != string_view::npos ? 1 : 0;
+            }
+        });
+        ASSERT_EQ(expected, found) << pattern;
+        cout << "Contains '" << pattern << "' on " << nodeCount << " texts of " << textLength << " bytes, ";
+        cout << expected << " matched: std::string::find " << stdFindCost << "us, " << GetSubstringKernelName();
+        cout << " kernel " << kernelCost << "us" << endl;
+    }
+}
+
+TEST(BenchmarkTest, fuzzySelectionCost)
+{
+    // settings-like layout, each item is a short label with a distinct suffix
+    static constexpr uint32_t itemCount = 5000;
+    static constexpr uint32_t maxDistance = 2;
+    const vector<string> words = {"Display", "Sound", "Network", "Battery", "Storage", "Privacy", "Accounts"};
+    auto dom = MakeDomNode("List", "");
+    for (uint32_t index = 0; index < itemCount; index++) {
+        const auto text = words[index % words.size()] + " settings " + to_string(index);
+        dom["children"].push_back(MakeDomNode("Text", text));
+    }
+    WidgetTree tree("");
+    tree.ConstructFromDom(dom, false);
+    const string testValue = "Storage setting 4";
+    size_t expected = 0;
+    const auto dynamicCost = MeasureMicroseconds([&tree, &expected, &testValue]() {
+        expected = 0;
+        for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+            const auto text = tree.GetWidgetByDfsIndex(index).GetAttr("text", "");
+            expected += ComputeEditDistance(testValue, text) <= maxDistance ? 1 : 0;
+        }
+    });
+    size_t found = 0;
+    const auto kernelCost = MeasureMicroseconds([&tree, &found, &testValue]() {
+        const auto pattern = EditDistancePattern(testValue, maxDistance);
+        found = 0;
+        string_view text;
+        string buffer;
+        for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+            const auto &widget = tree.GetWidgetByDfsIndex(index);
+            found += widget.GetAttrView("text", buffer, text) && pattern.Matches(text) ? 1 : 0;
+        }
+    });
+    // the first selection on a new snapshot, ranked by distance
+    WidgetTree snapshot("");
+    snapshot.ConstructFromDom(dom, false);
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher("text", testValue, FUZZY, maxDistance));
+    vector<reference_wrapper<const Widget>> selected;
+    const auto start = GetCurrentMicroseconds();
+    selector.Select(snapshot, selected, 1);
+    const auto selectCost = GetCurrentMicroseconds() - start;
+    ASSERT_EQ(expected, found);
+    ASSERT_EQ(1U, selected.size());
+    ASSERT_EQ("Storage settings 4", selected.front().get().GetAttr("text", ""));
+    cout << "Fuzzy '" << testValue << "' within " << maxDistance << " on " << tree.GetWidgetCount() << " nodes, ";
+    cout << expected << " matched: dynamic programming " << dynamicCost << "us, bit-parallel " << kernelCost;
+    cout << "us, selection " << selectCost << "us" << endl;
+    ASSERT_LT(kernelCost, dynamicCost);
+}
+
+TEST(BenchmarkTest, locatorSelectionCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    ApiCallErr error(NO_ERROR);
+    WidgetSelector front;
+    front.AddMatcher(WidgetAttrMatcher("text", "Contact 100", EQ));
+    WidgetSelector rear;
+    rear.AddMatcher(WidgetAttrMatcher("text", "Contact 1900", EQ));
+    WidgetSelector selector;
+    selector.AddMatcher(WidgetAttrMatcher("type", "Text", EQ));
+    selector.AddFrontLocator(front, error);
+    selector.AddRearLocator(rear, error);
+    vector<reference_wrapper<const Widget>> found;
+    const auto cost = MeasureMicroseconds([&tree, &selector, &found]() {
+        WidgetSelector::ResetSelectionCache(); // measure the evaluation rather than the memoized results
+        found.clear();
+        selector.Select(tree, found);
+    });
+    // the 'Mobile' text of item 100, and both texts of the items in [101, 1900)
+    ASSERT_EQ(1U + (1900 - 101) * 2, found.size());
+    ASSERT_EQ("Mobile", found.front().get().GetAttr("text", ""));
+    ASSERT_EQ("Mobile", found.back().get().GetAttr("text", ""));
+    cout << "Select with locators on " << tree.GetWidgetCount() << " nodes: " << cost << "us" << endl;
+    // locators are evaluated by one sweep per direction, rather than one traversal per candidate
+    static constexpr uint64_t costLimitUs = 50000;
+    ASSERT_LT(cost, costLimitUs);
+}
+
+TEST(BenchmarkTest, repeatedSelectionCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    WidgetSelector selector;
+    selector.AddMatcher(WidgetAttrMatcher("type", "Text", EQ));
+    selector.AddMatcher(WidgetAttrMatcher("text", "Contact 1", STARTS_WITH));
+    vector<reference_wrapper<const Widget>> found;
+    const auto firstCost = MeasureMicroseconds([&tree, &selector, &found]() {
+        WidgetSelector::ResetSelectionCache();
+        found.clear();
+        selector.Select(tree, found);
+    });
+    const auto expected = found.size();
+    const auto repeatCost = MeasureMicroseconds([&tree, &selector, &found]() {
+        found.clear();
+        selector.Select(tree, found);
+    });
+    const auto stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(expected, found.size());
+    // the timings are informative only, the cache is checked by its counters: the last measured first selection
+    // misses, then every repeated one is served from the cache
+    ASSERT_EQ(1U, stats.misses_);
+    ASSERT_EQ(BENCHMARK_ROUNDS, stats.hits_);
+    cout << "Select " << expected << " of " << tree.GetWidgetCount() << " nodes: first " << firstCost;
+    cout << "us, repeated on the same snapshot " << repeatCost << "us, hit rate " << stats.GetHitRate() << endl;
+}
+
+TEST(BenchmarkTest, sharedPredicateSelectionCost)
+{
+    static constexpr uint32_t itemCount = 2000;
+    static constexpr uint32_t selectorCount = 50;
+    WidgetTree tree("");
+    tree.ConstructFromDom(MakeLayoutDom(itemCount), false);
+    // data-driven selectors sharing the type and flag predicates, each with its own text predicate
+    vector<vector<WidgetAttrMatcher>> selectors;
+    for (uint32_t index = 0; index < selectorCount; index++) {
+        selectors.push_back({WidgetAttrMatcher("type", "Text", EQ), WidgetAttrMatcher("enabled", "true", EQ),
+                             WidgetAttrMatcher("text", "Contact " + to_string(index * 3), STARTS_WITH)});
+    }
+    size_t expectedCount = 0;
+    const auto traverseCost = MeasureMicroseconds([&tree, &selectors, &expectedCount]() {
+        for (auto &matchers : selectors) {
+            const auto all = All(matchers);
+            vector<reference_wrapper<const Widget>> found;
+            MatchedWidgetCollector collector(all, found);
+            tree.DfsTraverse(collector);
+            expectedCount += found.size();
+        }
+    });
+    size_t count = 0;
+    const auto bitsCost = MeasureMicroseconds([&tree, &selectors, &count]() {
+        for (auto &matchers : selectors) {
+            vector<reference_wrapper<const Widget>> found;
+            SelectorPlan(matchers).Select(tree, found);
+            count += found.size();
+        }
+    });
+    ASSERT_EQ(expectedCount, count);
+    cout << selectorCount << " selectors on " << tree.GetWidgetCount() << " nodes: traverse " << traverseCost;
+    cout << "us, match sets " << bitsCost << "us" << endl;
+}
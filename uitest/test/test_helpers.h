@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021-2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "json.hpp"
+
+// fixtures shared by the test targets
+namespace OHOS::uitest {
+    /**Build dom like the dumped layouts, which is a list of items each holding an image and two texts.*/
+    inline nlohmann::json MakeLayoutDom(uint32_t itemCount)
+    {
+        auto makeNode = [](uint32_t id, std::string_view type, std::string_view text, int32_t top, int32_t height) {
+            nlohmann::json node;
+            auto &attributes = node["attributes"];
+            attributes["id"] = std::to_string(id);
+            attributes["type"] = type;
+            attributes["text"] = text;
+            attributes["key"] = "";
+            std::stringstream bounds;
+            bounds << "[0," << top << "][1080," << (top + height) << "]";
+            attributes["bounds"] = bounds.str();
+            for (auto flag : {"enabled", "focused", "selected", "checkable", "checked", "clickable", "longClickable",
+                              "scrollable"}) {
+                attributes[flag] = std::string(flag) == "enabled" ? "true" : "false";
+            }
+            node["children"] = nlohmann::json::array();
+            return node;
+        };
+        static constexpr int32_t itemHeight = 120;
+        uint32_t id = 0;
+        auto list = makeNode(id++, "List", "", 0, itemCount * itemHeight);
+        for (uint32_t index = 0; index < itemCount; index++) {
+            const int32_t top = index * itemHeight;
+            auto item = makeNode(id++, "ListItem", "", top, itemHeight);
+            item["children"].push_back(makeNode(id++, "Image", "", top, itemHeight));
+            item["children"].push_back(makeNode(id++, "Text", "Contact " + std::to_string(index), top,
+                                                itemHeight / 2));
+            item["children"].push_back(makeNode(id++, "Text", "Mobile", top + itemHeight / 2, itemHeight / 2));
+            list["children"].push_back(std::move(item));
+        }
+        return list;
+    }
+
+    /**Reference edit distance by dynamic programming over the characters, which are bytes or decoded UTF-8 ones.*/
+    template<typename CharT>
+    uint32_t ComputeEditDistance(const std::basic_string<CharT> &a, const std::basic_string<CharT> &b)
+    {
+        std::vector<uint32_t> previous(b.length() + 1);
+        std::vector<uint32_t> current(b.length() + 1);
+        for (size_t col = 0; col <= b.length(); col++) {
+            previous[col] = col;
+        }
+        for (size_t row = 1; row <= a.length(); row++) {
+            current[0] = row;
+            for (size_t col = 1; col <= b.length(); col++) {
+                const uint32_t substitution = previous[col - 1] + (a[row - 1] == b[col - 1] ? 0 : 1);
+                current[col] = std::min({previous[col] + 1, current[col - 1] + 1, substitution});
+            }
+            std::swap(previous, current);
+        }
+        return previous[b.length()];
+    }
+}
+
+#endif
@@ -12,6 +12,8 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstring>
+#include <fstream>
 #include "gtest/gtest.h"
 #include "ui_model.h"
 
@@ -111,6 +113,51 @@ TEST(UiModelTest, testWidgetAttributes)
  * its hosting tree. We must ensure that the move-created widget be same as the
  * moved one (No any attribute/filed should be lost during moving).
  * */
+TEST(UiModelTest, testWidgetTypedAttributes)
+{
+    Widget widget("hierarchy");
+    widget.SetAttr("clickable", "true");
+    widget.SetAttr("enabled", "false");
+    widget.SetAttr(ATTR_ID, "-12");
+    widget.SetAttr("type", "Button");
+    ASSERT_TRUE(widget.GetBoolAttr(UiAttr::CLICKABLE));
+    ASSERT_FALSE(widget.GetBoolAttr(UiAttr::ENABLED));
+    ASSERT_FALSE(widget.GetBoolAttr(UiAttr::CHECKED));
+    ASSERT_TRUE(widget.HasAttr("enabled"));
+    ASSERT_FALSE(widget.HasAttr("checked"));
+    ASSERT_EQ("true", widget.GetAttr("clickable", ""));
+    ASSERT_EQ("false", widget.GetAttr("enabled", ""));
+    ASSERT_EQ("-12", widget.GetAttr(ATTR_ID, ""));
+    ASSERT_EQ("Button", widget.GetStrAttr(UiAttr::TYPE));
+    ASSERT_EQ("", widget.GetStrAttr(UiAttr::KEY));
+    // values which cannot be held by the typed slot should be kept verbatim
+    widget.SetAttr(ATTR_ID, "007");
+    widget.SetAttr("checked", "yes");
+    ASSERT_EQ("007", widget.GetAttr(ATTR_ID, ""));
+    ASSERT_EQ("yes", widget.GetAttr("checked", ""));
+    ASSERT_FALSE(widget.GetBoolAttr(UiAttr::CHECKED));
+    // set back to typed value
+    widget.SetAttr(ATTR_ID, "7");
+    ASSERT_EQ("7", widget.GetAttr(ATTR_ID, ""));
+    // custom attributes
+    widget.SetAttr("hashcode", "abc");
+    ASSERT_TRUE(widget.HasAttr("hashcode"));
+    ASSERT_EQ("abc", widget.GetAttr("hashcode", ""));
+    // bounds are rendered on demand
+    ASSERT_FALSE(widget.HasAttr("bounds"));
+    widget.SetBounds(1, 2, 3, 4);
+    ASSERT_TRUE(widget.HasAttr("bounds"));
+    auto boundsJson = nlohmann::json::parse(widget.GetAttr("bounds", ""));
+    ASSERT_EQ(1, boundsJson["leftX"].get<int32_t>());
+    ASSERT_EQ(4, boundsJson["bottomY"].get<int32_t>());
+    map<string, string> dump;
+    widget.DumpAttributes(dump);
+    ASSERT_EQ("true", dump["clickable"]);
+    ASSERT_EQ("7", dump[ATTR_ID]);
+    ASSERT_EQ("abc", dump["hashcode"]);
+    ASSERT_EQ("hierarchy", dump["hierarchy"]);
+}
+
 TEST(UiModelTest, testWidgetSafeMovable)
 {
     Widget widget("hierarchy");
@@ -257,6 +304,33 @@ TEST(UiModelTest, testGetRelativeNode)
     ASSERT_TRUE(tree.GetChildWidget(*rootPtr, 2) == nullptr) << "Unexpected child not";
 }
 
+TEST(UiModelTest, testWidgetHierarchyOnTree)
+{
+    auto dom = nlohmann::json::parse(DOM_TEXT);
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+
+    auto rootPtr = tree.GetRootWidget();
+    ASSERT_TRUE(rootPtr != nullptr) << "Failed to get root node";
+    ASSERT_EQ("ROOT", rootPtr->GetHierarchy());
+    ASSERT_EQ("ROOT", rootPtr->GetAttr(ATTR_HIERARCHY, ""));
+    auto child1Ptr = tree.GetChildWidget(*rootPtr, 1);
+    ASSERT_TRUE(child1Ptr != nullptr);
+    auto grandChildPtr = tree.GetChildWidget(*child1Ptr, 0);
+    ASSERT_TRUE(grandChildPtr != nullptr);
+    ASSERT_EQ("ROOT,1,0", grandChildPtr->GetHierarchy());
+    ASSERT_EQ("id010", grandChildPtr->GetAttr("resource-id", ""));
+    // lookup widgets by hierarchy
+    ASSERT_EQ(rootPtr, tree.GetWidgetByHierarchy("ROOT"));
+    ASSERT_EQ(grandChildPtr, tree.GetWidgetByHierarchy("ROOT,1,0"));
+    ASSERT_EQ(nullptr, tree.GetWidgetByHierarchy("ROOT,1,1"));
+    ASSERT_EQ(nullptr, tree.GetWidgetByHierarchy("ROOT,10"));
+    ASSERT_EQ(nullptr, tree.GetWidgetByHierarchy("ROOT,"));
+    ASSERT_EQ(nullptr, tree.GetWidgetByHierarchy("ROOT,a"));
+    ASSERT_EQ(nullptr, tree.GetWidgetByHierarchy("NODE,1"));
+    ASSERT_EQ(6U, tree.GetWidgetCount());
+}
+
 TEST(UiModelTest, testVisitNodesInGivenRoot)
 {
     auto dom = nlohmann::json::parse(DOM_TEXT);
@@ -370,4 +444,484 @@ TEST(UiModelTest, testMarshalIntoDom)
     auto dom1 = nlohmann::json();
     tree.MarshalIntoDom(dom1);
     ASSERT_FALSE(dom1.empty());
-}
\ No newline at end of file
+}
+TEST(UiModelTest, testConstructWidgetsFromLayout)
+{
+    WidgetTree tree("tree");
+    ASSERT_TRUE(tree.ConstructFromLayout(DOM_TEXT, false));
+    WidgetAttrVisitor visitor("resource-id");
+    tree.DfsTraverse(visitor);
+    // should be same as the tree constructed from dom
+    ASSERT_EQ("id0,id00,id000,id0000,id01,id010", visitor.attrValueSequence_.str()) << "Incorrect node order";
+    auto grandChildPtr = tree.GetWidgetByHierarchy("ROOT,1,0");
+    ASSERT_TRUE(grandChildPtr != nullptr);
+    ASSERT_EQ("id010", grandChildPtr->GetAttr("resource-id", ""));
+    // non-string attribute values are kept as json text, irrelevant objects are ignored
+    WidgetTree tree1("tree1");
+    constexpr string_view layout = R"({"attributes":{"bounds":"[0,-50][100,200]","id":12,"enabled":true,
+"extra":{"text":"wyz"}},"children":[],"extra":{"attributes":{"text":"abc"},"children":[{}]}})";
+    ASSERT_TRUE(tree1.ConstructFromLayout(layout, false));
+    ASSERT_EQ(1U, tree1.GetWidgetCount());
+    auto rootPtr = tree1.GetRootWidget();
+    ASSERT_EQ("12", rootPtr->GetAttr(ATTR_ID, ""));
+    ASSERT_TRUE(rootPtr->GetBoolAttr(UiAttr::ENABLED));
+    ASSERT_FALSE(rootPtr->HasAttr(ATTR_TEXT));
+    ASSERT_EQ(-50, rootPtr->GetBounds().top_);
+    // illegal json
+    WidgetTree tree2("tree2");
+    ASSERT_FALSE(tree2.ConstructFromLayout(R"({"attributes":{"text":"wyz"},"children":[)", false));
+}
+
+TEST(UiModelTest, testConstructWidgetsFromSource)
+{
+    auto source = [](WidgetTreeBuilder &builder) {
+        builder.BeginNode();
+        builder.Attr(ATTR_TEXT, "root");
+        builder.Bounds(Rect(0, 100, 0, 100));
+        builder.BeginNode();
+        builder.Attr(ATTR_TEXT, "invisible");
+        builder.Bounds(Rect(0, 100, 200, 300));
+        builder.BeginNode(); // descendant of discarded node
+        builder.Attr(ATTR_TEXT, "child_of_invisible");
+        builder.Bounds(Rect(0, 100, 0, 100));
+        builder.EndNode();
+        builder.EndNode();
+        builder.BeginNode();
+        builder.Attr(ATTR_TEXT, "visible");
+        builder.Bounds(Rect(0, 100, 50, 150));
+        builder.EndNode();
+        builder.EndNode();
+    };
+    WidgetTree tree("tree");
+    tree.ConstructFromSource(source, true);
+    WidgetAttrVisitor visitor(ATTR_TEXT);
+    tree.DfsTraverse(visitor);
+    ASSERT_EQ("root,visible", visitor.attrValueSequence_.str());
+    auto visiblePtr = tree.GetWidgetByHierarchy("ROOT,1");
+    ASSERT_TRUE(visiblePtr != nullptr);
+    ASSERT_EQ(100, visiblePtr->GetBounds().bottom_); // amended by parent bounds
+}
+
+TEST(UiModelTest, testVisitAncestorNodes)
+{
+    auto dom = nlohmann::json::parse(DOM_TEXT);
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+
+    auto widgetPtr = tree.GetWidgetByHierarchy("ROOT,0,0,0");
+    ASSERT_TRUE(widgetPtr != nullptr);
+    WidgetAttrVisitor attrVisitor("resource-id");
+    tree.DfsTraverseAncestors(attrVisitor, *widgetPtr);
+    ASSERT_EQ("id0,id00,id000", attrVisitor.attrValueSequence_.str()) << "Incorrect text sequence of ancestors";
+    WidgetAttrVisitor rootVisitor("resource-id");
+    tree.DfsTraverseAncestors(rootVisitor, *tree.GetRootWidget());
+    ASSERT_EQ("", rootVisitor.attrValueSequence_.str()) << "Root node should have no ancestors";
+}
+
+TEST(UiModelTest, testDfsIntervalContainment)
+{
+    // root node with 11 children, the subtree of 'ROOT,1' should not contain 'ROOT,10'
+    auto dom = nlohmann::json::parse(R"({"attributes":{"text":"root"},"children":[]})");
+    for (auto index = 0; index <= 10; index++) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = to_string(index);
+        child["children"] = nlohmann::json::array();
+        dom["children"].push_back(child);
+    }
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+    auto rootPtr = tree.GetRootWidget();
+    auto child1Ptr = tree.GetWidgetByHierarchy("ROOT,1");
+    auto child10Ptr = tree.GetWidgetByHierarchy("ROOT,10");
+    ASSERT_TRUE(child1Ptr != nullptr && child10Ptr != nullptr);
+    ASSERT_TRUE(tree.IsDescendantOf(*child10Ptr, *rootPtr));
+    ASSERT_FALSE(tree.IsDescendantOf(*child10Ptr, *child1Ptr));
+    ASSERT_FALSE(tree.IsDescendantOf(*rootPtr, *rootPtr));
+    WidgetAttrVisitor attrVisitor(ATTR_TEXT);
+    tree.DfsTraverseDescendants(attrVisitor, *child1Ptr);
+    ASSERT_EQ("1", attrVisitor.attrValueSequence_.str());
+    uint32_t enter = 0;
+    uint32_t exit = 0;
+    tree.GetDfsInterval(*rootPtr, enter, exit);
+    ASSERT_EQ(0U, enter);
+    ASSERT_EQ(12U, exit);
+    tree.GetDfsInterval(*child10Ptr, enter, exit);
+    ASSERT_EQ(11U, enter);
+    ASSERT_EQ(12U, exit);
+}
+
+TEST(UiModelTest, testSpatialIndexQueries)
+{
+    // a screen-sized background covered by 40*40 cells, check the index results against brute-force search
+    vector<Rect> rects = {Rect(0, 400, 0, 400)};
+    for (auto row = 0; row < 40; row++) {
+        for (auto col = 0; col < 40; col++) {
+            rects.emplace_back(Rect(col * 10, col * 10 + 8, row * 10, row * 10 + 8));
+        }
+    }
+    SpatialIndex index(rects);
+    const vector<Point> points = {{0, 0}, {5, 5}, {9, 9}, {123, 356}, {399, 399}, {400, 400}, {-50, 200}};
+    for (auto &point : points) {
+        vector<uint32_t> expected;
+        for (uint32_t id = 0; id < rects.size(); id++) {
+            auto &rect = rects[id];
+            auto inX = point.px_ >= rect.left_ && point.px_ < rect.right_;
+            if (inX && point.py_ >= rect.top_ && point.py_ < rect.bottom_) {
+                expected.emplace_back(id);
+            }
+        }
+        vector<uint32_t> actual;
+        index.QueryPoint(point, actual);
+        ASSERT_EQ(expected, actual);
+    }
+    vector<uint32_t> overlapped;
+    index.QueryRect(Rect(15, 25, 5, 12), overlapped);
+    ASSERT_EQ(vector<uint32_t>({0, 2, 3, 42, 43}), overlapped);
+    // nearest odd-id cell from a point in the gap between cells
+    uint32_t nearest = 0;
+    auto oddCell = [](uint32_t id) { return id % 2 == 1; };
+    ASSERT_TRUE(index.QueryNearest(Point(129, 131), oddCell, nearest));
+    ASSERT_EQ(13U * 40 + 12 + 1, nearest);
+    ASSERT_FALSE(index.QueryNearest(Point(0, 0), [](uint32_t id) { return false; }, nearest));
+    vector<uint32_t> none;
+    SpatialIndex(vector<Rect>()).QueryPoint(Point(0, 0), none);
+    ASSERT_TRUE(none.empty());
+}
+
+TEST(UiModelTest, testGetWidgetsByPosition)
+{
+    constexpr string_view domText = R"(
+{"attributes": {"id": "0","bounds": "[0,0][100,100]"},
+"children": [
+{"attributes": {"id": "1","bounds": "[10,10][30,30]","clickable": "true"}, "children": []},
+{"attributes": {"id": "2","bounds": "[50,50][90,90]","clickable": "false"},
+"children": [ {"attributes": {"id": "3","bounds": "[60,60][70,70]","clickable": "true"}, "children": []} ]
+}
+]
+})";
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(nlohmann::json::parse(domText), true);
+    auto widgetPtr = tree.GetWidgetAt(Point(65, 65));
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("3", widgetPtr->GetAttr(ATTR_ID, ""));
+    widgetPtr = tree.GetWidgetAt(Point(55, 80));
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("2", widgetPtr->GetAttr(ATTR_ID, ""));
+    widgetPtr = tree.GetWidgetAt(Point(40, 40));
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("0", widgetPtr->GetAttr(ATTR_ID, ""));
+    ASSERT_TRUE(tree.GetWidgetAt(Point(100, 100)) == nullptr);
+
+    auto clickable = [](const Widget &widget) { return widget.GetBoolAttr(UiAttr::CLICKABLE); };
+    widgetPtr = tree.GetNearestWidget(Point(40, 40), clickable);
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("1", widgetPtr->GetAttr(ATTR_ID, ""));
+    widgetPtr = tree.GetNearestWidget(Point(95, 95), clickable);
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("3", widgetPtr->GetAttr(ATTR_ID, ""));
+    // the topmost one wins the ties
+    widgetPtr = tree.GetNearestWidget(Point(65, 65), [](const Widget &widget) { return true; });
+    ASSERT_TRUE(widgetPtr != nullptr);
+    ASSERT_EQ("3", widgetPtr->GetAttr(ATTR_ID, ""));
+}
+
+TEST(UiModelTest, testSubtreeHashAndChanges)
+{
+    constexpr string_view domText0 = R"(
+{"attributes": {"type": "List", "id": "0"}, "children": [
+{"attributes": {"type": "Item", "text": "a", "id": "1"}, "children": [
+{"attributes": {"type": "Text", "text": "a0", "id": "2"}, "children": []}]},
+{"attributes": {"type": "Item", "text": "b", "id": "3"}, "children": [
+{"attributes": {"type": "Text", "text": "b0", "id": "4"}, "children": []}]}
+]})";
+    // same contents with different ids and another text
+    constexpr string_view domText1 = R"(
+{"attributes": {"type": "List", "id": "10"}, "children": [
+{"attributes": {"type": "Item", "text": "a", "id": "11"}, "children": [
+{"attributes": {"type": "Text", "text": "a0", "id": "12"}, "children": []}]},
+{"attributes": {"type": "Item", "text": "b", "id": "13"}, "children": [
+{"attributes": {"type": "Text", "text": "b1", "id": "14"}, "children": []}]}
+]})";
+    WidgetTree tree0("tree0");
+    tree0.ConstructFromDom(nlohmann::json::parse(domText0), false);
+    WidgetTree tree1("tree1");
+    tree1.ConstructFromDom(nlohmann::json::parse(domText1), false);
+    auto root0 = tree0.GetRootWidget();
+    auto root1 = tree1.GetRootWidget();
+    ASSERT_NE(tree0.GetSubtreeHash(*root0), tree1.GetSubtreeHash(*root1));
+    ASSERT_EQ(tree0.GetSubtreeHash(*tree0.GetWidgetById(1)), tree1.GetSubtreeHash(*tree1.GetWidgetById(11)));
+    ASSERT_NE(tree0.GetSubtreeHash(*tree0.GetWidgetById(3)), tree1.GetSubtreeHash(*tree1.GetWidgetById(13)));
+    // the same widget contents in another structure
+    ASSERT_NE(tree0.GetSubtreeHash(*tree0.GetWidgetById(1)), tree0.GetSubtreeHash(*tree0.GetWidgetById(2)));
+
+    vector<const Widget *> changed;
+    tree1.CollectChangedSubtrees(*root1, tree0, *root0, changed);
+    ASSERT_EQ(1U, changed.size());
+    ASSERT_EQ(14, changed.at(0)->GetIntAttr(UiAttr::ID));
+    changed.clear();
+    tree0.CollectChangedSubtrees(*root0, tree0, *root0, changed);
+    ASSERT_TRUE(changed.empty());
+    // children count changed
+    WidgetTree tree2("tree2");
+    tree2.ConstructFromDom(nlohmann::json::parse(R"({"attributes": {"type": "List"}, "children": []})"), false);
+    tree2.CollectChangedSubtrees(*tree2.GetRootWidget(), tree0, *root0, changed);
+    ASSERT_EQ(1U, changed.size());
+    ASSERT_EQ(tree2.GetRootWidget(), changed.at(0));
+}
+
+static nlohmann::json MakeListItem(const string &text, uint32_t childCount)
+{
+    auto item = nlohmann::json();
+    item["attributes"]["text"] = text;
+    item["attributes"]["bounds"] = "[0,0][100,100]";
+    item["children"] = nlohmann::json::array();
+    for (uint32_t index = 0; index < childCount; index++) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = text + "_" + to_string(index);
+        child["attributes"]["bounds"] = "[0,0][50,50]";
+        child["children"] = nlohmann::json::array();
+        item["children"].emplace_back(child);
+    }
+    return item;
+}
+
+TEST(UiModelTest, testConstructFromBaseSharesUnchangedNodes)
+{
+    // the items span several storage chunks
+    constexpr uint32_t itemCount = 150;
+    constexpr uint32_t changedItem = 70;
+    auto dom = MakeListItem("list", 0);
+    for (uint32_t index = 0; index < itemCount; index++) {
+        dom["children"].emplace_back(MakeListItem("item" + to_string(index), 1));
+    }
+    WidgetTree base("base");
+    base.ConstructFromDom(dom, true);
+    const auto changedHierarchy = "ROOT," + to_string(changedItem);
+    auto refetched = MakeListItem("changed", 1);
+    auto source = [&refetched](const Widget &widget, WidgetTreeBuilder &builder) {
+        builder.AcceptDom(refetched);
+        return true;
+    };
+    for (auto childCount : {1, 3}) {
+        refetched = MakeListItem("changed", childCount);
+        WidgetTree tree("tree");
+        ASSERT_TRUE(tree.ConstructFromBase(base, {base.GetWidgetByHierarchy(changedHierarchy)}, source, true));
+        // same as the tree constructed from scratch
+        auto expectedDom = dom;
+        expectedDom["children"][changedItem] = refetched;
+        WidgetTree expected("expected");
+        expected.ConstructFromDom(expectedDom, true);
+        auto expectedJson = nlohmann::json();
+        expected.MarshalIntoDom(expectedJson);
+        auto actualJson = nlohmann::json();
+        tree.MarshalIntoDom(actualJson);
+        ASSERT_EQ(expectedJson.dump(), actualJson.dump());
+        ASSERT_EQ(expected.GetSubtreeHash(*expected.GetRootWidget()), tree.GetSubtreeHash(*tree.GetRootWidget()));
+        ASSERT_EQ("changed_0", tree.GetWidgetByHierarchy(changedHierarchy + ",0")->GetStrAttr(UiAttr::TEXT));
+        // the unchanged nodes far from the refetched one are shared only if the node count is unchanged
+        auto unchanged = tree.GetWidgetByHierarchy("ROOT,140,0");
+        ASSERT_EQ("ROOT,140,0", unchanged->GetHierarchy());
+        ASSERT_EQ(childCount == 1, unchanged == base.GetWidgetByHierarchy("ROOT,140,0"));
+        vector<const Widget *> changed;
+        tree.CollectChangedSubtrees(*tree.GetRootWidget(), base, *base.GetRootWidget(), changed);
+        ASSERT_EQ(1U, changed.size());
+        ASSERT_EQ(changedHierarchy, changed.at(0)->GetHierarchy());
+    }
+}
+
+TEST(UiModelTest, testBinaryLayoutRoundTrip)
+{
+    constexpr string_view domText = R"(
+{"attributes": {"id": "1", "type": "Column", "text": "", "bounds": "[0,0][100,100]", "enabled": "true"},
+"children": [
+{"attributes": {"id": "2", "type": "Text", "text": "USB", "key": "k2", "bounds": "[0,0][50,50]", "custom": "c"},
+"children": []},
+{"attributes": {"id": "3", "type": "Text", "text": "USB", "bounds": "[50,-10][100,100]", "clickable": "true"},
+"children": [{"attributes": {"id": "4", "type": "Image", "bounds": "[50,50][60,60]"}, "children": []}]}
+]})";
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(nlohmann::json::parse(domText), false);
+    string binary;
+    tree.MarshalIntoBinary(binary);
+    auto expected = nlohmann::json();
+    tree.MarshalIntoDom(expected);
+
+    WidgetTree loaded("loaded");
+    ASSERT_TRUE(loaded.ConstructFromBinary(binary));
+    auto actual = nlohmann::json();
+    loaded.MarshalIntoDom(actual);
+    ASSERT_EQ(expected, actual);
+    auto widget = loaded.GetWidgetByHierarchy("ROOT,1,0");
+    ASSERT_TRUE(widget != nullptr);
+    ASSERT_EQ(4, widget->GetIntAttr(UiAttr::ID));
+    ASSERT_EQ(tree.GetSubtreeHash(*tree.GetRootWidget()), loaded.GetSubtreeHash(*loaded.GetRootWidget()));
+
+    // load from file by memory mapping
+    const string path = "/tmp/uitest_binary_layout_test.bin";
+    ofstream fout(path, ios::out | ios::binary);
+    fout << binary;
+    fout.close();
+    auto mapped = make_unique<WidgetTree>("mapped");
+    ASSERT_TRUE(mapped->LoadFromBinaryFile(path));
+    remove(path.c_str());
+    auto mappedDom = nlohmann::json();
+    mapped->MarshalIntoDom(mappedDom);
+    ASSERT_EQ(expected, mappedDom);
+    ASSERT_FALSE(WidgetTree("").LoadFromBinaryFile(path));
+
+    // reject malformed data
+    ASSERT_FALSE(WidgetTree("").ConstructFromBinary(binary.substr(0, binary.size() - 1)));
+    auto badMagic = binary;
+    badMagic[0] = 'X';
+    ASSERT_FALSE(WidgetTree("").ConstructFromBinary(badMagic));
+    // written on a host of the other byte order
+    auto swappedOrder = binary;
+    reverse(swappedOrder.begin() + 4, swappedOrder.begin() + 8);
+    ASSERT_FALSE(WidgetTree("").ConstructFromBinary(swappedOrder));
+    ASSERT_FALSE(WidgetTree("").ConstructFromBinary(""));
+    // the header keeps the attribute count at offset 20, the nodes of 32 bytes are followed by the attribute pairs of 8
+    // bytes and keep the child index at offset 4. Make the second child of the root duplicate the first one's index
+    uint32_t attrCount = 0;
+    memcpy(&attrCount, binary.data() + 20, sizeof(attrCount));
+    auto duplicatedChild = binary;
+    const auto childIndexOffset = binary.size() - attrCount * 8 - 2 * 32 + 4;
+    ASSERT_EQ(1, duplicatedChild[childIndexOffset]);
+    duplicatedChild[childIndexOffset] = 0;
+    ASSERT_FALSE(WidgetTree("").ConstructFromBinary(duplicatedChild));
+}
+
+TEST(UiModelTest, testGetWidgetsByAttrValue)
+{
+    constexpr string_view domText = R"(
+{"attributes": {"id": "1", "text": "a", "clickable": "false"}, "children": [
+{"attributes": {"id": "2", "text": "b", "clickable": "true", "custom": "x"}, "children": [
+{"attributes": {"id": "3", "text": "a", "clickable": "true", "custom": "x"}, "children": []}]},
+{"attributes": {"id": "03", "text": "a", "clickable": "yes"}, "children": []}
+]})";
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(nlohmann::json::parse(domText), false);
+    ASSERT_EQ(vector<uint32_t>({0, 2, 3}), tree.GetWidgetsByAttrValue("text", "a"));
+    ASSERT_EQ(vector<uint32_t>({1, 2}), tree.GetWidgetsByAttrValue("clickable", "true"));
+    ASSERT_EQ(vector<uint32_t>({3}), tree.GetWidgetsByAttrValue("clickable", "yes"));
+    ASSERT_EQ(vector<uint32_t>({2}), tree.GetWidgetsByAttrValue("id", "3"));
+    ASSERT_EQ(vector<uint32_t>({3}), tree.GetWidgetsByAttrValue("id", "03"));
+    ASSERT_EQ(vector<uint32_t>({1, 2}), tree.GetWidgetsByAttrValue("custom", "x"));
+    ASSERT_TRUE(tree.GetWidgetsByAttrValue("text", "c").empty());
+    ASSERT_TRUE(tree.GetWidgetsByAttrValue("key", "").empty());
+    ASSERT_EQ("b", tree.GetWidgetByDfsIndex(1).GetAttr("text", ""));
+}
+
+TEST(UiModelTest, testGetWidgetsByAttrMatch)
+{
+    auto dom = nlohmann::json::parse(R"({"attributes": {"text": "root"}, "children": []})");
+    const vector<string> texts = {"", "abc", "abcabc", "xabcx", "cab", "ab", "bcab", "abab", "ba", "hello world"};
+    for (auto &text : texts) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = text;
+        child["children"] = nlohmann::json::array();
+        dom["children"].push_back(child);
+    }
+    // a widget without text attribute never matches
+    dom["children"].push_back(nlohmann::json::parse(R"({"attributes": {"key": "abc"}, "children": []})"));
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+    const vector<string> testValues = {"", "a", "ab", "abc", "bca", "cab", "abab", "abcabcabc", "ld", "o w", "zzz"};
+    auto matches = [](const string &value, const string &testValue, ValueMatchRule rule) {
+        const auto pos = value.find(testValue);
+        const auto rpos = value.rfind(testValue);
+        switch (rule) {
+            case EQ:
+                return value == testValue;
+            case CONTAINS:
+                return pos != string::npos;
+            case STARTS_WITH:
+                return pos == 0;
+            default:
+                return rpos != string::npos && rpos + testValue.length() == value.length();
+        }
+    };
+    for (auto rule : {EQ, CONTAINS, STARTS_WITH, ENDS_WITH}) {
+        for (auto &testValue : testValues) {
+            vector<uint32_t> expected;
+            for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+                const auto &widget = tree.GetWidgetByDfsIndex(index);
+                if (widget.HasAttr("text") && matches(widget.GetAttr("text", ""), testValue, rule)) {
+                    expected.emplace_back(index);
+                }
+            }
+            vector<uint32_t> actual;
+            tree.GetWidgetsByAttrMatch("text", testValue, rule, actual);
+            ASSERT_EQ(expected, actual) << "rule=" << rule << ", testValue='" << testValue << "'";
+        }
+    }
+}
+
+TEST(UiModelTest, testFoldValue)
+{
+    string folded;
+    FoldValue("  Hello \t\n WORLD  ", NORMALIZE_WHITESPACE, folded);
+    ASSERT_EQ("Hello WORLD", folded);
+    FoldValue("  Hello \t\n WORLD  ", IGNORE_CASE, folded);
+    ASSERT_EQ("  hello \t\n world  ", folded);
+    FoldValue("\u3000A\u00a0\u00a0B\u3000", IGNORE_CASE | NORMALIZE_WHITESPACE, folded);
+    ASSERT_EQ("a b", folded);
+    // the 2-byte capitals are lowered in place, the other characters are kept
+    FoldValue("\u00c9T\u00c9 \u00d7 \u0391\u03a9 \u0416\u0401 \u4f60", IGNORE_CASE, folded);
+    ASSERT_EQ("\u00e9t\u00e9 \u00d7 \u03b1\u03c9 \u0436\u0451 \u4f60", folded);
+    FoldValue("", IGNORE_CASE | NORMALIZE_WHITESPACE, folded);
+    ASSERT_EQ("", folded);
+    FoldValue(" \t ", NORMALIZE_WHITESPACE, folded);
+    ASSERT_EQ("", folded);
+}
+
+TEST(UiModelTest, testDfsBitsetOperations)
+{
+    static constexpr uint32_t size = 130;
+    DfsBitset full(size, true);
+    ASSERT_EQ(size, full.Count());
+    DfsBitset odds(size);
+    DfsBitset triples(size);
+    ASSERT_TRUE(odds.IsEmpty());
+    for (uint32_t index = 0; index < size; index++) {
+        if (index % 2 == 1) {
+            odds.Set(index);
+        }
+        if (index % 3 == 0) {
+            triples.Set(index);
+        }
+    }
+    auto bits = odds;
+    bits.And(triples);
+    vector<uint32_t> members;
+    bits.ForEach([&members](uint32_t index) { members.emplace_back(index); });
+    ASSERT_EQ(22U, members.size());
+    for (auto index : members) {
+        ASSERT_TRUE(index % 6 == 3);
+    }
+    bits = odds;
+    bits.Or(triples);
+    ASSERT_EQ(65U + 44 - 22, bits.Count());
+    bits.AndNot(odds);
+    ASSERT_EQ(22U, bits.Count()); // even triples
+    ASSERT_TRUE(bits.Test(0) && bits.Test(126) && !bits.Test(3));
+    uint32_t first = 0;
+    uint32_t last = 0;
+    ASSERT_TRUE(bits.FindFirst(first) && bits.FindLast(last));
+    ASSERT_EQ(0U, first);
+    ASSERT_EQ(126U, last);
+    full.KeepRange(63, 129);
+    ASSERT_EQ(129U - 63, full.Count());
+    ASSERT_TRUE(full.FindFirst(first) && full.FindLast(last));
+    ASSERT_EQ(63U, first);
+    ASSERT_EQ(128U, last);
+    full.KeepRange(64, 64);
+    ASSERT_TRUE(full.IsEmpty());
+    ASSERT_FALSE(full.FindFirst(first) || full.FindLast(last));
+    full.SetRange(3, 5);
+    full.SetRange(60, 200);
+    ASSERT_EQ(2U + 130 - 60, full.Count());
+    ASSERT_TRUE(full.FindFirst(first) && full.FindLast(last));
+    ASSERT_EQ(3U, first);
+    ASSERT_EQ(129U, last);
+    ASSERT_TRUE(!full.Test(5) && !full.Test(59) && full.Test(60) && full.Test(64) && full.Test(128));
+}
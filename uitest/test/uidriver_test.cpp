@@ -18,6 +18,7 @@
 
 using namespace OHOS::uitest;
 using namespace std;
+using namespace nlohmann;
 
 static constexpr auto ATTR_TEXT = "text";
 // record the triggered touch events.
@@ -59,6 +60,33 @@ public:
         }
     }
 
+    /**Set the changed nodes and their subtree layouts reported to the driver, and enable incremental updates.*/
+    void SetNodeChanges(vector<int32_t> ids, map<int32_t, string> subtrees)
+    {
+        changesKnown_ = true;
+        changedNodes_ = move(ids);
+        mockSubtrees_ = move(subtrees);
+    }
+
+    bool CollectChangedNodes(vector<int32_t> &ids) const override
+    {
+        ids = move(changedNodes_);
+        changedNodes_.clear();
+        return changesKnown_;
+    }
+
+    string GetLastSubtreeHierarchy() const
+    {
+        return lastSubtreeHierarchy_;
+    }
+
+    bool GetUiSubtree(int32_t id, string_view hierarchy, WidgetTreeBuilder &builder) const override
+    {
+        lastSubtreeHierarchy_ = hierarchy;
+        auto find = mockSubtrees_.find(id);
+        return find != mockSubtrees_.end() && builder.AcceptLayout(find->second);
+    }
+
     void InjectTouchEventSequence(const vector<TouchEvent> &events) const override
     {
         touch_event_records = events; // copy-construct
@@ -72,6 +100,10 @@ public:
 private:
     vector<string> mockDomFrames_;
     mutable uint32_t frameIndex_ = 0;
+    bool changesKnown_ = false;
+    mutable vector<int32_t> changedNodes_;
+    map<int32_t, string> mockSubtrees_;
+    mutable string lastSubtreeHierarchy_;
 };
 
 // test fixture
@@ -619,4 +651,205 @@ TEST_F(UiDriverTest, updateWidgetImage)
     // we should not be able to refresh WidgetImage on the new UI since its gone (hashcode and attributes changed)
     driver_->UpdateWidgetImage(*images.at(0), error);
     ASSERT_EQ(WIDGET_LOST, error.code_);
-}
\ No newline at end of file
+}
+TEST_F(UiDriverTest, updateUiIncrementally)
+{
+    constexpr auto mockDom = R"({"attributes": {"id": "1", "text": "", "bounds": "[0,0][100,100]"},
+"children": [{"attributes": {"id": "2", "text": "USB", "bounds": "[0,0][50,50]"}, "children": []},
+{"attributes": {"id": "3", "text": "WYZ", "bounds": "[50,50][100,100]"}, "children": []}]})";
+    controller_->SetDomFrame(mockDom);
+    controller_->SetNodeChanges({}, {});
+    auto error = ApiCallErr(NO_ERROR);
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "USB", EQ));
+    vector<unique_ptr<WidgetImage>> images;
+    driver_->FindWidgets(selector, images, error);
+    ASSERT_EQ(1, images.size());
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+    // nothing changed, should not fetch the UI again
+    images.clear();
+    driver_->FindWidgets(selector, images, error);
+    ASSERT_EQ(1, images.size());
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+    // text of node3 changed, should fetch the changed subtree only
+    constexpr auto subtree = R"({"attributes": {"id": "3", "text": "ABC", "bounds": "[50,50][100,100]"}})";
+    controller_->SetNodeChanges({3}, {{3, subtree}});
+    auto selector1 = WidgetSelector();
+    selector1.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "ABC", EQ));
+    images.clear();
+    driver_->FindWidgets(selector1, images, error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    ASSERT_EQ(1, images.size());
+    ASSERT_EQ("ROOT,1", images.at(0)->GetHierarchy());
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+    // the subtree is located by its hierarchy on the last fetched UI
+    ASSERT_EQ("ROOT,1", controller_->GetLastSubtreeHierarchy());
+    // unknown node changed, should fetch the whole UI
+    controller_->SetNodeChanges({4}, {});
+    images.clear();
+    driver_->FindWidgets(selector, images, error);
+    ASSERT_EQ(1, images.size());
+    ASSERT_EQ(2U, controller_->GetConsumedDomFrameCount());
+}
+
+TEST_F(UiDriverTest, updateUiIncrementallyStartsOver)
+{
+    constexpr auto mockDom = R"({"attributes": {"id": "1", "text": "", "bounds": "[0,0][100,100]"},
+"children": [{"attributes": {"id": "2", "text": "00:00", "bounds": "[0,0][50,50]"}, "children": []}]})";
+    controller_->SetDomFrame(mockDom);
+    controller_->SetNodeChanges({}, {});
+    auto error = ApiCallErr(NO_ERROR);
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, ":", CONTAINS));
+    vector<unique_ptr<WidgetImage>> images;
+    driver_->FindWidgets(selector, images, error);
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+    // a clock text keeps changing, each refetched text is kept in the shared string storage
+    uint32_t updates = 0;
+    for (; controller_->GetConsumedDomFrameCount() == 1; updates++) {
+        const auto text = "00:" + to_string(updates);
+        const auto subtree = R"({"attributes": {"id": "2", "text": ")" + text + R"(", "bounds": "[0,0][50,50]"}})";
+        controller_->SetNodeChanges({2}, {{2, subtree}});
+        images.clear();
+        driver_->FindWidgets(selector, images, error);
+        ASSERT_EQ(NO_ERROR, error.code_);
+        ASSERT_EQ(1, images.size());
+        ASSERT_LT(updates, 1000U) << "Incremental updates never start over";
+    }
+    // the whole UI is fetched after the limited count of incremental updates
+    ASSERT_EQ(2U, controller_->GetConsumedDomFrameCount());
+    ASSERT_GT(updates, 1U);
+}
+
+TEST_F(UiDriverTest, updateUiIncrementallyAcrossApiCalls)
+{
+    constexpr auto mockDom = R"({"attributes": {"id": "1", "text": "", "bounds": "[0,0][100,100]"},
+"children": [{"attributes": {"id": "2", "text": "USB", "bounds": "[0,0][50,50]"}, "children": []}]})";
+    controller_->SetDomFrame(mockDom);
+    controller_->SetNodeChanges({}, {});
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "USB", EQ));
+    json caller;
+    driver_->WriteIntoParcel(caller);
+    auto &server = ExternApiServer::Get();
+    for (uint32_t call = 0; call < 2; call++) {
+        auto in = json::array();
+        auto out = json::array();
+        auto error = ApiCallErr(NO_ERROR);
+        PushBackValueItemIntoJson<WidgetSelector>(selector, in);
+        server.Call("UiDriver::FindWidgets", caller, in, out, error);
+        ASSERT_EQ(NO_ERROR, error.code_);
+        ASSERT_EQ(1U, out.size());
+    }
+    // each call works on its own driver, the UI fetched by the first call should be reused by the second one
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+}
+
+TEST_F(UiDriverTest, reuseSelectionsAcrossApiCalls)
+{
+    constexpr auto mockDom = R"({"attributes": {"id": "1", "text": "", "bounds": "[0,0][100,100]"},
+"children": [{"attributes": {"id": "2", "text": "USB", "bounds": "[0,0][50,50]"}, "children": []}]})";
+    controller_->SetDomFrame(mockDom);
+    controller_->SetNodeChanges({}, {});
+    WidgetSelector::ResetSelectionCache();
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "USB", EQ));
+    json caller;
+    driver_->WriteIntoParcel(caller);
+    auto &server = ExternApiServer::Get();
+    constexpr uint32_t calls = 3;
+    for (uint32_t call = 0; call < calls; call++) {
+        auto in = json::array();
+        auto out = json::array();
+        auto error = ApiCallErr(NO_ERROR);
+        PushBackValueItemIntoJson<WidgetSelector>(selector, in);
+        server.Call("UiDriver::FindWidgets", caller, in, out, error);
+        ASSERT_EQ(NO_ERROR, error.code_);
+        ASSERT_EQ(1U, out.size());
+    }
+    // the unchanged UI keeps its snapshot across the calls, so the selection is evaluated by the first call only
+    const auto stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(1U, stats.misses_);
+    ASSERT_EQ(calls - 1, stats.hits_);
+    WidgetSelector::ResetSelectionCache();
+}
+
+TEST_F(UiDriverTest, findWidgetByPosition)
+{
+    constexpr auto mockDom = R"({
+"attributes": {"bounds": "[0,0][100,100]", "hashcode": "1", "clickable": "false"},
+"children": [
+{"attributes": {"bounds": "[10,10][30,30]", "hashcode": "2", "clickable": "true"}, "children": []},
+{"attributes": {"bounds": "[50,50][90,90]", "hashcode": "3", "clickable": "false"}, "children": []}
+]
+})";
+    controller_->SetDomFrame(mockDom);
+
+    auto error = ApiCallErr(NO_ERROR);
+    auto image = driver_->FindWidgetAt(Point(60, 60), error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    ASSERT_TRUE(image != nullptr);
+    ASSERT_EQ("3", image->GetHashCode());
+    ASSERT_EQ("At(60,60)", image->GetSelectionDesc());
+    ASSERT_TRUE(driver_->FindWidgetAt(Point(200, 200), error) == nullptr);
+    // the clickable one is found although another widget is at the point
+    image = driver_->FindNearestClickableWidget(Point(60, 60), error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    ASSERT_TRUE(image != nullptr);
+    ASSERT_EQ("2", image->GetHashCode());
+}
+
+TEST_F(UiDriverTest, takeUiSnapshots)
+{
+    constexpr auto mockDom = R"({"attributes": {"id": "1", "text": "", "bounds": "[0,0][100,100]"},
+"children": [{"attributes": {"id": "2", "text": "USB", "bounds": "[0,0][50,50]"}, "children": []},
+{"attributes": {"id": "3", "text": "WYZ", "bounds": "[50,50][100,100]"}, "children": []}]})";
+    controller_->SetDomFrame(mockDom);
+    controller_->SetNodeChanges({}, {});
+    auto error = ApiCallErr(NO_ERROR);
+    auto snapshot0 = driver_->TakeUiSnapshot(error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    ASSERT_TRUE(snapshot0 != nullptr);
+    // nothing changed, the snapshot is reused
+    auto snapshot1 = driver_->TakeUiSnapshot(error);
+    ASSERT_EQ(snapshot0, snapshot1);
+    // the held snapshot keeps unchanged after the UI changes
+    constexpr auto subtree = R"({"attributes": {"id": "3", "text": "ABC", "bounds": "[50,50][100,100]"}})";
+    controller_->SetNodeChanges({3}, {{3, subtree}});
+    auto snapshot2 = driver_->TakeUiSnapshot(error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    ASSERT_TRUE(snapshot2 != nullptr && snapshot2 != snapshot0);
+    ASSERT_GT(snapshot2->GetGeneration(), snapshot0->GetGeneration());
+    ASSERT_EQ("WYZ", snapshot0->GetWidgetById(3)->GetStrAttr(UiAttr::TEXT));
+    ASSERT_EQ("ABC", snapshot2->GetWidgetById(3)->GetStrAttr(UiAttr::TEXT));
+    ASSERT_EQ("USB", snapshot2->GetWidgetById(2)->GetStrAttr(UiAttr::TEXT));
+}
+
+TEST_F(UiDriverTest, findWidgetsBatch)
+{
+    constexpr auto mockDom0 = R"({"attributes": {"text": "", "hashcode": "1", "bounds": "[0,0][100,100]"},
+"children": [
+{"attributes": {"text": "USB", "hashcode": "2", "clickable": "true", "bounds": "[0,0][50,50]"}, "children": []},
+{"attributes": {"text": "WYZ", "hashcode": "3", "clickable": "true", "bounds": "[50,50][100,100]"}, "children": []}
+]})";
+    constexpr auto mockDom1 = R"({"attributes": {"text": "", "hashcode": "1", "bounds": "[0,0][100,100]"},
+"children": []})";
+    controller_->SetDomFrames({mockDom0, mockDom1});
+    auto error = ApiCallErr(NO_ERROR);
+    vector<WidgetSelector> selectors(INDEX_THREE);
+    selectors[INDEX_ZERO].AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "USB", EQ));
+    selectors[INDEX_ONE].AddMatcher(WidgetAttrMatcher("clickable", "true", EQ));
+    selectors[INDEX_TWO].AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "NONE", EQ));
+    vector<vector<unique_ptr<WidgetImage>>> images;
+    driver_->FindWidgetsBatch(selectors, images, error);
+    ASSERT_EQ(NO_ERROR, error.code_);
+    // all the selectors are evaluated on one snapshot
+    ASSERT_EQ(1U, controller_->GetConsumedDomFrameCount());
+    ASSERT_EQ(INDEX_THREE, images.size());
+    ASSERT_EQ(1, images[INDEX_ZERO].size());
+    ASSERT_EQ("2", images[INDEX_ZERO][0]->GetHashCode());
+    ASSERT_EQ(INDEX_TWO, images[INDEX_ONE].size());
+    ASSERT_EQ("2", images[INDEX_ONE][0]->GetHashCode());
+    ASSERT_EQ("3", images[INDEX_ONE][1]->GetHashCode());
+    ASSERT_TRUE(images[INDEX_TWO].empty());
+}
@@ -14,9 +14,12 @@
  */
 
 #include <extern_api.h>
+#include <regex>
 #include "gtest/gtest.h"
+#include "substring_search.h"
 #include "widget_matcher.h"
 #include "ui_model.h"
+#include "test_helpers.h"
 
 using namespace OHOS::uitest;
 using namespace std;
@@ -62,10 +65,125 @@ TEST(ValueMatcherTest, endsWithMatcher)
     ASSERT_FALSE(matcher.Matches("wyzz"));
 }
 
+TEST(ValueMatcherTest, regexMatcher)
+{
+    // the automaton matches the whole value as std::regex_match does
+    const vector<string> patterns = {
+        "", "abc", "a.c", "a*", "(ab)+c?", "a|bc|", "^(a|b)*abb$", "[a-c]+\\d{2,3}", "[^a-c]*", "\\w+@\\w+\\.com",
+        "(a|ab)(c|bcd)(d*)", "x{3}", "x{2,}", "(a?){3}a{3}", "[.*+]\\.\\s\\S", "\\D\\W", "(?:ab|a)*?b", "[-a]z[b-]",
+        "(a*)*b", ".*error.*|.*fail.*", "[\\]a]+",
+    };
+    const vector<string> values = {
+        "", "a", "abc", "aac", "ac", "abab", "ababc", "bc", "aabb", "babb", "abb", "ab12", "c123", "c1234", "xyz",
+        "dd", "me@host.com", "abcd", "abbcdd", "xxx", "xx", "xxxx", "aaa", "aaaa", "*. x", "1 ", "aab", "-zb",
+        "b", "aaab", "an error here", "it fails", "fine", "]a]", "a\nb",
+    };
+    for (auto &pattern : patterns) {
+        auto matcher = ValueMatcher(pattern, REGEX);
+        const auto expected = regex(pattern);
+        for (auto &value : values) {
+            ASSERT_EQ(regex_match(value, expected), matcher.Matches(value)) << pattern << " on " << value;
+        }
+    }
+    // '.' and the negated classes match one UTF-8 character
+    ASSERT_TRUE(ValueMatcher("\u4f60.", REGEX).Matches("\u4f60\u597d"));
+    ASSERT_TRUE(ValueMatcher("[^a]{2}", REGEX).Matches("\u00e9\u4f60"));
+    ASSERT_TRUE(ValueMatcher("\u4f60+", REGEX).Matches("\u4f60\u4f60"));
+    ASSERT_FALSE(ValueMatcher(".", REGEX).Matches("\u4f60\u597d"));
+    // illegal or unsupported patterns are not compiled and match nothing
+    const auto illegalPatterns = {"(a", "a)", "[a", "*a", "a{2,1}", "a**", "a\\b", "(\\w)\\1", "(?=a)", "a^", "$a",
+                                  "[\\u4f60]"};
+    for (auto pattern : illegalPatterns) {
+        ASSERT_EQ(nullptr, RegexAutomaton::Compile(pattern)) << pattern;
+        ASSERT_FALSE(ValueMatcher(pattern, REGEX).Matches("a")) << pattern;
+    }
+    // the automata are cached by pattern, the exponential state sets fall back to the simulation
+    ASSERT_EQ(RegexAutomaton::Get("a+b"), RegexAutomaton::Get("a+b"));
+    ASSERT_GT(RegexAutomaton::Get("a+b")->GetStateCount(), 0U);
+    const auto exponential = RegexAutomaton::Compile("(a|b)*a(a|b){12}");
+    ASSERT_EQ(0U, exponential->GetStateCount());
+    ASSERT_TRUE(exponential->Matches("bbaabababababab"));
+    ASSERT_FALSE(exponential->Matches("bbbabababababab"));
+    // the compilation work grows quadratically with the optional items, the too costly patterns are rejected
+    ASSERT_EQ(nullptr, RegexAutomaton::Compile("(?:a?a?a?a?a?a?a?a?a?a?){300}"));
+    ASSERT_EQ(nullptr, RegexAutomaton::Compile("(?:a?){1000}"));
+    const auto optionals = RegexAutomaton::Compile("(?:a?){100}b");
+    ASSERT_TRUE(optionals != nullptr && optionals->Matches(string(100, 'a') + "b"));
+    ASSERT_FALSE(optionals->Matches(string(101, 'a') + "b"));
+}
+
+TEST(ValueMatcherTest, substringSearch)
+{
+    // the vectorized kernels agree with std::string_view::find, on the block boundaries and the tails too
+    string text;
+    for (uint32_t index = 0; index < 300; index++) {
+        text.push_back(static_cast<char>('a' + (index * index + index / 7) % 5));
+    }
+    const string_view view(text);
+    for (size_t offset = 0; offset < 40; offset++) {
+        for (size_t length = 0; length + offset <= view.length(); length += 7) {
+            const auto haystack = view.substr(offset, length);
+            for (size_t patternLength = 0; patternLength <= 20; patternLength++) {
+                // occurring patterns at several positions, and a tail pattern which may not occur
+                for (auto patternStart : {size_t(0), length / 2, length - min(length, patternLength)}) {
+                    const auto pattern = view.substr(offset + patternStart, patternLength);
+                    ASSERT_EQ(haystack.find(pattern), FindSubstring(haystack, pattern)) << haystack << " " << pattern;
+                }
+                const auto absent = string(patternLength, 'x');
+                ASSERT_EQ(haystack.find(absent), FindSubstring(haystack, absent));
+            }
+        }
+    }
+    // multibyte characters and the bytes with the high bit set
+    ASSERT_EQ(6U, FindSubstring("\u4f60\u597d\u4e16\u754c", "\u4e16\u754c"));
+    ASSERT_EQ(string_view::npos, FindSubstring("\u4f60\u597d", "\u597e"));
+    cout << "Substring search kernel: " << GetSubstringKernelName() << endl;
+}
+
+TEST(ValueMatcherTest, fuzzyMatcher)
+{
+    // random values over a small alphabet, the long ones span several 64-character blocks
+    const vector<pair<string, char32_t>> alphabet = {{"a", U'a'}, {"b", U'b'}, {"c", U'c'}, {"\u4f60", U'\u4f60'}};
+    uint32_t seed = 1;
+    auto random = [&seed]() { return (seed = seed * 1103515245 + 12345) >> 16; };
+    auto generate = [&alphabet, &random](uint32_t maxLength, string &text, u32string &characters) {
+        text.clear();
+        characters.clear();
+        for (auto length = random() % maxLength; length > 0; length--) {
+            const auto &[utf8, character] = alphabet[random() % alphabet.size()];
+            text.append(utf8);
+            characters.push_back(character);
+        }
+    };
+    string pattern;
+    string value;
+    u32string patternChars;
+    u32string valueChars;
+    for (uint32_t round = 0; round < 3000; round++) {
+        const uint32_t maxLength = round % 4 == 0 ? 150 : 12;
+        generate(maxLength, pattern, patternChars);
+        generate(maxLength, value, valueChars);
+        const auto maxDistance = random() % (round % 4 == 0 ? 40 : 5);
+        const auto expected = min(ComputeEditDistance(patternChars, valueChars), maxDistance + 1);
+        ASSERT_EQ(expected, EditDistancePattern(pattern, maxDistance).Distance(value)) << pattern << " to " << value;
+        ASSERT_EQ(expected <= maxDistance, ValueMatcher(pattern, FUZZY, maxDistance).Matches(value));
+    }
+    ASSERT_TRUE(ValueMatcher("Settings", FUZZY, 1).Matches("Setting"));
+    ASSERT_TRUE(ValueMatcher("Settings", FUZZY, 1).Matches("Setings"));
+    ASSERT_FALSE(ValueMatcher("Settings", FUZZY, 1).Matches("Setup"));
+    ASSERT_TRUE(MatchValue("\u8bbe\u7f6e", "\u8bbe\u7f6e\u9879", FUZZY, 1));
+    ASSERT_TRUE(ValueMatcher("", FUZZY, 2).Matches("ab"));
+    ASSERT_FALSE(ValueMatcher("", FUZZY, 2).Matches("abc"));
+    // the max distance applies to the FUZZY rule only
+    ASSERT_EQ(0U, WidgetAttrMatcher("text", "wyz", EQ, 2).GetMaxDistance());
+    ASSERT_EQ(EditDistancePattern::Get("wyz", 1), EditDistancePattern::Get("wyz", 1));
+    ASSERT_NE(EditDistancePattern::Get("wyz", 1), EditDistancePattern::Get("wyz", 2));
+}
+
 TEST(ValueMatcherTest, matcherDesc)
 {
     const auto testValue = "wyz";
-    const auto rules = {EQ, CONTAINS, STARTS_WITH, ENDS_WITH};
+    const auto rules = {EQ, CONTAINS, STARTS_WITH, ENDS_WITH, REGEX, FUZZY};
     for (auto &rule:rules) {
         auto matcher = ValueMatcher(testValue, rule);
         auto desc = matcher.Describe();
@@ -205,4 +323,214 @@ TEST(WidgetMatcherTest, anyWidgetMatcherDesc)
     ASSERT_TRUE(anyMatcherDesc.find(matcherBDesc) != string::npos);
     // desc should contains the 'AND' operand
     ASSERT_TRUE(anyMatcherDesc.find("OR") != string::npos);
-}
\ No newline at end of file
+}
+TEST(WidgetMatcherTest, selectorPlanMatchesAsAll)
+{
+    // typed, mistyped and custom attribute values
+    vector<map<string, string>> widgetAttrs = {
+        {{"id", "12"}, {"text", "wyz"}, {"type", "Button"}, {"clickable", "true"}},
+        {{"id", "012"}, {"text", "yz"}, {"clickable", "yes"}, {"custom", "wyz"}},
+        {{"id", "-3"}, {"key", "k1"}, {"clickable", "false"}, {"enabled", "true"}},
+        {{"text", ""}, {"custom", "abc"}},
+    };
+    const vector<WidgetAttrMatcher> matchers = {
+        WidgetAttrMatcher("id", "12", EQ), WidgetAttrMatcher("id", "012", EQ), WidgetAttrMatcher("id", "1", CONTAINS),
+        WidgetAttrMatcher("id", "-", STARTS_WITH), WidgetAttrMatcher("text", "yz", ENDS_WITH),
+        WidgetAttrMatcher("text", "", EQ), WidgetAttrMatcher("clickable", "true", EQ),
+        WidgetAttrMatcher("clickable", "e", CONTAINS), WidgetAttrMatcher("clickable", "yes", EQ),
+        WidgetAttrMatcher("custom", "wy", STARTS_WITH), WidgetAttrMatcher("key", "k1", EQ),
+        WidgetAttrMatcher(ATTR_HIERARCHY, "ROOT", EQ),
+    };
+    for (auto &attrs : widgetAttrs) {
+        Widget widget("ROOT");
+        for (auto &[name, value] : attrs) {
+            widget.SetAttr(name, value);
+        }
+        for (size_t first = 0; first < matchers.size(); first++) {
+            for (size_t second = first; second < matchers.size(); second++) {
+                const vector<WidgetAttrMatcher> pair = {matchers[first], matchers[second]};
+                ASSERT_EQ(All(pair).Matches(widget), SelectorPlan(pair).Matches(widget))
+                    << widget.ToStr() << " " << All(pair).Describe();
+            }
+        }
+    }
+}
+
+TEST(WidgetMatcherTest, selectorPlanOrderAndCache)
+{
+    const vector<WidgetAttrMatcher> matchers = {
+        WidgetAttrMatcher("custom", "c", EQ), WidgetAttrMatcher(ATTR_TEXT, "a", CONTAINS),
+        WidgetAttrMatcher(ATTR_TEXT, "b", EQ), WidgetAttrMatcher("enabled", "true", EQ),
+        WidgetAttrMatcher("id", "7", EQ),
+    };
+    auto plan = SelectorPlan::Compile(matchers);
+    ASSERT_EQ("($id = '7') AND ($enabled = 'true') AND ($text = 'b') AND ($text contains 'a') AND ($custom = 'c')",
+              plan->Describe());
+    // same plan for the reordered matchers
+    auto reordered = matchers;
+    reverse(reordered.begin(), reordered.end());
+    ASSERT_EQ(plan, SelectorPlan::Compile(reordered));
+    reordered.pop_back();
+    ASSERT_NE(plan->GetFingerprint(), SelectorPlan::Compile(reordered)->GetFingerprint());
+    // fields are length-prefixed, so they cannot be shifted into each other
+    ASSERT_NE(SelectorPlan::ComputeFingerprint({WidgetAttrMatcher("a", "b;c", EQ)}),
+              SelectorPlan::ComputeFingerprint({WidgetAttrMatcher("a", "b", EQ), WidgetAttrMatcher("c", "", EQ)}));
+    ASSERT_TRUE(SelectorPlan(vector<WidgetAttrMatcher>()).Matches(Widget("")));
+}
+
+TEST(WidgetMatcherTest, selectorPlanSelectByIndex)
+{
+    auto dom = nlohmann::json::parse(R"({"attributes": {"text": "root"}, "children": []})");
+    for (auto index = 0; index < 50; index++) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = to_string(index % 5);
+        child["attributes"]["key"] = to_string(index % 3);
+        child["attributes"]["clickable"] = index % 2 == 0 ? "true" : "false";
+        child["children"] = nlohmann::json::array();
+        dom["children"].push_back(child);
+    }
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+    const vector<vector<WidgetAttrMatcher>> matcherLists = {
+        {WidgetAttrMatcher(ATTR_TEXT, "1", EQ)},
+        {WidgetAttrMatcher(ATTR_TEXT, "1", EQ), WidgetAttrMatcher("key", "2", EQ)},
+        {WidgetAttrMatcher(ATTR_TEXT, "1", EQ), WidgetAttrMatcher("clickable", "true", EQ)},
+        {WidgetAttrMatcher("key", "0", EQ), WidgetAttrMatcher(ATTR_TEXT, "3", ENDS_WITH)},
+        {WidgetAttrMatcher("key", "1", STARTS_WITH)},
+        {WidgetAttrMatcher(ATTR_TEXT, "2", CONTAINS), WidgetAttrMatcher("key", "2", ENDS_WITH)},
+        {WidgetAttrMatcher(ATTR_TEXT, "ro", CONTAINS), WidgetAttrMatcher("clickable", "ru", CONTAINS)},
+        {WidgetAttrMatcher(ATTR_HIERARCHY, "ROOT,7", EQ)},
+        {WidgetAttrMatcher(ATTR_TEXT, "none", EQ), WidgetAttrMatcher("key", "0", EQ)},
+        {WidgetAttrMatcher(ATTR_TEXT, "[13]", REGEX), WidgetAttrMatcher("clickable", "t.*", REGEX)},
+        {WidgetAttrMatcher(ATTR_HIERARCHY, "ROOT,\\d*[05]", REGEX), WidgetAttrMatcher("key", "(", REGEX)},
+        {WidgetAttrMatcher(ATTR_HIERARCHY, "ROOT,\\d*[05]", REGEX)},
+    };
+    for (auto &matchers : matcherLists) {
+        auto allMatcher = All(matchers);
+        vector<reference_wrapper<const Widget>> expected;
+        MatchedWidgetCollector collector(allMatcher, expected);
+        tree.DfsTraverse(collector);
+        vector<reference_wrapper<const Widget>> actual;
+        SelectorPlan(matchers).Select(tree, actual);
+        ASSERT_EQ(expected.size(), actual.size()) << allMatcher.Describe();
+        for (size_t index = 0; index < expected.size(); index++) {
+            ASSERT_EQ(&expected[index].get(), &actual[index].get());
+        }
+    }
+}
+
+TEST(WidgetMatcherTest, foldedMatching)
+{
+    auto dom = nlohmann::json::parse(R"({"attributes": {"text": "root"}, "children": []})");
+    const vector<string> texts = {"Hello World", " hello  world ", "HELLO\tWORLD", "hello world!", "Hello\u00a0World",
+                                  "\u00dcBER \u0421\u0422\u041e\u041f", "\u00fcber \u0441\u0442\u043e\u043f",
+                                  "HelloWorld"};
+    for (auto &text : texts) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = text;
+        child["children"] = nlohmann::json::array();
+        dom["children"].push_back(child);
+    }
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+    const uint8_t both = IGNORE_CASE | NORMALIZE_WHITESPACE;
+    const vector<tuple<WidgetAttrMatcher, size_t>> cases = {
+        {WidgetAttrMatcher(ATTR_TEXT, "hello world", EQ, 0, IGNORE_CASE), 1},
+        {WidgetAttrMatcher(ATTR_TEXT, "Hello World", EQ, 0, NORMALIZE_WHITESPACE), 2},
+        {WidgetAttrMatcher(ATTR_TEXT, "hello world", EQ, 0, both), 4},
+        {WidgetAttrMatcher(ATTR_TEXT, " HELLO   WORLD", EQ, 0, both), 4},
+        {WidgetAttrMatcher(ATTR_TEXT, "o w", CONTAINS, 0, both), 5},
+        {WidgetAttrMatcher(ATTR_TEXT, "HELLO", STARTS_WITH, 0, IGNORE_CASE), 5},
+        {WidgetAttrMatcher(ATTR_TEXT, "\u00fcber \u0441\u0442\u043e\u043f", EQ, 0, IGNORE_CASE), 2},
+        {WidgetAttrMatcher(ATTR_TEXT, "HELLO\\sW\\w+", REGEX, 0, IGNORE_CASE), 2},
+        // the escapes are not folded, '\S' matches the no-break space only
+        {WidgetAttrMatcher(ATTR_TEXT, "hello\\SWORLD", REGEX, 0, IGNORE_CASE), 1},
+        {WidgetAttrMatcher(ATTR_TEXT, "hello word", FUZZY, 1, both), 4},
+    };
+    for (auto &[matcher, expectedCount] : cases) {
+        // the folded value index selects the same widgets as the per-widget folding
+        vector<reference_wrapper<const Widget>> expected;
+        MatchedWidgetCollector collector(matcher, expected);
+        tree.DfsTraverse(collector);
+        vector<reference_wrapper<const Widget>> actual;
+        SelectorPlan({matcher}).Select(tree, actual);
+        ASSERT_EQ(expectedCount, expected.size()) << matcher.Describe();
+        ASSERT_EQ(expected.size(), actual.size()) << matcher.Describe();
+        for (size_t index = 0; index < expected.size(); index++) {
+            ASSERT_EQ(&expected[index].get(), &actual[index].get()) << matcher.Describe();
+        }
+    }
+    // the flags take part in the fingerprint, the description and the serialization
+    const auto plain = WidgetAttrMatcher(ATTR_TEXT, "hello world", EQ);
+    const auto folded = WidgetAttrMatcher(ATTR_TEXT, "hello world", EQ, 0, both);
+    ASSERT_NE(SelectorPlan::ComputeFingerprint({plain}), SelectorPlan::ComputeFingerprint({folded}));
+    ASSERT_TRUE(folded.Describe().find("ignoreCase normalizeWhitespace") != string::npos) << folded.Describe();
+    nlohmann::json data;
+    folded.WriteIntoParcel(data);
+    auto restored = WidgetAttrMatcher(ATTR_TEXT, "", EQ);
+    restored.ReadFromParcel(data);
+    ASSERT_EQ(both, restored.GetMatchFlags());
+    ASSERT_TRUE(restored.Matches(tree.GetWidgetByDfsIndex(3)));
+    ASSERT_TRUE(ValueMatcher("Hello World", EQ, 0, both).Matches("  hello\n world"));
+    ASSERT_FALSE(ValueMatcher("Hello World", EQ).Matches("hello world"));
+}
+
+TEST(WidgetMatcherTest, readIllegalParcel)
+{
+    nlohmann::json data;
+    WidgetAttrMatcher(ATTR_TEXT, "Settings", FUZZY, 1).WriteIntoParcel(data);
+    // the distance is capped, so that the distance bound of the pattern does not wrap
+    data["max_distance"] = UINT32_MAX;
+    auto matcher = WidgetAttrMatcher(ATTR_TEXT, "", EQ);
+    matcher.ReadFromParcel(data);
+    ASSERT_EQ(FUZZY, matcher.GetMatchRule());
+    ASSERT_EQ(MAX_FUZZY_DISTANCE, matcher.GetMaxDistance());
+    // the unknown rule is read as EQ rather than indexing out of the rule tables
+    data["match_rule"] = FUZZY + 1;
+    matcher.ReadFromParcel(data);
+    ASSERT_EQ(EQ, matcher.GetMatchRule());
+    ASSERT_EQ(0U, matcher.GetMaxDistance());
+    WidgetTree tree("");
+    tree.ConstructFromDom(nlohmann::json::parse(R"({"attributes": {"text": "Settings"}, "children": []})"), false);
+    vector<reference_wrapper<const Widget>> widgets;
+    SelectorPlan({matcher}).Select(tree, widgets);
+    ASSERT_EQ(1U, widgets.size());
+}
+
+TEST(WidgetMatcherTest, matchBitsAsMatches)
+{
+    auto dom = nlohmann::json::parse(R"({"attributes": {"text": "root"}, "children": []})");
+    for (auto index = 0; index < 100; index++) {
+        auto child = nlohmann::json();
+        child["attributes"]["text"] = "item" + to_string(index);
+        child["attributes"]["key"] = to_string(index % 7);
+        child["attributes"]["clickable"] = index % 2 == 0 ? "true" : "false";
+        child["children"] = nlohmann::json::array();
+        dom["children"].push_back(child);
+    }
+    WidgetTree tree("tree");
+    tree.ConstructFromDom(dom, false);
+    const auto text = WidgetAttrMatcher(ATTR_TEXT, "item1", STARTS_WITH);
+    const auto key = WidgetAttrMatcher("key", "3", EQ);
+    const auto clickable = WidgetAttrMatcher("clickable", "true", EQ);
+    const auto hierarchy = WidgetAttrMatcher(ATTR_HIERARCHY, "ROOT,1", STARTS_WITH);
+    const auto all = All({text, key, clickable});
+    const auto any = Any({text, key, hierarchy});
+    const auto allWithHierarchy = All(clickable, hierarchy);
+    const auto plan = SelectorPlan({text, clickable, hierarchy});
+    const vector<const WidgetMatcher *> matchers = {&all, &any, &allWithHierarchy, &plan, &key};
+    for (auto matcher : matchers) {
+        DfsBitset bits;
+        matcher->MatchBits(tree, bits);
+        ASSERT_EQ(tree.GetWidgetCount(), bits.GetSize());
+        uint32_t count = 0;
+        for (uint32_t index = 0; index < tree.GetWidgetCount(); index++) {
+            const auto matched = matcher->Matches(tree.GetWidgetByDfsIndex(index));
+            ASSERT_EQ(matched, bits.Test(index)) << matcher->Describe() << " at " << index;
+            count += matched ? 1 : 0;
+        }
+        ASSERT_GT(count, 0U) << matcher->Describe();
+    }
+    // the predicate sets are cached on the tree and shared
+    ASSERT_EQ(tree.GetAttrMatchBits("key", "3", EQ), tree.GetAttrMatchBits("key", "3", EQ));
+}
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include <array>
 #include "gtest/gtest.h"
 #include "widget_selector.h"
 
@@ -535,4 +536,300 @@ TEST_F(WidgetSelectorTest, selectorSerialization)
     receiver.clear();
     newSelector.Select(tree_, receiver);
     ASSERT_EQ(2, receiver.size()); // 2 widgets should be selected
-}
\ No newline at end of file
+}
+
+TEST_F(WidgetSelectorTest, selectWithLimit)
+{
+    auto err = ApiCallErr(NO_ERROR);
+    auto front = WidgetSelector();
+    front.AddMatcher(WidgetAttrMatcher("resource-id", "id2", EQ));
+    auto rear = WidgetSelector();
+    rear.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "Transfer files", EQ));
+    for (auto locators = 0; locators < 4; locators++) {
+        auto selector = WidgetSelector();
+        selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "", EQ));
+        if ((locators & 1) != 0) {
+            selector.AddFrontLocator(front, err);
+        }
+        if ((locators & 2) != 0) {
+            selector.AddRearLocator(rear, err);
+        }
+        vector<reference_wrapper<const Widget>> all;
+        selector.Select(tree_, all);
+        ASSERT_GE(all.size(), 2U) << selector.Describe();
+        for (size_t limit = 1; limit <= all.size() + 1; limit++) {
+            vector<reference_wrapper<const Widget>> limited;
+            selector.Select(tree_, limited, limit);
+            ASSERT_EQ(min(limit, all.size()), limited.size()) << selector.Describe();
+            for (size_t index = 0; index < limited.size(); index++) {
+                ASSERT_EQ(&all[index].get(), &limited[index].get()) << selector.Describe();
+            }
+        }
+    }
+    // the collector stops the traversal once the limit is reached
+    auto matcher = WidgetAttrMatcher(ATTR_TEXT, "", EQ);
+    vector<reference_wrapper<const Widget>> collected;
+    MatchedWidgetCollector collector(matcher, collected, 1);
+    ASSERT_FALSE(collector.IsSatisfied());
+    tree_.DfsTraverse(collector);
+    ASSERT_EQ(1, collected.size());
+    ASSERT_TRUE(collector.IsSatisfied());
+}
+
+static void SelectIds(const WidgetTree &tree, const WidgetSelector &selector, vector<string> &ids, size_t limit = 0)
+{
+    vector<reference_wrapper<const Widget>> receiver;
+    selector.Select(tree, receiver, limit);
+    ids.clear();
+    for (auto &widget : receiver) {
+        ids.emplace_back(widget.get().GetAttr("resource-id", ""));
+    }
+}
+
+TEST_F(WidgetSelectorTest, fuzzyMatchesRankedByDistance)
+{
+    // 'Transfer files' is 1 edit away from the test value, 'Transfer photos' is 6 edits away
+    auto selector = WidgetSelector();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "Transfer file", FUZZY, 6));
+    vector<string> ids;
+    SelectIds(tree_, selector, ids);
+    ASSERT_EQ(vector<string>({"id10", "id8"}), ids);
+    SelectIds(tree_, selector, ids, 1);
+    ASSERT_EQ(vector<string>({"id10"}), ids);
+    // the max distance survives the serialization
+    nlohmann::json data;
+    selector.WriteIntoParcel(data);
+    auto newSelector = WidgetSelector();
+    newSelector.ReadFromParcel(data);
+    SelectIds(tree_, newSelector, ids);
+    ASSERT_EQ(vector<string>({"id10", "id8"}), ids);
+    auto strict = WidgetSelector();
+    strict.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "Transfer file", FUZZY, 5));
+    SelectIds(tree_, strict, ids);
+    ASSERT_EQ(vector<string>({"id10"}), ids);
+    auto exact = WidgetSelector();
+    exact.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "Transfer file", FUZZY, 0));
+    SelectIds(tree_, exact, ids);
+    ASSERT_TRUE(ids.empty());
+    ASSERT_TRUE(strict.Describe().find("fuzzy 'Transfer file' within 5") != string::npos) << strict.Describe();
+}
+
+TEST_F(WidgetSelectorTest, structuralLocators)
+{
+    auto err = ApiCallErr(NO_ERROR);
+    auto makeLocator = [](string_view attr, string_view value, ValueMatchRule rule) {
+        auto locator = WidgetSelector();
+        locator.AddMatcher(WidgetAttrMatcher(attr, value, rule));
+        return locator;
+    };
+    vector<string> ids;
+    // within: the target is in the subtree of the locator, excluding the locator itself
+    auto within = makeLocator(ATTR_TEXT, "Transfer", CONTAINS);
+    within.AddAncestorLocator(makeLocator("resource-id", "id6", EQ), err);
+    ASSERT_EQ(NO_ERROR, err.code_);
+    SelectIds(tree_, within, ids);
+    ASSERT_EQ(vector<string>({"id8", "id10"}), ids);
+    auto withinSelf = makeLocator("resource-id", "id9", EQ);
+    withinSelf.AddAncestorLocator(makeLocator("resource-id", "id9", EQ), err);
+    SelectIds(tree_, withinSelf, ids);
+    ASSERT_TRUE(ids.empty());
+    // nested ancestor locator matches are united
+    auto withinNested = makeLocator(ATTR_TEXT, "", EQ);
+    withinNested.AddAncestorLocator(makeLocator("resource-id", "id", STARTS_WITH), err);
+    SelectIds(tree_, withinNested, ids);
+    ASSERT_EQ(vector<string>({"id2", "id3", "id6", "id7", "id9"}), ids);
+    // hasChild: only the direct parents of the locator
+    auto hasChild = makeLocator("resource-id", "id", CONTAINS);
+    hasChild.AddChildLocator(makeLocator(ATTR_TEXT, "Transfer files", EQ), err);
+    SelectIds(tree_, hasChild, ids);
+    ASSERT_EQ(vector<string>({"id9"}), ids);
+    // hasDescendant: all the ancestors of the locator
+    auto hasDescendant = makeLocator("resource-id", "id", CONTAINS);
+    hasDescendant.AddDescendantLocator(makeLocator(ATTR_TEXT, "Transfer", STARTS_WITH), err);
+    SelectIds(tree_, hasDescendant, ids);
+    ASSERT_EQ(vector<string>({"id1", "id5", "id6", "id7", "id9"}), ids);
+    SelectIds(tree_, hasDescendant, ids, 2);
+    ASSERT_EQ(vector<string>({"id1", "id5"}), ids);
+    // combined with each other and with the front locators
+    auto combined = makeLocator("resource-id", "id", CONTAINS);
+    combined.AddAncestorLocator(makeLocator(ATTR_TEXT, "wyz", EQ), err);
+    combined.AddDescendantLocator(makeLocator(ATTR_TEXT, "Transfer", STARTS_WITH), err);
+    SelectIds(tree_, combined, ids);
+    ASSERT_EQ(vector<string>({"id6", "id7", "id9"}), ids);
+    combined.AddFrontLocator(makeLocator(ATTR_TEXT, "Transfer photos", EQ), err);
+    SelectIds(tree_, combined, ids);
+    ASSERT_EQ(vector<string>({"id9"}), ids);
+    // locator not found
+    auto notFound = makeLocator("resource-id", "id", CONTAINS);
+    notFound.AddChildLocator(makeLocator(ATTR_TEXT, "none", EQ), err);
+    SelectIds(tree_, notFound, ids);
+    ASSERT_TRUE(ids.empty());
+    ASSERT_EQ(NO_ERROR, err.code_);
+
+    // serialization keeps the structural locators
+    nlohmann::json data;
+    combined.WriteIntoParcel(data);
+    auto restored = WidgetSelector();
+    restored.ReadFromParcel(data);
+    ASSERT_EQ(combined.Describe(), restored.Describe());
+    SelectIds(tree_, restored, ids);
+    ASSERT_EQ(vector<string>({"id9"}), ids);
+    // nesting is not supported
+    auto nested = WidgetSelector();
+    nested.AddAncestorLocator(hasChild, err);
+    ASSERT_EQ(USAGE_ERROR, err.code_);
+    err = ApiCallErr(NO_ERROR);
+    nested.AddFrontLocator(within, err);
+    ASSERT_EQ(USAGE_ERROR, err.code_);
+}
+
+TEST(WidgetSelectorGeometryTest, geometricLocators)
+{
+    // a form of two rows of label and input field, and a button below
+    auto dom = nlohmann::json();
+    dom["attributes"] = {{"type", "Root"}, {"bounds", "[0,0][1000,1000]"}};
+    dom["children"] = nlohmann::json::array();
+    const vector<array<string, 3>> items = {
+        {"Text", "Name", "[0,0][100,50]"}, {"TextInput", "input0", "[120,0][500,50]"},
+        {"Text", "Email", "[0,100][100,150]"}, {"TextInput", "input1", "[120,100][500,150]"}};
+    auto makeNode = [](string_view type, string_view text, string_view bounds) {
+        auto node = nlohmann::json();
+        node["attributes"] = {{"type", type}, {"text", text}, {"bounds", bounds}};
+        node["children"] = nlohmann::json::array();
+        return node;
+    };
+    for (auto &[type, text, bounds] : items) {
+        dom["children"].push_back(makeNode(type, text, bounds));
+    }
+    // a clickable row holding the OK text and the Cancel button
+    auto row = makeNode("Row", "", "[0,300][500,350]");
+    row["attributes"]["clickable"] = "true";
+    row["children"].push_back(makeNode("Text", "OK", "[0,300][100,350]"));
+    auto cancel = makeNode("Button", "Cancel", "[150,300][250,350]");
+    cancel["attributes"]["clickable"] = "true";
+    row["children"].push_back(cancel);
+    dom["children"].push_back(row);
+    WidgetTree tree("");
+    tree.ConstructFromDom(dom, true);
+    auto err = ApiCallErr(NO_ERROR);
+    auto makeSelector = [](string_view attr, string_view value) {
+        auto selector = WidgetSelector();
+        selector.AddMatcher(WidgetAttrMatcher(attr, value, EQ));
+        return selector;
+    };
+    auto selectTexts = [&tree](const WidgetSelector &selector) {
+        vector<reference_wrapper<const Widget>> receiver;
+        selector.Select(tree, receiver);
+        vector<string> texts;
+        for (auto &widget : receiver) {
+            texts.emplace_back(widget.get().GetAttr(ATTR_TEXT, ""));
+        }
+        return texts;
+    };
+    auto rightOfName = makeSelector("type", "TextInput");
+    rightOfName.AddGeometricLocator(makeSelector(ATTR_TEXT, "Name"), RIGHT_OF, err);
+    ASSERT_EQ(vector<string>({"input0"}), selectTexts(rightOfName));
+    auto rightOfLabels = makeSelector("type", "TextInput");
+    rightOfLabels.AddGeometricLocator(makeSelector("type", "Text"), RIGHT_OF, err);
+    ASSERT_EQ(vector<string>({"input0", "input1"}), selectTexts(rightOfLabels));
+    auto leftOfInput = makeSelector("type", "Text");
+    leftOfInput.AddGeometricLocator(makeSelector(ATTR_TEXT, "input1"), LEFT_OF, err);
+    ASSERT_EQ(vector<string>({"Email"}), selectTexts(leftOfInput));
+    auto belowName = makeSelector("type", "Text");
+    belowName.AddGeometricLocator(makeSelector(ATTR_TEXT, "Name"), BELOW, err);
+    ASSERT_EQ(vector<string>({"Email", "OK"}), selectTexts(belowName));
+    auto aboveOk = makeSelector("type", "TextInput");
+    aboveOk.AddGeometricLocator(makeSelector(ATTR_TEXT, "OK"), ABOVE, err);
+    ASSERT_TRUE(selectTexts(aboveOk).empty());
+    // near: within 50 pixels, the locator itself is excluded
+    auto nearName = makeSelector("type", "Text");
+    nearName.AddGeometricLocator(makeSelector(ATTR_TEXT, "Name"), NEAR, err);
+    ASSERT_EQ(vector<string>({"Email"}), selectTexts(nearName));
+    auto nearNameInput = makeSelector("type", "TextInput");
+    nearNameInput.AddGeometricLocator(makeSelector(ATTR_TEXT, "Name"), NEAR, err);
+    ASSERT_EQ(vector<string>({"input0"}), selectTexts(nearNameInput));
+    // the row containing the locator overlaps it but is not near it
+    auto nearOk = makeSelector("clickable", "true");
+    nearOk.AddGeometricLocator(makeSelector(ATTR_TEXT, "OK"), NEAR, err);
+    ASSERT_EQ(vector<string>({"Cancel"}), selectTexts(nearOk));
+    // combined relations
+    auto combined = makeSelector("type", "Text");
+    combined.AddGeometricLocator(makeSelector(ATTR_TEXT, "Name"), BELOW, err);
+    combined.AddGeometricLocator(makeSelector(ATTR_TEXT, "input1"), LEFT_OF, err);
+    ASSERT_EQ(vector<string>({"Email"}), selectTexts(combined));
+    ASSERT_EQ(NO_ERROR, err.code_);
+    // serialization keeps the geometric locators
+    nlohmann::json data;
+    combined.WriteIntoParcel(data);
+    auto restored = WidgetSelector();
+    restored.ReadFromParcel(data);
+    ASSERT_EQ(combined.Describe(), restored.Describe());
+    ASSERT_EQ(vector<string>({"Email"}), selectTexts(restored));
+    // nesting is not supported
+    auto nested = makeSelector("type", "Text");
+    nested.AddGeometricLocator(combined, NEAR, err);
+    ASSERT_EQ(USAGE_ERROR, err.code_);
+}
+
+TEST_F(WidgetSelectorTest, selectionResultsMemoized)
+{
+    WidgetSelector::ResetSelectionCache();
+    auto err = ApiCallErr(NO_ERROR);
+    auto makeSelector = [](string_view value) {
+        auto selector = WidgetSelector();
+        selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, value, CONTAINS));
+        return selector;
+    };
+    vector<string> ids;
+    auto selector = makeSelector("Transfer");
+    SelectIds(tree_, selector, ids);
+    const auto expected = ids;
+    ASSERT_EQ(vector<string>({"id8", "id10"}), expected);
+    auto stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(0, stats.hits_);
+    ASSERT_EQ(1, stats.misses_);
+    ASSERT_EQ(1, stats.size_);
+    // repeating the query on the same snapshot, also by an equivalent selector, is served from the cache
+    SelectIds(tree_, selector, ids);
+    ASSERT_EQ(expected, ids);
+    SelectIds(tree_, makeSelector("Transfer"), ids);
+    ASSERT_EQ(expected, ids);
+    stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(2, stats.hits_);
+    ASSERT_EQ(1, stats.misses_);
+    ASSERT_DOUBLE_EQ(2.0 / 3.0, stats.GetHitRate());
+    // the limit and the locators are parts of the key
+    SelectIds(tree_, selector, ids, 1);
+    ASSERT_EQ(vector<string>({"id8"}), ids);
+    auto front = makeSelector("Transfer");
+    front.AddFrontLocator(makeSelector("Transfer"), err);
+    auto rear = makeSelector("Transfer");
+    rear.AddRearLocator(makeSelector("Transfer"), err);
+    ASSERT_NE(front.GetFingerprint(), rear.GetFingerprint());
+    ASSERT_NE(selector.GetFingerprint(), front.GetFingerprint());
+    SelectIds(tree_, front, ids);
+    ASSERT_EQ(vector<string>({"id10"}), ids);
+    SelectIds(tree_, rear, ids);
+    ASSERT_EQ(vector<string>({"id8"}), ids);
+    stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(2, stats.hits_);
+    ASSERT_EQ(4, stats.misses_);
+    // adding matchers invalidates the fingerprint
+    const auto fingerprint = selector.GetFingerprint();
+    selector.AddMatcher(WidgetAttrMatcher(ATTR_TEXT, "file", CONTAINS));
+    ASSERT_NE(fingerprint, selector.GetFingerprint());
+    SelectIds(tree_, selector, ids);
+    ASSERT_EQ(vector<string>({"id10"}), ids);
+    // a new snapshot of the same content is a new generation, which misses the cache
+    auto snapshot = WidgetTree("");
+    snapshot.ConstructFromDom(nlohmann::json::parse(DOM_TEXT), false);
+    ASSERT_NE(tree_.GetGeneration(), snapshot.GetGeneration());
+    SelectIds(snapshot, makeSelector("Transfer"), ids);
+    ASSERT_EQ(expected, ids);
+    stats = WidgetSelector::GetSelectionCacheStats();
+    ASSERT_EQ(2, stats.hits_);
+    ASSERT_EQ(6, stats.misses_);
+    ASSERT_EQ(6, stats.size_);
+    WidgetSelector::ResetSelectionCache();
+    ASSERT_EQ(0, WidgetSelector::GetSelectionCacheStats().size_);
+}